@@ -70,6 +70,46 @@ void Arduino_DataBus::sendData16(uint16_t d)
   endWrite();
 }
 
+uint8_t compileBatchCommands(const uint8_t *operations, size_t len, size_t *pos, panel_command_t *cmds, uint8_t max)
+{
+  uint8_t count = 0;
+  size_t i = *pos;
+  while ((count < max) && (i < len))
+  {
+    size_t data = i + 2; // first payload byte
+    size_t l;
+    switch (operations[i])
+    {
+    case WRITE_COMMAND_8:
+      l = 0;
+      break;
+    case WRITE_C8_D8:
+      l = 1;
+      break;
+    case WRITE_C8_D16:
+      l = 2;
+      break;
+    case WRITE_C8_BYTES:
+      l = (data < len) ? operations[data++] : len;
+      break;
+    default:
+      l = sizeof(cmds->data) + 1; // not a command write
+      break;
+    }
+    if ((l > sizeof(cmds->data)) || (data + l > len))
+    {
+      break;
+    }
+    panel_command_t *c = &cmds[count++];
+    c->cmd = operations[i + 1];
+    c->len = l;
+    memcpy(c->data, operations + data, l);
+    i = data + l;
+  }
+  *pos = i;
+  return count;
+}
+
 void Arduino_DataBus::batchOperation(const uint8_t *operations, size_t len)
 {
   for (size_t i = 0; i < len; ++i)
@@ -249,6 +249,28 @@ typedef enum
   DELAY,
 } spi_operation_type_t;
 
+/**
+ * @brief One register write, command byte plus up to four data bytes, for
+ * handing a command sequence to a bus that can queue it
+ */
+typedef struct
+{
+  uint8_t cmd;
+  uint8_t len;
+  uint8_t data[4];
+} panel_command_t;
+
+/**
+ * @brief Compile the register writes of a batchOperation() table, starting
+ * at operations[*pos], into at most max commands. Stops at the first
+ * operation that is not a plain command write (BEGIN_WRITE, END_WRITE,
+ * DELAY, data-only writes, 16-bit commands, payloads over four bytes) and
+ * leaves *pos on it, so the caller can run that one itself and carry on.
+ *
+ * @return number of commands written to cmds
+ */
+uint8_t compileBatchCommands(const uint8_t *operations, size_t len, size_t *pos, panel_command_t *cmds, uint8_t max);
+
 union
 {
   uint16_t value;
@@ -1,6 +1,18 @@
 #include "Arduino_ESP32QSPI.h"
 
 #if defined(ESP32)
+#if __has_include(<esp_memory_utils.h>)
+#include <esp_memory_utils.h>
+#else
+#include <soc/soc_memory_layout.h>
+#endif
+#include <esp_timer.h>
+
+// Per queued transaction, handled in the SPI ISR
+#define ESP32QSPI_TRANS_CS_LOW 0x01  // pre: lower CS, the transaction starts its own frame
+#define ESP32QSPI_TRANS_CS_HIGH 0x02 // post: raise CS
+#define ESP32QSPI_TRANS_START 0x04   // pre: start timing the chain, if not already
+#define ESP32QSPI_TRANS_DONE 0x08    // post: end of chain, time it and run the done callback
 
 /**
  * @brief Arduino_ESP32QSPI
@@ -54,7 +66,7 @@ bool Arduino_ESP32QSPI::begin(int32_t speed, int8_t dataMode)
       .data5_io_num = -1,
       .data6_io_num = -1,
       .data7_io_num = -1,
-      .max_transfer_sz = (ESP32QSPI_MAX_PIXELS_AT_ONCE * 16) + 8,
+      .max_transfer_sz = ESP32QSPI_MAX_TRANSFER_SZ,
       .flags = SPICOMMON_BUSFLAG_MASTER | SPICOMMON_BUSFLAG_GPIO_PINS,
 #if (!defined(ESP_ARDUINO_VERSION_MAJOR)) || (ESP_ARDUINO_VERSION_MAJOR < 3)
       // skip this
@@ -84,9 +96,9 @@ bool Arduino_ESP32QSPI::begin(int32_t speed, int8_t dataMode)
       .input_delay_ns = 0,
       .spics_io_num = -1, // avoid use system CS control
       .flags = SPI_DEVICE_HALFDUPLEX,
-      .queue_size = 1,
-      .pre_cb = nullptr,
-      .post_cb = nullptr};
+      .queue_size = ESP32QSPI_QUEUE_SIZE,
+      .pre_cb = preCallback,
+      .post_cb = postCallback};
   ret = spi_bus_add_device(ESP32QSPI_SPI_HOST, &devcfg, &_handle);
   if (ret != ESP_OK)
   {
@@ -101,18 +113,164 @@ bool Arduino_ESP32QSPI::begin(int32_t speed, int8_t dataMode)
 
   memset(&_spi_tran_ext, 0, sizeof(_spi_tran_ext));
   _spi_tran = (spi_transaction_t *)&_spi_tran_ext;
+  memset(_async_tran_ext, 0, sizeof(_async_tran_ext));
+  memset(_async_flags, 0, sizeof(_async_flags));
 
-  _buffer = (uint8_t *)heap_caps_aligned_alloc(16, ESP32QSPI_MAX_PIXELS_AT_ONCE * 2, MALLOC_CAP_DMA);
-  if (!_buffer)
+#if ESP32QSPI_FILL_PIXELS
+  if (!_fill_buffer)
   {
-    return false;
+    _fill_buffer = (uint8_t *)heap_caps_aligned_alloc(16, ESP32QSPI_FILL_PIXELS * 2, MALLOC_CAP_DMA);
+    if (!_fill_buffer)
+    {
+      return false;
+    }
+  }
+  _fill_len = 0;
+#endif
+
+  uint32_t px = _chunk_px;
+  _chunk_px = 0; // force the allocation
+  return setChunkPixels(px);
+}
+
+/**
+ * @brief setChunkPixels
+ *
+ * Pixels per packed transaction, between ESP32QSPI_MIN_CHUNK_PIXELS and
+ * ESP32QSPI_MAX_CHUNK_PIXELS. The bounce buffers are reallocated at the new
+ * size, ESP32QSPI_BUFFER_COUNT of them in DMA-capable RAM; on failure the
+ * old ones are kept.
+ *
+ * @param px
+ * @return true
+ * @return false
+ */
+bool Arduino_ESP32QSPI::setChunkPixels(uint32_t px)
+{
+  if (px < ESP32QSPI_MIN_CHUNK_PIXELS)
+  {
+    px = ESP32QSPI_MIN_CHUNK_PIXELS;
+  }
+  else if (px > ESP32QSPI_MAX_CHUNK_PIXELS)
+  {
+    px = ESP32QSPI_MAX_CHUNK_PIXELS;
+  }
+  px &= ~1u; // whole words for the 32-bit packers
+  if (px == _chunk_px)
+  {
+    return true;
+  }
+
+  ASYNC_WAIT();
+  uint8_t *bufs[ESP32QSPI_BUFFER_COUNT];
+  for (int i = 0; i < ESP32QSPI_BUFFER_COUNT; ++i)
+  {
+    bufs[i] = (uint8_t *)heap_caps_aligned_alloc(16, px * 2, MALLOC_CAP_DMA);
+    if (!bufs[i])
+    {
+      while (i--)
+      {
+        heap_caps_free(bufs[i]);
+      }
+      return false;
+    }
+  }
+  for (int i = 0; i < ESP32QSPI_BUFFER_COUNT; ++i)
+  {
+    heap_caps_free(_ring_buffer[i]);
+    _ring_buffer[i] = bufs[i];
+  }
+  _buffer = _ring_buffer[0]; // staging for batchOperation(), never in flight between calls
+  _ring_next = 0;
+  _chunk_px = px;
+
+  return true;
+}
+
+/**
+ * @brief getChunkPixels
+ *
+ * @return uint32_t
+ */
+uint32_t Arduino_ESP32QSPI::getChunkPixels()
+{
+  return _chunk_px;
+}
+
+/**
+ * @brief autoTuneChunkPixels
+ *
+ * Time a chunked fill of len pixels at each power-of-two chunk size whose
+ * buffers fit in ram_budget bytes, then keep the smallest chunk within 2%
+ * of the best throughput. The per-transaction overhead is estimated from
+ * the smallest and largest runs. The caller opens an address window of
+ * at least len pixels, which is written black.
+ *
+ * @param ram_budget
+ * @param len
+ * @param result
+ * @return true
+ * @return false if no chunk size fits the budget
+ */
+bool Arduino_ESP32QSPI::autoTuneChunkPixels(size_t ram_budget, uint32_t len, esp32qspi_tune_t *result)
+{
+  static const int max_trials = 8;
+  uint32_t chunk[max_trials];
+  uint32_t us[max_trials];
+  int n = 0;
+  for (uint32_t px = ESP32QSPI_MIN_CHUNK_PIXELS;
+       n < max_trials && px <= ESP32QSPI_MAX_CHUNK_PIXELS && px * 2 * ESP32QSPI_BUFFER_COUNT <= ram_budget;
+       px <<= 1)
+  {
+    if (!setChunkPixels(px))
+    {
+      break;
+    }
+    int64_t start = esp_timer_get_time();
+    writeRepeatChunked(0, len);
+    chunk[n] = px;
+    us[n] = (uint32_t)(esp_timer_get_time() - start);
+    if (!us[n])
+    {
+      us[n] = 1;
+    }
+    ++n;
   }
-  _2nd_buffer = (uint8_t *)heap_caps_aligned_alloc(16, ESP32QSPI_MAX_PIXELS_AT_ONCE * 2, MALLOC_CAP_DMA);
-  if (!_2nd_buffer)
+  if (!n)
   {
     return false;
   }
 
+  int best = 0;
+  for (int i = 1; i < n; ++i)
+  {
+    if (us[i] < us[best])
+    {
+      best = i;
+    }
+  }
+  int pick = best;
+  for (int i = 0; i < best; ++i)
+  {
+    if ((uint64_t)us[i] * 100 <= (uint64_t)us[best] * 102)
+    {
+      pick = i;
+      break;
+    }
+  }
+  setChunkPixels(chunk[pick]);
+
+  if (result)
+  {
+    result->chunk_px = chunk[pick];
+    result->bytes_per_ms = (uint32_t)((uint64_t)len * 2 * 1000 / us[pick]);
+    // t = transactions * overhead + bytes / rate, the same bytes in every run
+    uint32_t trans_small = (len + chunk[0] - 1) / chunk[0];
+    uint32_t trans_large = (len + chunk[n - 1] - 1) / chunk[n - 1];
+    result->overhead_ns = (n > 1 && trans_small > trans_large && us[0] > us[n - 1])
+                              ? (uint32_t)((uint64_t)(us[0] - us[n - 1]) * 1000 / (trans_small - trans_large))
+                              : 0;
+  }
   return true;
 }
 
@@ -136,6 +294,7 @@ void Arduino_ESP32QSPI::endWrite()
 {
   if (_is_shared_interface)
   {
+    ASYNC_WAIT();
     spi_device_release_bus(_handle);
   }
 }
@@ -182,7 +341,7 @@ void Arduino_ESP32QSPI::writeCommandBytes(uint8_t *data, uint32_t len)
   uint32_t l;
   while (len)
   {
-    l = (len >= (ESP32QSPI_MAX_PIXELS_AT_ONCE << 1)) ? (ESP32QSPI_MAX_PIXELS_AT_ONCE << 1) : len;
+    l = (len >= (ESP32QSPI_MAX_CHUNK_PIXELS << 1)) ? (ESP32QSPI_MAX_CHUNK_PIXELS << 1) : len;
 
     _spi_tran_ext.base.flags = SPI_TRANS_MULTILINE_CMD | SPI_TRANS_MULTILINE_ADDR;
     _spi_tran_ext.base.tx_buffer = data;
@@ -343,51 +502,91 @@ void Arduino_ESP32QSPI::writeC8Bytes(uint8_t c, uint8_t *data, uint32_t len)
 /**
  * @brief writeRepeat
  *
+ * Constant fills go out from one pattern buffer, one queued transaction
+ * per ESP32QSPI_FILL_PIXELS, with no packing between them. The pattern is
+ * only repainted when the colour changes and only as far as the fill
+ * needs, so short lines in one colour stay cheap.
+ *
  * @param p
  * @param len
  */
 void Arduino_ESP32QSPI::writeRepeat(uint16_t p, uint32_t len)
 {
+#if ESP32QSPI_FILL_PIXELS
+  uint32_t bufLen = (len >= ESP32QSPI_FILL_PIXELS) ? ESP32QSPI_FILL_PIXELS : len;
+  uint32_t xferLen, l;
+  uint32_t c32;
+  MSB_32_16_16_SET(c32, p, p);
+
+  CS_LOW(); // nothing is in flight now, so the pattern may be rewritten
+  if (p != _fill_color)
+  {
+    _fill_color = p;
+    _fill_len = 0;
+  }
+  l = (bufLen + 1) / 2;
+  for (uint32_t i = _fill_len >> 1; i < l; i++)
+  {
+    _fill_buffer32[i] = c32;
+  }
+  if ((l << 1) > _fill_len)
+  {
+    _fill_len = l << 1;
+  }
+
   bool first_send = true;
+  while (len)
+  {
+    xferLen = (bufLen <= len) ? bufLen : len;
+
+    QUEUE_TRANS(_fill_buffer32, xferLen << 4, first_send);
+    first_send = false;
 
-  uint16_t bufLen = (len >= ESP32QSPI_MAX_PIXELS_AT_ONCE) ? ESP32QSPI_MAX_PIXELS_AT_ONCE : len;
+    len -= xferLen;
+  }
+  QUEUE_END();
+#else
+  writeRepeatChunked(p, len);
+#endif
+}
+
+/**
+ * @brief writeRepeatChunked
+ *
+ * writeRepeat() through a bounce buffer, one transaction per chunk; what
+ * autoTuneChunkPixels() measures.
+ *
+ * @param p
+ * @param len
+ */
+void Arduino_ESP32QSPI::writeRepeatChunked(uint16_t p, uint32_t len)
+{
+  uint16_t bufLen = (len >= _chunk_px) ? _chunk_px : len;
   int16_t xferLen, l;
   uint32_t c32;
   MSB_32_16_16_SET(c32, p, p);
 
+  CS_LOW();
+  // Every transaction reads the same block, so it is filled once
+  uint32_t *buf32 = (uint32_t *)QUEUE_BUFFER();
   l = (bufLen + 1) / 2;
   for (uint32_t i = 0; i < l; i++)
   {
-    _buffer32[i] = c32;
+    buf32[i] = c32;
   }
 
-  CS_LOW();
   // Issue pixels in blocks from temp buffer
+  bool first_send = true;
   while (len) // While pixels remain
   {
     xferLen = (bufLen <= len) ? bufLen : len; // How many this pass?
 
-    if (first_send)
-    {
-      _spi_tran_ext.base.flags = SPI_TRANS_MODE_QIO;
-      _spi_tran_ext.base.cmd = 0x32;
-      _spi_tran_ext.base.addr = 0x003C00;
-      first_send = false;
-    }
-    else
-    {
-      _spi_tran_ext.base.flags = SPI_TRANS_MODE_QIO | SPI_TRANS_VARIABLE_CMD |
-                                 SPI_TRANS_VARIABLE_ADDR | SPI_TRANS_VARIABLE_DUMMY;
-    }
-    _spi_tran_ext.base.tx_buffer = _buffer16;
-    _spi_tran_ext.base.length = xferLen << 4;
-
-    POLL_START();
-    POLL_END();
+    QUEUE_TRANS(buf32, xferLen << 4, first_send);
+    first_send = false;
 
     len -= xferLen;
   }
-  CS_HIGH();
+  QUEUE_END();
 }
 
 /**
@@ -398,56 +597,100 @@ void Arduino_ESP32QSPI::writeRepeat(uint16_t p, uint32_t len)
  */
 void Arduino_ESP32QSPI::writePixels(uint16_t *data, uint32_t len)
 {
-
   CS_LOW();
   uint32_t l, l2;
   uint16_t p1, p2;
   bool first_send = true;
   while (len)
   {
-    l = (len > ESP32QSPI_MAX_PIXELS_AT_ONCE) ? ESP32QSPI_MAX_PIXELS_AT_ONCE : len;
+    l = (len > _chunk_px) ? _chunk_px : len;
 
-    if (first_send)
-    {
-      _spi_tran_ext.base.flags = SPI_TRANS_MODE_QIO;
-      _spi_tran_ext.base.cmd = 0x32;
-      _spi_tran_ext.base.addr = 0x003C00;
-      first_send = false;
-    }
-    else
-    {
-      _spi_tran_ext.base.flags = SPI_TRANS_MODE_QIO | SPI_TRANS_VARIABLE_CMD |
-                                 SPI_TRANS_VARIABLE_ADDR | SPI_TRANS_VARIABLE_DUMMY;
-    }
+    uint32_t *buf32 = (uint32_t *)QUEUE_BUFFER();
     l2 = l >> 1;
     for (uint32_t i = 0; i < l2; ++i)
     {
       p1 = *data++;
       p2 = *data++;
-      MSB_32_16_16_SET(_buffer32[i], p1, p2);
+      MSB_32_16_16_SET(buf32[i], p1, p2);
     }
     if (l & 1)
     {
       p1 = *data++;
-      MSB_16_SET(_buffer16[l - 1], p1);
+      MSB_16_SET(((uint16_t *)buf32)[l - 1], p1);
     }
 
-    _spi_tran_ext.base.tx_buffer = _buffer32;
-    _spi_tran_ext.base.length = l << 4;
+    QUEUE_TRANS(buf32, l << 4, first_send);
+    first_send = false;
 
-    POLL_START();
-    POLL_END();
+    len -= l;
+  }
+  QUEUE_END();
+}
+
+/**
+ * @brief writePixelsPreswapped
+ *
+ * Pixels are already in wire (big-endian) order, e.g. LVGL with
+ * LV_COLOR_16_SWAP. A DMA-capable, word-aligned buffer is sent in place;
+ * anything else is copied through the bounce buffer without swapping.
+ *
+ * @param data
+ * @param len
+ */
+void Arduino_ESP32QSPI::writePixelsPreswapped(uint16_t *data, uint32_t len)
+{
+  bool in_place = esp_ptr_dma_capable(data) && !((uintptr_t)data & 3);
+  uint32_t max_l = in_place ? ESP32QSPI_ASYNC_PIXELS_AT_ONCE : _chunk_px;
+
+  CS_LOW();
+  uint32_t l;
+  bool first_send = true;
+  while (len)
+  {
+    l = (len > max_l) ? max_l : len;
+
+    if (in_place)
+    {
+      QUEUE_TRANS(data, l << 4, first_send);
+    }
+    else
+    {
+      uint8_t *buf = QUEUE_BUFFER();
+      memcpy(buf, data, l << 1);
+      QUEUE_TRANS(buf, l << 4, first_send);
+    }
+    first_send = false;
 
     len -= l;
+    data += l;
   }
-  CS_HIGH();
+  QUEUE_END();
 }
 
+/**
+ * @brief batchOperation
+ *
+ * Runs of register writes are compiled into commands and queued back to
+ * back with writeCommandsAsync(), so the ISR frames CS and the task only
+ * waits at a DELAY or at whatever else the table asks for, which is
+ * interpreted one operation at a time as before.
+ *
+ * @param operations
+ * @param len
+ */
 void Arduino_ESP32QSPI::batchOperation(const uint8_t *operations, size_t len)
 {
-  for (size_t i = 0; i < len; ++i)
+  panel_command_t cmds[ESP32QSPI_BATCH_COMMANDS];
+  size_t i = 0;
+  while (i < len)
   {
-    uint8_t l = 0;
+    uint8_t l = compileBatchCommands(operations, len, &i, cmds, ESP32QSPI_BATCH_COMMANDS);
+    if (l)
+    {
+      writeCommandsAsync(cmds, l);
+      continue;
+    }
+
     switch (operations[i])
     {
     case BEGIN_WRITE:
@@ -500,53 +743,56 @@ void Arduino_ESP32QSPI::batchOperation(const uint8_t *operations, size_t len)
       endWrite();
       break;
     case DELAY:
+      ASYNC_WAIT(); // the delay counts from the last command on the wire
       delay(operations[++i]);
       break;
     default:
       printf("Unknown operation id at %d: %d\n", i, operations[i]);
       break;
     }
+    ++i;
   }
+  ASYNC_WAIT();
 }
 
 /**
  * @brief writeBytes
  *
+ * The transactions are still in flight on return, so like
+ * writePixelsPreswapped() only a DMA-capable, word-aligned buffer is sent
+ * in place; flash, PSRAM or stack data is copied through the bounce buffer.
+ *
  * @param data
  * @param len
  */
 void Arduino_ESP32QSPI::writeBytes(uint8_t *data, uint32_t len)
 {
+  bool in_place = esp_ptr_dma_capable(data) && !((uintptr_t)data & 3);
+  uint32_t max_l = in_place ? (ESP32QSPI_MAX_CHUNK_PIXELS << 1) : (_chunk_px << 1);
+
   CS_LOW();
   uint32_t l;
   bool first_send = true;
   while (len)
   {
-    l = (len >= (ESP32QSPI_MAX_PIXELS_AT_ONCE << 1)) ? (ESP32QSPI_MAX_PIXELS_AT_ONCE << 1) : len;
+    l = (len > max_l) ? max_l : len;
 
-    if (first_send)
+    if (in_place)
     {
-      _spi_tran_ext.base.flags = SPI_TRANS_MODE_QIO;
-      _spi_tran_ext.base.cmd = 0x32;
-      _spi_tran_ext.base.addr = 0x003C00;
-      first_send = false;
+      QUEUE_TRANS(data, l << 3, first_send);
     }
     else
     {
-      _spi_tran_ext.base.flags = SPI_TRANS_MODE_QIO | SPI_TRANS_VARIABLE_CMD |
-                                 SPI_TRANS_VARIABLE_ADDR | SPI_TRANS_VARIABLE_DUMMY;
+      uint8_t *buf = QUEUE_BUFFER();
+      memcpy(buf, data, l);
+      QUEUE_TRANS(buf, l << 3, first_send);
     }
-
-    _spi_tran_ext.base.tx_buffer = data;
-    _spi_tran_ext.base.length = l << 3;
-
-    POLL_START();
-    POLL_END();
+    first_send = false;
 
     len -= l;
     data += l;
   }
-  CS_HIGH();
+  QUEUE_END();
 }
 
 /**
@@ -558,9 +804,9 @@ void Arduino_ESP32QSPI::writeBytes(uint8_t *data, uint32_t len)
  */
 void Arduino_ESP32QSPI::write16bitBeRGBBitmapR1(uint16_t *bitmap, int16_t w, int16_t h)
 {
-  if (h > ESP32QSPI_MAX_PIXELS_AT_ONCE)
+  if ((uint32_t)h > _chunk_px)
   {
-    log_e("h > ESP32QSPI_MAX_PIXELS_AT_ONCE, h: %d", h);
+    log_e("h > chunk pixels (%u), h: %d", (unsigned)_chunk_px, h);
   }
   else
   {
@@ -572,34 +818,18 @@ void Arduino_ESP32QSPI::write16bitBeRGBBitmapR1(uint16_t *bitmap, int16_t w, int
 
     for (int16_t i = 0; i < w; i++)
     {
-      if (first_send)
-      {
-        _spi_tran_ext.base.flags = SPI_TRANS_MODE_QIO;
-        _spi_tran_ext.base.cmd = 0x32;
-        _spi_tran_ext.base.addr = 0x003C00;
-        first_send = false;
-      }
-      else
-      {
-        POLL_END();
-        _spi_tran_ext.base.flags = SPI_TRANS_MODE_QIO | SPI_TRANS_VARIABLE_CMD |
-                                   SPI_TRANS_VARIABLE_ADDR | SPI_TRANS_VARIABLE_DUMMY;
-      }
-
+      uint16_t *buf16 = (uint16_t *)QUEUE_BUFFER();
       p = origin_offset + i;
       for (int16_t j = 0; j < h; j++)
       {
-        _buffer16[j] = *p;
+        buf16[j] = *p;
         p -= w;
       }
 
-      _spi_tran_ext.base.tx_buffer = _buffer16;
-      _spi_tran_ext.base.length = l;
-
-      POLL_START();
+      QUEUE_TRANS(buf16, l, first_send);
+      first_send = false;
     }
-    POLL_END();
-    CS_HIGH();
+    QUEUE_END();
   }
 }
 
@@ -618,42 +848,28 @@ void Arduino_ESP32QSPI::writeIndexedPixels(uint8_t *data, uint16_t *idx, uint32_
   bool first_send = true;
   while (len)
   {
-    l = (len > ESP32QSPI_MAX_PIXELS_AT_ONCE) ? ESP32QSPI_MAX_PIXELS_AT_ONCE : len;
+    l = (len > _chunk_px) ? _chunk_px : len;
 
-    if (first_send)
-    {
-      _spi_tran_ext.base.flags = SPI_TRANS_MODE_QIO;
-      _spi_tran_ext.base.cmd = 0x32;
-      _spi_tran_ext.base.addr = 0x003C00;
-      first_send = false;
-    }
-    else
-    {
-      _spi_tran_ext.base.flags = SPI_TRANS_MODE_QIO | SPI_TRANS_VARIABLE_CMD |
-                                 SPI_TRANS_VARIABLE_ADDR | SPI_TRANS_VARIABLE_DUMMY;
-    }
+    uint32_t *buf32 = (uint32_t *)QUEUE_BUFFER();
     l2 = l >> 1;
     for (uint32_t i = 0; i < l2; ++i)
     {
       p1 = idx[*data++];
       p2 = idx[*data++];
-      MSB_32_16_16_SET(_buffer32[i], p1, p2);
+      MSB_32_16_16_SET(buf32[i], p1, p2);
     }
     if (l & 1)
     {
       p1 = idx[*data++];
-      MSB_16_SET(_buffer16[l - 1], p1);
+      MSB_16_SET(((uint16_t *)buf32)[l - 1], p1);
     }
 
-    _spi_tran_ext.base.tx_buffer = _buffer32;
-    _spi_tran_ext.base.length = l << 4;
-
-    POLL_START();
-    POLL_END();
+    QUEUE_TRANS(buf32, l << 4, first_send);
+    first_send = false;
 
     len -= l;
   }
-  CS_HIGH();
+  QUEUE_END();
 }
 
 /**
@@ -671,40 +887,26 @@ void Arduino_ESP32QSPI::writeIndexedPixelsDouble(uint8_t *data, uint16_t *idx, u
   bool first_send = true;
   while (len)
   {
-    l = (len > (ESP32QSPI_MAX_PIXELS_AT_ONCE >> 1)) ? (ESP32QSPI_MAX_PIXELS_AT_ONCE >> 1) : len;
+    l = (len > (_chunk_px >> 1)) ? (_chunk_px >> 1) : len;
 
-    if (first_send)
-    {
-      _spi_tran_ext.base.flags = SPI_TRANS_MODE_QIO;
-      _spi_tran_ext.base.cmd = 0x32;
-      _spi_tran_ext.base.addr = 0x003C00;
-      first_send = false;
-    }
-    else
-    {
-      _spi_tran_ext.base.flags = SPI_TRANS_MODE_QIO | SPI_TRANS_VARIABLE_CMD |
-                                 SPI_TRANS_VARIABLE_ADDR | SPI_TRANS_VARIABLE_DUMMY;
-    }
+    uint32_t *buf32 = (uint32_t *)QUEUE_BUFFER();
     for (uint32_t i = 0; i < l; ++i)
     {
       p = idx[*data++];
-      MSB_32_16_16_SET(_buffer32[i], p, p);
+      MSB_32_16_16_SET(buf32[i], p, p);
     }
 
-    _spi_tran_ext.base.tx_buffer = _buffer32;
-    _spi_tran_ext.base.length = l << 5;
-
-    POLL_START();
-    POLL_END();
+    QUEUE_TRANS(buf32, l << 5, first_send);
+    first_send = false;
 
     len -= l;
   }
-  CS_HIGH();
+  QUEUE_END();
 }
 
 void Arduino_ESP32QSPI::writeYCbCrPixels(uint8_t *yData, uint8_t *cbData, uint8_t *crData, uint16_t w, uint16_t h)
 {
-  if (w > (ESP32QSPI_MAX_PIXELS_AT_ONCE / 2))
+  if (w > (_chunk_px / 2))
   {
     Arduino_DataBus::writeYCbCrPixels(yData, cbData, crData, w, h);
   }
@@ -715,10 +917,8 @@ void Arduino_ESP32QSPI::writeYCbCrPixels(uint8_t *yData, uint8_t *cbData, uint8_
     int cols = w >> 1;
     int rows = h >> 1;
     uint8_t *yData2 = yData + w;
-    uint16_t *dest = _buffer16;
-    uint16_t *dest2 = dest + w;
 
-    uint16_t out_bits = w << 5;
+    uint32_t out_bits = w << 5;
 
     uint8_t pxCb, pxCr;
     int16_t pxR, pxG, pxB, pxY;
@@ -726,6 +926,10 @@ void Arduino_ESP32QSPI::writeYCbCrPixels(uint8_t *yData, uint8_t *cbData, uint8_
     CS_LOW();
     for (int row = 0; row < rows; ++row)
     {
+      // Two output rows per transaction
+      uint16_t *buf16 = (uint16_t *)QUEUE_BUFFER();
+      uint16_t *dest = buf16;
+      uint16_t *dest2 = dest + w;
       for (int col = 0; col < cols; ++col)
       {
         pxCb = *cbData++;
@@ -746,39 +950,243 @@ void Arduino_ESP32QSPI::writeYCbCrPixels(uint8_t *yData, uint8_t *cbData, uint8_
       yData += w;
       yData2 += w;
 
-      if (first_send)
-      {
-        _spi_tran_ext.base.flags = SPI_TRANS_MODE_QIO;
-        _spi_tran_ext.base.cmd = 0x32;
-        _spi_tran_ext.base.addr = 0x003C00;
-        first_send = false;
-      }
-      else
-      {
-        POLL_END();
-        _spi_tran_ext.base.flags = SPI_TRANS_MODE_QIO | SPI_TRANS_VARIABLE_CMD |
-                                   SPI_TRANS_VARIABLE_ADDR | SPI_TRANS_VARIABLE_DUMMY;
-      }
+      QUEUE_TRANS(buf16, out_bits, first_send);
+      first_send = false;
+    }
+    QUEUE_END();
+  }
+}
+/**
+ * @brief setTransDoneCallback
+ *
+ * The callback runs in the SPI ISR once the last transaction queued by
+ * writePixelsAsync() has left the bus, so it must be IRAM safe.
+ *
+ * @param cb
+ * @param user_ctx
+ */
+void Arduino_ESP32QSPI::setTransDoneCallback(esp32qspi_trans_done_cb_t cb, void *user_ctx)
+{
+  _trans_done_cb = cb;
+  _trans_done_user_ctx = user_ctx;
+}
 
-      if (row & 1)
-      {
-        _spi_tran_ext.base.tx_buffer = _2nd_buffer32;
-        dest = _buffer16;
-      }
-      else
+/**
+ * @brief writeCommandsAsync
+ *
+ * Queue register writes, each in its own CS frame raised and lowered from
+ * the ISR, and return without waiting for anything queued before them.
+ * Meant to lead a writePixelsAsync() chain, e.g. with an address window;
+ * the chain is timed from the first of them.
+ *
+ * @param cmds
+ * @param count
+ */
+void Arduino_ESP32QSPI::writeCommandsAsync(const panel_command_t *cmds, uint8_t count)
+{
+  for (uint8_t i = 0; i < count; ++i)
+  {
+    spi_transaction_ext_t *t = QUEUE_SLOT(ESP32QSPI_TRANS_CS_LOW | ESP32QSPI_TRANS_CS_HIGH |
+                                          (i ? 0 : ESP32QSPI_TRANS_START));
+    t->base.flags = SPI_TRANS_USE_TXDATA | SPI_TRANS_MULTILINE_CMD | SPI_TRANS_MULTILINE_ADDR;
+    t->base.cmd = 0x02;
+    t->base.addr = ((uint32_t)cmds[i].cmd) << 8;
+    memcpy(t->base.tx_data, cmds[i].data, 4);
+    t->base.length = cmds[i].len << 3;
+#if ESP32QSPI_STATS
+    ++_stats.transactions;
+    _stats.bytes += cmds[i].len;
+#endif
+
+    spi_device_queue_trans(_handle, &t->base, portMAX_DELAY);
+    ++_async_queued;
+  }
+}
+
+/**
+ * @brief writePixelsAsync
+ *
+ * Queue the pixels for DMA straight from the caller's buffer and return
+ * without waiting. The buffer must be DMA capable, is byte-swapped in place
+ * unless preswapped and must stay untouched until the done callback fires.
+ * The chain frames CS itself from the ISR, so it queues behind earlier
+ * chains and writeCommandsAsync() without waiting for them; the next
+ * polled write waits for all of it.
+ *
+ * @param data
+ * @param len
+ * @param preswapped
+ */
+void Arduino_ESP32QSPI::writePixelsAsync(uint16_t *data, uint32_t len, bool preswapped)
+{
+  if (!len)
+  {
+    if (_trans_done_cb)
+    {
+      _trans_done_cb(_trans_done_user_ctx);
+    }
+    return;
+  }
+
+  if (!preswapped)
+  {
+    uint32_t i = 0;
+    if (!((uintptr_t)data & 3))
+    {
+      uint32_t *d32 = (uint32_t *)data;
+      uint32_t l2 = len >> 1;
+      for (; i < l2; ++i)
       {
-        _spi_tran_ext.base.tx_buffer = _buffer32;
-        dest = _2nd_buffer16;
+        uint32_t v = d32[i];
+        d32[i] = ((v & 0xff00ff00) >> 8) | ((v & 0x00ff00ff) << 8);
       }
-      _spi_tran_ext.base.length = out_bits;
+      i <<= 1;
+    }
+    for (; i < len; ++i)
+    {
+      MSB_16_SET(data[i], data[i]);
+    }
+  }
+
+#if ESP32QSPI_STATS
+  _stats.transactions += (len + ESP32QSPI_ASYNC_PIXELS_AT_ONCE - 1) / ESP32QSPI_ASYNC_PIXELS_AT_ONCE;
+  _stats.bytes += len << 1;
+#endif
+
+  uint32_t l;
+  bool first_send = true;
+  while (len)
+  {
+    l = (len > ESP32QSPI_ASYNC_PIXELS_AT_ONCE) ? ESP32QSPI_ASYNC_PIXELS_AT_ONCE : len;
 
-      POLL_START();
-      dest2 = dest + w;
+    uint8_t trans_flags = 0;
+    if (first_send)
+    {
+      trans_flags |= ESP32QSPI_TRANS_CS_LOW | ESP32QSPI_TRANS_START;
     }
-    POLL_END();
-    CS_HIGH();
+    if (l == len)
+    {
+      trans_flags |= ESP32QSPI_TRANS_CS_HIGH | ESP32QSPI_TRANS_DONE;
+    }
+    spi_transaction_ext_t *t = QUEUE_SLOT(trans_flags);
+
+    if (first_send)
+    {
+      t->base.flags = SPI_TRANS_MODE_QIO;
+      t->base.cmd = 0x32;
+      t->base.addr = 0x003C00;
+      first_send = false;
+    }
+    else
+    {
+      t->base.flags = SPI_TRANS_MODE_QIO | SPI_TRANS_VARIABLE_CMD |
+                      SPI_TRANS_VARIABLE_ADDR | SPI_TRANS_VARIABLE_DUMMY;
+    }
+    t->base.tx_buffer = data;
+    t->base.length = l << 4;
+
+    spi_device_queue_trans(_handle, &t->base, portMAX_DELAY);
+    ++_async_queued;
+
+    len -= l;
+    data += l;
+  }
+}
+
+/**
+ * @brief waitAsyncDone
+ *
+ */
+void Arduino_ESP32QSPI::waitAsyncDone()
+{
+  ASYNC_WAIT();
+}
+
+/**
+ * @brief getStats
+ *
+ * Counters for polled and queued transactions; a writePixelsAsync() chain
+ * counts as busy from its first transaction starting to the done callback.
+ *
+ * @param stats
+ */
+void Arduino_ESP32QSPI::getStats(esp32qspi_stats_t *stats)
+{
+  *stats = _stats;
+  stats->busy_us += _async_busy_us;
+}
+
+/**
+ * @brief lastAsyncUs
+ *
+ * Start-to-done time of the last finished writePixelsAsync() chain, with
+ * any writeCommandsAsync() ahead of it; IRAM safe so the done callback
+ * can read it.
+ *
+ * @return uint32_t
+ */
+uint32_t IRAM_ATTR Arduino_ESP32QSPI::lastAsyncUs()
+{
+  return _async_last_us;
+}
+
+/**
+ * @brief preCallback
+ *
+ * @param trans
+ */
+void IRAM_ATTR Arduino_ESP32QSPI::preCallback(spi_transaction_t *trans)
+{
+  Arduino_ESP32QSPI *bus = (Arduino_ESP32QSPI *)trans->user;
+  if (!bus) // polled transaction
+  {
+    return;
+  }
+  uint8_t trans_flags = bus->_async_flags[(spi_transaction_ext_t *)trans - bus->_async_tran_ext];
+  if (trans_flags & ESP32QSPI_TRANS_CS_LOW)
+  {
+    *bus->_csPortClr = bus->_csPinMask;
+  }
+#if ESP32QSPI_STATS
+  if ((trans_flags & ESP32QSPI_TRANS_START) && !bus->_async_start_us)
+  {
+    bus->_async_start_us = esp_timer_get_time();
   }
+#endif
 }
+
+/**
+ * @brief postCallback
+ *
+ * @param trans
+ */
+void IRAM_ATTR Arduino_ESP32QSPI::postCallback(spi_transaction_t *trans)
+{
+  Arduino_ESP32QSPI *bus = (Arduino_ESP32QSPI *)trans->user;
+  if (!bus) // polled transaction
+  {
+    return;
+  }
+  uint8_t trans_flags = bus->_async_flags[(spi_transaction_ext_t *)trans - bus->_async_tran_ext];
+  if (trans_flags & ESP32QSPI_TRANS_CS_HIGH)
+  {
+    *bus->_csPortSet = bus->_csPinMask;
+  }
+  if (trans_flags & ESP32QSPI_TRANS_DONE)
+  {
+#if ESP32QSPI_STATS
+    uint32_t us = (uint32_t)(esp_timer_get_time() - bus->_async_start_us);
+    bus->_async_start_us = 0;
+    bus->_async_last_us = us;
+    bus->_async_busy_us += us;
+#endif
+    if (bus->_trans_done_cb)
+    {
+      bus->_trans_done_cb(bus->_trans_done_user_ctx);
+    }
+  }
+}
+
 /******** low level bit twiddling **********/
 
 /**
@@ -798,6 +1206,7 @@ GFX_INLINE void Arduino_ESP32QSPI::CS_HIGH(void)
  */
 GFX_INLINE void Arduino_ESP32QSPI::CS_LOW(void)
 {
+  ASYNC_WAIT();
   *_csPortClr = _csPinMask;
 }
 
@@ -808,6 +1217,11 @@ GFX_INLINE void Arduino_ESP32QSPI::CS_LOW(void)
  */
 GFX_INLINE void Arduino_ESP32QSPI::POLL_START()
 {
+#if ESP32QSPI_STATS
+  ++_stats.transactions;
+  _stats.bytes += (_spi_tran->length + 7) >> 3;
+  _poll_start_us = esp_timer_get_time();
+#endif
   spi_device_polling_start(_handle, _spi_tran, portMAX_DELAY);
 }
 
@@ -819,6 +1233,132 @@ GFX_INLINE void Arduino_ESP32QSPI::POLL_START()
 GFX_INLINE void Arduino_ESP32QSPI::POLL_END()
 {
   spi_device_polling_end(_handle, portMAX_DELAY);
+#if ESP32QSPI_STATS
+  _stats.busy_us += (uint32_t)(esp_timer_get_time() - _poll_start_us);
+#endif
+}
+
+/**
+ * @brief ASYNC_WAIT
+ *
+ * Polled and queued transactions must not be mixed, so reclaim everything
+ * writePixelsAsync() left on the queue first.
+ *
+ * @return GFX_INLINE
+ */
+GFX_INLINE void Arduino_ESP32QSPI::ASYNC_WAIT()
+{
+  spi_transaction_t *rtrans;
+  while (_async_queued)
+  {
+    spi_device_get_trans_result(_handle, &rtrans, portMAX_DELAY);
+    --_async_queued;
+  }
+  _async_start_us = 0; // commands queued without a chain behind them never got timed
+}
+
+/**
+ * @brief QUEUE_SLOT
+ *
+ * Next free queued transaction, reclaiming the oldest when the queue is
+ * full. trans_flags tell the ISR what to do around it; 0 leaves CS to
+ * the task.
+ *
+ * @return GFX_INLINE
+ */
+GFX_INLINE spi_transaction_ext_t *Arduino_ESP32QSPI::QUEUE_SLOT(uint8_t trans_flags)
+{
+  spi_transaction_t *rtrans;
+  if (_async_queued == ESP32QSPI_QUEUE_SIZE)
+  {
+    spi_device_get_trans_result(_handle, &rtrans, portMAX_DELAY);
+    --_async_queued;
+  }
+  spi_transaction_ext_t *t = &_async_tran_ext[_async_slot];
+  _async_flags[_async_slot] = trans_flags;
+  _async_slot = (_async_slot + 1) % ESP32QSPI_QUEUE_SIZE;
+  t->base.user = this;
+  return t;
+}
+
+/**
+ * @brief QUEUE_BUFFER
+ *
+ * Next bounce buffer to pack. Results come back in queue order, so once
+ * fewer than ESP32QSPI_BUFFER_COUNT transactions are in flight, the one
+ * that last used this buffer has finished.
+ *
+ * @return GFX_INLINE
+ */
+GFX_INLINE uint8_t *Arduino_ESP32QSPI::QUEUE_BUFFER()
+{
+  spi_transaction_t *rtrans;
+  while (_async_queued >= ESP32QSPI_BUFFER_COUNT)
+  {
+    spi_device_get_trans_result(_handle, &rtrans, portMAX_DELAY);
+    --_async_queued;
+  }
+  uint8_t *buf = _ring_buffer[_ring_next];
+  _ring_next = (_ring_next + 1) % ESP32QSPI_BUFFER_COUNT;
+  return buf;
+}
+
+/**
+ * @brief QUEUE_TRANS
+ *
+ * Queue one pixel transaction and return while it is on the wire. CS is
+ * held by the caller until QUEUE_END(); only the first transaction of a
+ * chain carries the write command.
+ *
+ * @return GFX_INLINE
+ */
+GFX_INLINE void Arduino_ESP32QSPI::QUEUE_TRANS(const void *data, uint32_t bits, bool first_send)
+{
+  spi_transaction_ext_t *t = QUEUE_SLOT(0);
+
+  if (first_send)
+  {
+    t->base.flags = SPI_TRANS_MODE_QIO;
+    t->base.cmd = 0x32;
+    t->base.addr = 0x003C00;
+#if ESP32QSPI_STATS
+    _queue_start_us = esp_timer_get_time();
+#endif
+  }
+  else
+  {
+    t->base.flags = SPI_TRANS_MODE_QIO | SPI_TRANS_VARIABLE_CMD |
+                    SPI_TRANS_VARIABLE_ADDR | SPI_TRANS_VARIABLE_DUMMY;
+  }
+  t->base.tx_buffer = data;
+  t->base.length = bits;
+#if ESP32QSPI_STATS
+  ++_stats.transactions;
+  _stats.bytes += bits >> 3;
+#endif
+
+  spi_device_queue_trans(_handle, &t->base, portMAX_DELAY);
+  ++_async_queued;
+}
+
+/**
+ * @brief QUEUE_END
+ *
+ * Wait for the chain to leave the bus and release CS.
+ *
+ * @return GFX_INLINE
+ */
+GFX_INLINE void Arduino_ESP32QSPI::QUEUE_END()
+{
+  ASYNC_WAIT();
+#if ESP32QSPI_STATS
+  if (_queue_start_us)
+  {
+    _stats.busy_us += (uint32_t)(esp_timer_get_time() - _queue_start_us);
+    _queue_start_us = 0;
+  }
+#endif
+  CS_HIGH();
 }
 
 #endif // #if defined(ESP32)
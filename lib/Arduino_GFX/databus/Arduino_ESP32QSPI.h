@@ -6,8 +6,14 @@
 #include <driver/spi_master.h>
 
 #ifndef ESP32QSPI_MAX_PIXELS_AT_ONCE
-#define ESP32QSPI_MAX_PIXELS_AT_ONCE 1024
+#define ESP32QSPI_MAX_PIXELS_AT_ONCE 1024 // default chunk, see setChunkPixels()
 #endif
+#ifndef ESP32QSPI_MAX_TRANSFER_SZ
+#define ESP32QSPI_MAX_TRANSFER_SZ ((ESP32QSPI_MAX_PIXELS_AT_ONCE * 16) + 8) // DMA descriptors are sized for this
+#endif
+#define ESP32QSPI_MAX_CHUNK_PIXELS ((ESP32QSPI_MAX_TRANSFER_SZ - 8) / 2)
+#define ESP32QSPI_MIN_CHUNK_PIXELS 128 // batchOperation() stages up to 255 bytes in _buffer
+#define ESP32QSPI_BATCH_COMMANDS 16   // register writes batchOperation() compiles per writeCommandsAsync()
 #ifndef ESP32QSPI_FREQUENCY
 #define ESP32QSPI_FREQUENCY 80000000
 #endif
@@ -20,6 +26,49 @@
 #ifndef ESP32QSPI_DMA_CHANNEL
 #define ESP32QSPI_DMA_CHANNEL SPI_DMA_CH_AUTO
 #endif
+#ifndef ESP32QSPI_QUEUE_SIZE
+#define ESP32QSPI_QUEUE_SIZE 7 // one 480x68 band, 3 window commands + 4 pixel transactions; LVGL flushes the next only after flush_ready
+#endif
+#ifndef ESP32QSPI_BUFFER_COUNT
+#define ESP32QSPI_BUFFER_COUNT 2 // DMA bounce buffers: pack one while the others are on the wire
+#endif
+#ifndef ESP32QSPI_FILL_PIXELS
+#define ESP32QSPI_FILL_PIXELS (ESP32QSPI_MAX_CHUNK_PIXELS / 2) // writeRepeat() pattern, 0: use a bounce buffer
+#endif
+#if ESP32QSPI_FILL_PIXELS > ESP32QSPI_MAX_CHUNK_PIXELS
+#error "ESP32QSPI_FILL_PIXELS must not exceed ESP32QSPI_MAX_CHUNK_PIXELS"
+#endif
+#if ESP32QSPI_BUFFER_COUNT < 1 || ESP32QSPI_BUFFER_COUNT > ESP32QSPI_QUEUE_SIZE
+#error "ESP32QSPI_BUFFER_COUNT must be between 1 and ESP32QSPI_QUEUE_SIZE"
+#endif
+#ifndef ESP32QSPI_ASYNC_PIXELS_AT_ONCE
+#define ESP32QSPI_ASYNC_PIXELS_AT_ONCE ESP32QSPI_MAX_CHUNK_PIXELS
+#endif
+#ifndef ESP32QSPI_STATS
+#define ESP32QSPI_STATS 1
+#endif
+
+typedef void (*esp32qspi_trans_done_cb_t)(void *user_ctx);
+
+/**
+ * @brief Bus counters since begin(), wrapping; take differences
+ */
+typedef struct
+{
+  uint32_t transactions; ///< polled and queued transactions
+  uint32_t bytes;        ///< data phase bytes, without command and address
+  uint32_t busy_us;      ///< time with a transaction in flight
+} esp32qspi_stats_t;
+
+/**
+ * @brief Outcome of autoTuneChunkPixels()
+ */
+typedef struct
+{
+  uint32_t chunk_px;     ///< chunk size chosen
+  uint32_t overhead_ns;  ///< fixed cost per transaction, estimated
+  uint32_t bytes_per_ms; ///< throughput at chunk_px
+} esp32qspi_tune_t;
 
 class Arduino_ESP32QSPI : public Arduino_DataBus
 {
@@ -45,6 +94,7 @@ public:
 
   void writeRepeat(uint16_t p, uint32_t len) override;
   void writePixels(uint16_t *data, uint32_t len) override;
+  void writePixelsPreswapped(uint16_t *data, uint32_t len);
   void write16bitBeRGBBitmapR1(uint16_t *bitmap, int16_t w, int16_t h) override;
 
   void batchOperation(const uint8_t *operations, size_t len) override;
@@ -54,12 +104,33 @@ public:
   void writeIndexedPixelsDouble(uint8_t *data, uint16_t *idx, uint32_t len) override;
   void writeYCbCrPixels(uint8_t *yData, uint8_t *cbData, uint8_t *crData, uint16_t w, uint16_t h) override;
 
+  void setTransDoneCallback(esp32qspi_trans_done_cb_t cb, void *user_ctx);
+  void writeCommandsAsync(const panel_command_t *cmds, uint8_t count);
+  void writePixelsAsync(uint16_t *data, uint32_t len, bool preswapped = false);
+  void waitAsyncDone();
+
+  void getStats(esp32qspi_stats_t *stats);
+  uint32_t lastAsyncUs();
+
+  bool setChunkPixels(uint32_t px);
+  uint32_t getChunkPixels();
+  bool autoTuneChunkPixels(size_t ram_budget, uint32_t len, esp32qspi_tune_t *result = nullptr);
+
 protected:
 private:
+  static void preCallback(spi_transaction_t *trans);
+  static void postCallback(spi_transaction_t *trans);
+  void writeRepeatChunked(uint16_t p, uint32_t len);
+
   GFX_INLINE void CS_HIGH(void);
   GFX_INLINE void CS_LOW(void);
   GFX_INLINE void POLL_START();
   GFX_INLINE void POLL_END();
+  GFX_INLINE void ASYNC_WAIT();
+  GFX_INLINE spi_transaction_ext_t *QUEUE_SLOT(uint8_t trans_flags);
+  GFX_INLINE uint8_t *QUEUE_BUFFER();
+  GFX_INLINE void QUEUE_TRANS(const void *data, uint32_t bits, bool first_send);
+  GFX_INLINE void QUEUE_END();
 
   int8_t _cs, _sck, _mosi, _miso, _quadwp, _quadhd;
   bool _is_shared_interface;
@@ -72,18 +143,41 @@ private:
   spi_transaction_ext_t _spi_tran_ext;
   spi_transaction_t *_spi_tran;
 
+  // queued transactions, reclaimed lazily before the next polled one; the
+  // pixel writers keep up to ESP32QSPI_BUFFER_COUNT of them in flight
+  spi_transaction_ext_t _async_tran_ext[ESP32QSPI_QUEUE_SIZE];
+  uint8_t _async_flags[ESP32QSPI_QUEUE_SIZE]; // ESP32QSPI_TRANS_*, read by the ISR
+  uint8_t _async_slot = 0;
+  uint8_t _async_queued = 0;
+  esp32qspi_trans_done_cb_t _trans_done_cb = nullptr;
+  void *_trans_done_user_ctx = nullptr;
+
+  // polled counters are kept by the caller's task, async time by the ISR
+  esp32qspi_stats_t _stats = {};
+  int64_t _poll_start_us = 0;
+  int64_t _queue_start_us = 0;
+  int64_t _async_start_us = 0;
+  volatile uint32_t _async_busy_us = 0;
+  volatile uint32_t _async_last_us = 0;
+
   union
   {
     uint8_t* _buffer;
     uint16_t* _buffer16;
     uint32_t* _buffer32;
   };
+  uint8_t *_ring_buffer[ESP32QSPI_BUFFER_COUNT] = {};
+  uint8_t _ring_next = 0;
+  uint32_t _chunk_px = ESP32QSPI_MAX_PIXELS_AT_ONCE; // pixels per packed transaction
+
+  // constant-colour pattern for writeRepeat(), valid for _fill_len pixels
   union
   {
-    uint8_t *_2nd_buffer;
-    uint16_t *_2nd_buffer16;
-    uint32_t *_2nd_buffer32;
+    uint8_t *_fill_buffer = nullptr;
+    uint32_t *_fill_buffer32;
   };
+  uint32_t _fill_len = 0;
+  uint16_t _fill_color = 0;
 };
 
 #endif // #if defined(ESP32)
@@ -49,12 +49,52 @@ void Arduino_NV3041A::setRotation(uint8_t r)
 
 void Arduino_NV3041A::writeAddrWindow(int16_t x, int16_t y, uint16_t w, uint16_t h)
 {
+  panel_command_t cmds[NV3041A_WINDOW_COMMANDS];
+  uint8_t count = encodeAddrWindow(x, y, w, h, cmds);
+  for (uint8_t i = 0; i < count; ++i)
+  {
+    if (cmds[i].len)
+    {
+      _bus->writeC8D16D16Split(cmds[i].cmd, (cmds[i].data[0] << 8) | cmds[i].data[1],
+                               (cmds[i].data[2] << 8) | cmds[i].data[3]);
+    }
+    else
+    {
+      _bus->writeCommand(cmds[i].cmd); // write to RAM
+    }
+  }
+}
+
+static void encodeC8D16D16(panel_command_t *cmd, uint8_t c, uint16_t d1, uint16_t d2)
+{
+  cmd->cmd = c;
+  cmd->len = 4;
+  cmd->data[0] = d1 >> 8;
+  cmd->data[1] = d1;
+  cmd->data[2] = d2 >> 8;
+  cmd->data[3] = d2;
+}
+
+/**
+ * @brief encodeAddrWindow
+ *
+ * The commands writeAddrWindow() would send, for a bus that queues them
+ * ahead of the pixels, e.g. Arduino_ESP32QSPI::writeCommandsAsync().
+ * Unchanged column or row ranges are skipped, as they are there; RAMWR
+ * always comes last.
+ *
+ * @param cmds room for NV3041A_WINDOW_COMMANDS
+ * @return number of commands
+ */
+uint8_t Arduino_NV3041A::encodeAddrWindow(int16_t x, int16_t y, uint16_t w, uint16_t h, panel_command_t *cmds)
+{
+  uint8_t count = 0;
   if ((x != _currentX) || (w != _currentW))
   {
     _currentX = x;
     _currentW = w;
     x += _xStart;
-    _bus->writeC8D16D16Split(NV3041A_CASET, x, x + w - 1);
+    encodeC8D16D16(&cmds[count++], NV3041A_CASET, x, x + w - 1);
   }
 
   if ((y != _currentY) || (h != _currentH))
@@ -62,10 +102,13 @@ void Arduino_NV3041A::writeAddrWindow(int16_t x, int16_t y, uint16_t w, uint16_t
     _currentY = y;
     _currentH = h;
     y += _yStart;
-    _bus->writeC8D16D16Split(NV3041A_RASET, y, y + h - 1);
+    encodeC8D16D16(&cmds[count++], NV3041A_RASET, y, y + h - 1);
   }
 
-  _bus->writeCommand(NV3041A_RAMWR); // write to RAM
+  cmds[count].cmd = NV3041A_RAMWR;
+  cmds[count].len = 0;
+  ++count;
+  return count;
 }
 
 void Arduino_NV3041A::invertDisplay(bool i)
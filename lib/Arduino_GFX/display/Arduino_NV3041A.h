@@ -10,6 +10,7 @@
 #define NV3041A_RST_DELAY 120    ///< delay ms wait for reset finish
 #define NV3041A_SLPIN_DELAY 120  ///< delay ms wait for sleep in finish
 #define NV3041A_SLPOUT_DELAY 120 ///< delay ms wait for sleep out finish
+#define NV3041A_WINDOW_COMMANDS 3 ///< CASET, RASET and RAMWR at most
 
 #define NV3041A_NOP 0x00
 #define NV3041A_SWRESET 0x01
@@ -319,6 +320,7 @@ public:
   void setRotation(uint8_t r) override;
 
   void writeAddrWindow(int16_t x, int16_t y, uint16_t w, uint16_t h) override;
+  uint8_t encodeAddrWindow(int16_t x, int16_t y, uint16_t w, uint16_t h, panel_command_t *cmds);
 
   void invertDisplay(bool) override;
   void displayOn() override;
@@ -0,0 +1,61 @@
+// boot_graph.cpp - runs startup steps as FreeRTOS tasks in dependency order
+#include "boot_graph.h"
+
+#include <string.h>
+
+#include "boot_trace.h"
+
+bool boot_graph_init(BootGraph* g) {
+    memset(g, 0, sizeof(*g));
+    g->done = xEventGroupCreate();
+    return g->done != nullptr;
+}
+
+BootStepMask boot_graph_add(BootGraph* g, const char* name, boot_step_fn fn, BootStepMask deps,
+                            BaseType_t core, uint32_t stack) {
+    if (g->count >= BOOT_GRAPH_MAX_STEPS)
+        return 0;
+    BootStep* s = &g->steps[g->count];
+    s->name = name;
+    s->fn = fn;
+    s->deps = deps & boot_graph_all(g); // unknown bits would never be set
+    s->core = core;
+    s->stack = stack;
+    s->graph = g;
+    return 1u << g->count++;
+}
+
+static void step_task(void* arg) {
+    BootStep* s = (BootStep*)arg;
+    BootGraph* g = s->graph;
+    if (s->deps)
+        xEventGroupWaitBits(g->done, s->deps, pdFALSE, pdTRUE, portMAX_DELAY);
+    boot_trace_begin(s->name);
+    s->fn();
+    boot_trace_end(s->name);
+    xEventGroupSetBits(g->done, 1u << (s - g->steps));
+    vTaskDelete(nullptr);
+}
+
+bool boot_graph_start(BootGraph* g) {
+    UBaseType_t priority = uxTaskPriorityGet(nullptr);
+    bool ok = true;
+    for (int i = 0; i < g->count; ++i) {
+        BootStep* s = &g->steps[i];
+        if (xTaskCreatePinnedToCore(step_task, s->name, s->stack, s, priority, nullptr, s->core) != pdPASS) {
+            // Mark it done so waiters are not stuck behind a step that never ran
+            xEventGroupSetBits(g->done, 1u << i);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool boot_graph_wait(BootGraph* g, BootStepMask steps, TickType_t timeout) {
+    EventBits_t bits = xEventGroupWaitBits(g->done, steps, pdFALSE, pdTRUE, timeout);
+    return (bits & steps) == steps;
+}
+
+BootStepMask boot_graph_all(const BootGraph* g) {
+    return g->count ? (BootStepMask)((1u << g->count) - 1) : 0;
+}
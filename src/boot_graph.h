@@ -0,0 +1,44 @@
+// boot_graph.h - runs startup steps as FreeRTOS tasks in dependency order
+#pragma once
+
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <freertos/task.h>
+
+#define BOOT_GRAPH_MAX_STEPS 16     // one event group bit each, 24 available
+
+// One bit per step, as returned by boot_graph_add()
+typedef uint32_t BootStepMask;
+typedef void (*boot_step_fn)();
+
+struct BootGraph;
+
+struct BootStep {
+    const char* name;               // task name and boot_trace phase
+    boot_step_fn fn;
+    BootStepMask deps;
+    BaseType_t core;                // or tskNO_AFFINITY
+    uint32_t stack;
+    BootGraph* graph;
+};
+
+struct BootGraph {
+    EventGroupHandle_t done;        // bit i set once step i has returned
+    uint8_t count;
+    BootStep steps[BOOT_GRAPH_MAX_STEPS];
+};
+
+// False if the event group cannot be created
+bool boot_graph_init(BootGraph* g);
+// Steps may only depend on steps added before them, so the graph cannot
+// have cycles. Returns the new step's bit, 0 if the graph is full.
+BootStepMask boot_graph_add(BootGraph* g, const char* name, boot_step_fn fn, BootStepMask deps,
+                            BaseType_t core, uint32_t stack);
+// Creates one task per step at the caller's priority; each waits for its
+// dependencies, runs, sets its bit and deletes itself. The graph must stay
+// alive until every step has finished. False if a task cannot be created.
+bool boot_graph_start(BootGraph* g);
+// Blocks until all the given steps have finished; false on timeout
+bool boot_graph_wait(BootGraph* g, BootStepMask steps, TickType_t timeout);
+BootStepMask boot_graph_all(const BootGraph* g);
@@ -0,0 +1,138 @@
+// boot_trace.cpp - timestamped startup phases, dumped as Chrome trace JSON
+#include "boot_trace.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(ESP_PLATFORM)
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+static int64_t trace_now_us() { return esp_timer_get_time(); }
+static uint8_t trace_tid() { return (uint8_t)xPortGetCoreID(); }
+#else
+#include <time.h>
+static int64_t trace_now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+static uint8_t trace_tid() { return 0; }
+#endif
+
+static BootTraceEvent trace_events[BOOT_TRACE_MAX_EVENTS];
+static int trace_next = 0;  // slots handed out
+static int trace_done = 0;  // slots filled in, in order
+
+static void record(const char* name, uint8_t phase, int64_t ts) {
+    int i = __atomic_fetch_add(&trace_next, 1, __ATOMIC_RELAXED);
+    if (i >= BOOT_TRACE_MAX_EVENTS)
+        return;
+    trace_events[i].ts_us = ts;
+    trace_events[i].name = name;
+    trace_events[i].phase = phase;
+    trace_events[i].tid = trace_tid();
+    // Publish in slot order so readers never see a half-written event
+    int expected = i;
+    while (!__atomic_compare_exchange_n(&trace_done, &expected, i + 1, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        expected = i;
+}
+
+void boot_trace_begin(const char* name) {
+    record(name, BOOT_TRACE_BEGIN, trace_now_us());
+}
+
+void boot_trace_end(const char* name) {
+    record(name, BOOT_TRACE_END, trace_now_us());
+}
+
+void boot_trace_instant(const char* name) {
+    record(name, BOOT_TRACE_INSTANT, trace_now_us());
+}
+
+void boot_trace_instant_at(const char* name, int64_t ts_us) {
+    record(name, BOOT_TRACE_INSTANT, ts_us);
+}
+
+int boot_trace_count() {
+    return __atomic_load_n(&trace_done, __ATOMIC_ACQUIRE);
+}
+
+const BootTraceEvent* boot_trace_events() {
+    return trace_events;
+}
+
+// ---- encoding ----
+
+// Copies s as a JSON string body; names are literals, so only quotes,
+// backslashes and control characters need care
+static size_t escape(const char* s, char* out, size_t len) {
+    size_t n = 0;
+    for (; *s && n + 7 < len; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            out[n++] = '\\';
+            out[n++] = c;
+        } else if (c < 0x20) {
+            n += snprintf(out + n, len - n, "\\u%04x", c);
+        } else {
+            out[n++] = c;
+        }
+    }
+    out[n] = '\0';
+    return n;
+}
+
+void boot_trace_write_json(const BootTraceEvent* events, int count, boot_trace_write_fn write, void* ctx) {
+    static const char head[] = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    write(head, sizeof(head) - 1, ctx);
+    for (int i = 0; i < count; ++i) {
+        const BootTraceEvent* e = &events[i];
+        char name[64], line[160];
+        escape(e->name, name, sizeof(name));
+        int n = snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":1,\"tid\":%u%s}",
+                         i ? "," : "", name, e->phase, (long long)e->ts_us, (unsigned)e->tid,
+                         e->phase == BOOT_TRACE_INSTANT ? ",\"s\":\"g\"" : "");
+        write(line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1, ctx);
+    }
+    write("]}", 2, ctx);
+}
+
+// Appends like snprintf at pos, keeping count of what did not fit
+static size_t append(char* buf, size_t len, size_t pos, const char* s) {
+    size_t n = strlen(s);
+    if (pos < len) {
+        size_t room = len - pos - 1;
+        size_t copy = n < room ? n : room;
+        memcpy(buf + pos, s, copy);
+        buf[pos + copy] = '\0';
+    }
+    return pos + n;
+}
+
+size_t boot_trace_summary_json(const BootTraceEvent* events, int count, char* buf, size_t len) {
+    size_t pos = append(buf, len, 0, "{");
+    bool first = true;
+    for (int i = 0; i < count; ++i) {
+        const BootTraceEvent* e = &events[i];
+        int64_t ms;
+        if (e->phase == BOOT_TRACE_INSTANT) {
+            ms = e->ts_us / 1000;
+        } else if (e->phase == BOOT_TRACE_BEGIN) {
+            int j = i + 1;
+            while (j < count && !(events[j].phase == BOOT_TRACE_END && strcmp(events[j].name, e->name) == 0))
+                ++j;
+            if (j == count)
+                continue; // still open
+            ms = (events[j].ts_us - e->ts_us) / 1000;
+        } else {
+            continue;
+        }
+        char name[64], item[96];
+        escape(e->name, name, sizeof(name));
+        snprintf(item, sizeof(item), "%s\"%s\":%lld", first ? "" : ",", name, (long long)ms);
+        pos = append(buf, len, pos, item);
+        first = false;
+    }
+    return append(buf, len, pos, "}");
+}
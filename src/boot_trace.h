@@ -0,0 +1,37 @@
+// boot_trace.h - timestamped startup phases, dumped as Chrome trace JSON
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BOOT_TRACE_MAX_EVENTS 64
+
+// Chrome trace event phases
+#define BOOT_TRACE_BEGIN 'B'
+#define BOOT_TRACE_END 'E'
+#define BOOT_TRACE_INSTANT 'i'
+
+struct BootTraceEvent {
+    int64_t ts_us;
+    const char* name;               // must outlive the trace, normally a literal
+    uint8_t phase;
+    uint8_t tid;                    // core the event was recorded on
+};
+
+// Recording is lock-free and safe from any task; events past
+// BOOT_TRACE_MAX_EVENTS are dropped
+void boot_trace_begin(const char* name);
+void boot_trace_end(const char* name);
+void boot_trace_instant(const char* name);
+// For milestones stamped where recording is not allowed, e.g. in an ISR
+void boot_trace_instant_at(const char* name, int64_t ts_us);
+int boot_trace_count();
+const BootTraceEvent* boot_trace_events();
+
+typedef void (*boot_trace_write_fn)(const char* s, size_t len, void* ctx);
+
+// {"traceEvents":[...]} for chrome://tracing or Perfetto, written in pieces
+void boot_trace_write_json(const BootTraceEvent* events, int count, boot_trace_write_fn write, void* ctx);
+// {"name":ms,...}: durations of begin/end pairs, times of instants; returns
+// the length, or the length needed when it did not fit
+size_t boot_trace_summary_json(const BootTraceEvent* events, int count, char* buf, size_t len);
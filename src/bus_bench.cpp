@@ -0,0 +1,145 @@
+// bus_bench.cpp - QSPI throughput of each pixel writer, for a boot-time check
+#include "bus_bench.h"
+
+#include <Arduino_GFX_Library.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+#define BUS_BENCH_BAND_ROWS 16      // even, for the 4:2:0 YCbCr writer
+
+enum BusBenchMethod {
+    BENCH_PIXELS,
+    BENCH_PIXELS_PRESWAPPED,
+    BENCH_PIXELS_ASYNC,
+    BENCH_REPEAT,
+    BENCH_INDEXED,
+    BENCH_INDEXED_DOUBLE,
+    BENCH_YCBCR,
+    BENCH_BYTES,
+};
+
+static const char* const method_names[BUS_BENCH_METHODS] = {
+    "writePixels", "writePixelsPreswapped", "writePixelsAsync", "writeRepeat",
+    "writeIndexedPixels", "writeIndexedPixelsDouble", "writeYCbCrPixels", "writeBytes",
+};
+
+struct BenchSource {
+    uint16_t* pixels;               // one band, DMA capable so the in-place paths are taken
+    uint8_t* index;
+    uint16_t palette[256];
+    uint8_t* y;
+    uint8_t* cb;
+    uint8_t* cr;
+};
+
+// One band of rows with the given method
+static void write_band(Arduino_ESP32QSPI* bus, int method, BenchSource* src, int16_t w, int16_t rows) {
+    uint32_t px = (uint32_t)w * rows;
+    switch (method) {
+    case BENCH_PIXELS:
+        bus->writePixels(src->pixels, px);
+        break;
+    case BENCH_PIXELS_PRESWAPPED:
+        bus->writePixelsPreswapped(src->pixels, px);
+        break;
+    case BENCH_PIXELS_ASYNC:
+        bus->writePixelsAsync(src->pixels, px, true);
+        bus->waitAsyncDone();
+        break;
+    case BENCH_REPEAT:
+        bus->writeRepeat(0x07e0, px);
+        break;
+    case BENCH_INDEXED:
+        bus->writeIndexedPixels(src->index, src->palette, px);
+        break;
+    case BENCH_INDEXED_DOUBLE:
+        bus->writeIndexedPixelsDouble(src->index, src->palette, px / 2);
+        break;
+    case BENCH_YCBCR:
+        bus->writeYCbCrPixels(src->y, src->cb, src->cr, w, rows);
+        break;
+    case BENCH_BYTES:
+        bus->writeBytes((uint8_t*)src->pixels, px * 2);
+        break;
+    }
+}
+
+int bus_bench_run(Arduino_ESP32QSPI* bus, Arduino_TFT* panel, int16_t w, int16_t h, BusBenchResult* out) {
+    uint32_t band_px = (uint32_t)w * BUS_BENCH_BAND_ROWS;
+    BenchSource src;
+    src.pixels = (uint16_t*)heap_caps_aligned_alloc(16, band_px * 2, MALLOC_CAP_DMA);
+    src.index = (uint8_t*)malloc(band_px);
+    src.y = (uint8_t*)malloc(band_px);
+    src.cb = (uint8_t*)malloc(band_px / 4);
+    src.cr = (uint8_t*)malloc(band_px / 4);
+    int count = 0;
+    if (src.pixels && src.index && src.y && src.cb && src.cr) {
+        for (uint32_t i = 0; i < band_px; ++i) {
+            src.pixels[i] = (uint16_t)(i * 2654435761u >> 16);
+            src.index[i] = (uint8_t)i;
+            src.y[i] = (uint8_t)(i >> 2);
+        }
+        for (uint32_t i = 0; i < band_px / 4; ++i) {
+            src.cb[i] = (uint8_t)i;
+            src.cr[i] = (uint8_t)~i;
+        }
+        for (int i = 0; i < 256; ++i)
+            src.palette[i] = (uint16_t)(i * 0x0101);
+
+        for (int m = 0; m < BUS_BENCH_METHODS; ++m) {
+            panel->startWrite();
+            panel->writeAddrWindow(0, 0, w, h);
+            int64_t start = esp_timer_get_time();
+            for (int16_t y = 0; y < h; y += BUS_BENCH_BAND_ROWS) {
+                int16_t rows = h - y < BUS_BENCH_BAND_ROWS ? h - y : BUS_BENCH_BAND_ROWS;
+                write_band(bus, m, &src, w, rows);
+            }
+            out[count].us = (uint32_t)(esp_timer_get_time() - start);
+            panel->endWrite();
+            out[count].name = method_names[m];
+            out[count].bytes = (uint32_t)w * h * 2;
+            ++count;
+        }
+    }
+    heap_caps_free(src.pixels);
+    free(src.index);
+    free(src.y);
+    free(src.cb);
+    free(src.cr);
+    return count;
+}
+
+static void swap_band(uint16_t* band, uint32_t px) {
+    for (uint32_t i = 0; i < px; ++i)
+        band[i] = (uint16_t)(band[i] << 8 | band[i] >> 8);
+}
+
+static uint32_t time_band(Arduino_ESP32QSPI* bus, Arduino_TFT* panel, int method, uint16_t* band,
+                          int16_t x, int16_t y, int16_t w, int16_t h) {
+    panel->startWrite();
+    panel->writeAddrWindow(x, y, w, h);
+    int64_t start = esp_timer_get_time();
+    if (method == BENCH_PIXELS)
+        bus->writePixels(band, (uint32_t)w * h);
+    else
+        bus->writePixelsPreswapped(band, (uint32_t)w * h);
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+    panel->endWrite();
+    return us;
+}
+
+void bus_bench_band(Arduino_ESP32QSPI* bus, Arduino_TFT* panel, uint16_t* band, int16_t x, int16_t y,
+                    int16_t w, int16_t h, bool big_endian, BusBenchResult* out) {
+    uint32_t px = (uint32_t)w * h;
+    if (big_endian)
+        swap_band(band, px);            // writePixels() takes native order
+    out[0].us += time_band(bus, panel, BENCH_PIXELS, band, x, y, w, h);
+    swap_band(band, px);
+    out[1].us += time_band(bus, panel, BENCH_PIXELS_PRESWAPPED, band, x, y, w, h);
+    if (!big_endian)
+        swap_band(band, px);
+    for (int i = 0; i < BUS_BENCH_BAND_RESULTS; ++i) {
+        out[i].name = method_names[i];
+        out[i].bytes += px * 2;
+    }
+}
@@ -0,0 +1,33 @@
+// bus_bench.h - QSPI throughput of each pixel writer, for a boot-time check
+#pragma once
+
+#include <stdint.h>
+
+class Arduino_ESP32QSPI;
+class Arduino_TFT;
+
+#define BUS_BENCH_METHODS 8
+#define BUS_BENCH_BAND_RESULTS 2    // bus_bench_band(): writePixels, writePixelsPreswapped
+
+struct BusBenchResult {
+    const char* name;               // Arduino_ESP32QSPI method
+    uint32_t bytes;                 // pixel bytes put on the wire
+    uint32_t us;
+};
+
+// Fills the w x h window with each writer in turn, a band of source data at
+// a time, so it overwrites the screen. Run before a done callback is set on
+// the bus: the writePixelsAsync() pass would fire it. Returns the number of
+// results, 0 if the source buffers cannot be allocated.
+int bus_bench_run(Arduino_ESP32QSPI* bus, Arduino_TFT* panel, int16_t w, int16_t h, BusBenchResult* out);
+// Sends a band LVGL rendered to its own window with writePixels() and then
+// writePixelsPreswapped(), adding the times to out[0] and out[1] (zeroed
+// by the caller), so a frame accumulates band by band. The band is
+// byte-swapped in place for whichever writer needs the other order and is
+// left as it came in; big_endian tells which order that is.
+void bus_bench_band(Arduino_ESP32QSPI* bus, Arduino_TFT* panel, uint16_t* band, int16_t x, int16_t y,
+                    int16_t w, int16_t h, bool big_endian, BusBenchResult* out);
+// Wire throughput in bytes per ms, i.e. kB/s
+inline uint32_t bus_bench_bytes_per_ms(const BusBenchResult* r) {
+    return r->us ? (uint32_t)((uint64_t)r->bytes * 1000 / r->us) : 0;
+}
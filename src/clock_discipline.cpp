@@ -0,0 +1,90 @@
+// clock_discipline.cpp - hybrid PLL/FLL steering a monotonic timebase to UTC
+#include "clock_discipline.h"
+
+#include <string.h>
+
+#define PLL_TC_FACTOR 4             // PLL time constant in poll intervals
+
+static int64_t abs64(int64_t v) {
+    return v < 0 ? -v : v;
+}
+
+static int64_t clamp64(int64_t v, int64_t lo, int64_t hi) {
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+void clock_discipline_init(ClockDiscipline* d, int64_t freq_ppb) {
+    memset(d, 0, sizeof(*d));
+    d->freq_ppb = clamp64(freq_ppb, -CLOCK_MAX_FREQ_PPB, CLOCK_MAX_FREQ_PPB);
+    d->poll_s = CLOCK_POLL_MIN_S;
+}
+
+void clock_discipline_seed(ClockDiscipline* d, int64_t utc_us, int64_t mono_us) {
+    d->base_utc_us = utc_us;
+    d->base_mono_us = mono_us;
+    d->slew_us = 0;
+    d->slew_len_us = 0;
+}
+
+static int64_t slew_progress(const ClockDiscipline* d, int64_t dt) {
+    if (!d->slew_len_us || dt >= d->slew_len_us)
+        return d->slew_us;
+    return dt <= 0 ? 0 : d->slew_us * dt / d->slew_len_us;
+}
+
+int64_t clock_discipline_now(const ClockDiscipline* d, int64_t mono_us) {
+    int64_t dt = mono_us - d->base_mono_us;
+    return d->base_utc_us + dt + dt * d->freq_ppb / 1000000000 + slew_progress(d, dt);
+}
+
+bool clock_discipline_slewing(const ClockDiscipline* d, int64_t mono_us) {
+    return d->slew_len_us && mono_us - d->base_mono_us < d->slew_len_us;
+}
+
+ClockUpdate clock_discipline_update(ClockDiscipline* d, int64_t offset_us, int64_t jitter_us, int64_t mono_us) {
+    // Rebase on the current reading; an unfinished slew is dropped since
+    // offset_us already measures everything that is left
+    d->base_utc_us = clock_discipline_now(d, mono_us);
+    d->base_mono_us = mono_us;
+    d->slew_us = 0;
+    d->slew_len_us = 0;
+
+    if (!d->valid || abs64(offset_us) > CLOCK_STEP_US) {
+        d->base_utc_us += offset_us;
+        d->valid = true;
+        d->last_update_mono_us = mono_us;
+        d->poll_s = CLOCK_POLL_MIN_S;
+        d->poll_count = 0;
+        return CLOCK_UPDATE_STEP;
+    }
+
+    // Frequency: PLL integral term, plus the FLL term once updates are far
+    // enough apart that the offset is dominated by drift rather than jitter
+    int64_t mu_s = (mono_us - d->last_update_mono_us) / 1000000;
+    if (mu_s < 1)
+        mu_s = 1;
+    int64_t tc_s = (int64_t)PLL_TC_FACTOR * d->poll_s;
+    int64_t df = offset_us * 1000 * mu_s / (tc_s * tc_s);
+    if (mu_s >= CLOCK_ALLAN_S)
+        df += offset_us * 1000 / mu_s / 4;
+    d->freq_ppb = clamp64(d->freq_ppb + df, -CLOCK_MAX_FREQ_PPB, CLOCK_MAX_FREQ_PPB);
+
+    // Phase: spread the offset out at no more than CLOCK_MAX_SLEW_PPM
+    d->slew_us = offset_us;
+    d->slew_len_us = abs64(offset_us) * 1000000 / CLOCK_MAX_SLEW_PPM;
+    d->last_update_mono_us = mono_us;
+
+    // Lengthen the poll interval while offsets stay within the noise,
+    // shorten it as soon as one does not
+    if (abs64(offset_us) < 4 * (jitter_us > 1000 ? jitter_us : 1000)) {
+        if (++d->poll_count >= CLOCK_POLL_LIMIT && d->poll_s < CLOCK_POLL_MAX_S) {
+            d->poll_s *= 2;
+            d->poll_count = 0;
+        }
+    } else {
+        d->poll_count = 0;
+        if (d->poll_s > CLOCK_POLL_MIN_S)
+            d->poll_s /= 2;
+    }
+    return CLOCK_UPDATE_SLEW;
+}
@@ -0,0 +1,42 @@
+// clock_discipline.h - hybrid PLL/FLL steering a monotonic timebase to UTC
+#pragma once
+
+#include <stdint.h>
+
+#define CLOCK_STEP_US 128000        // larger offsets are stepped
+#define CLOCK_MAX_FREQ_PPB 500000   // frequency correction limit, +-500 ppm
+#define CLOCK_MAX_SLEW_PPM 500      // phase corrections are spread at this rate
+#define CLOCK_POLL_MIN_S 64
+#define CLOCK_POLL_MAX_S 2048
+#define CLOCK_ALLAN_S 1024          // above this poll interval the FLL takes over
+#define CLOCK_POLL_LIMIT 4          // quiet updates before the poll interval doubles
+
+enum ClockUpdate : uint8_t {
+    CLOCK_UPDATE_STEP,
+    CLOCK_UPDATE_SLEW,
+};
+
+// UTC(mono) = base_utc + (mono - base_mono) * (1 + freq) + slew progress.
+// All times are microseconds; mono is any monotonic clock, e.g. esp_timer.
+struct ClockDiscipline {
+    bool valid;
+    int64_t base_mono_us;
+    int64_t base_utc_us;
+    int64_t freq_ppb;               // rate correction, parts per billion
+    int64_t slew_us;                // phase correction being spread out
+    int64_t slew_len_us;
+    int64_t last_update_mono_us;
+    uint32_t poll_s;
+    int8_t poll_count;
+};
+
+// freq_ppb is the drift learned earlier, e.g. restored from flash
+void clock_discipline_init(ClockDiscipline* d, int64_t freq_ppb);
+// Starts the timebase from an unverified reading, e.g. the system clock;
+// `valid` stays false until the first update
+void clock_discipline_seed(ClockDiscipline* d, int64_t utc_us, int64_t mono_us);
+int64_t clock_discipline_now(const ClockDiscipline* d, int64_t mono_us);
+// True while a phase correction is still being spread out
+bool clock_discipline_slewing(const ClockDiscipline* d, int64_t mono_us);
+// Feeds one measured offset (UTC minus this clock) taken at mono_us
+ClockUpdate clock_discipline_update(ClockDiscipline* d, int64_t offset_us, int64_t jitter_us, int64_t mono_us);
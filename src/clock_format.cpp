@@ -0,0 +1,112 @@
+// clock_format.cpp - incremental HH:MM:SS text and calendar date formatting
+#include "clock_format.h"
+#include "zone_offset.h"
+
+#include <string.h>
+
+static const char* const weekday_names[] = {
+    "Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"};
+static const char* const month_names[] = {
+    "January", "February", "March", "April", "May", "June",
+    "July", "August", "September", "October", "November", "December"};
+
+static int64_t day_of(int64_t local) {
+    return local / 86400 - (local % 86400 < 0);
+}
+
+// Full re-derivation, used on the first tick and after steps or zone changes
+static void digits_from_local(char* text, int64_t local) {
+    int32_t secs = (int32_t)(local - day_of(local) * 86400);
+    int h = secs / 3600, m = (secs / 60) % 60, s = secs % 60;
+    text[0] = '0' + h / 10;
+    text[1] = '0' + h % 10;
+    text[2] = ':';
+    text[3] = '0' + m / 10;
+    text[4] = '0' + m % 10;
+    text[5] = ':';
+    text[6] = '0' + s / 10;
+    text[7] = '0' + s % 10;
+}
+
+void clock_digits_init(ClockDigits* c) {
+    memset(c->text, ' ', CLOCK_TEXT_LEN);
+    c->text[CLOCK_TEXT_LEN] = '\0';
+    c->local = INT64_MIN;
+}
+
+uint16_t clock_digits_advance(ClockDigits* c, int64_t local) {
+    char* t = c->text;
+    if (c->local != INT64_MIN && local == c->local + 1) {
+        c->local = local;
+        // Ripple from the seconds digit; most ticks touch one character
+        if (++t[7] <= '9')
+            return 1 << 7;
+        t[7] = '0';
+        if (++t[6] <= '5')
+            return 3 << 6;
+        t[6] = '0';
+        if (++t[4] <= '9')
+            return 0xD0;
+        t[4] = '0';
+        if (++t[3] <= '5')
+            return 0xD8;
+        t[3] = '0';
+        if (t[0] == '2' && t[1] == '3') {
+            t[0] = t[1] = '0';
+            return CLOCK_CHANGED_DAY | 0xDB;
+        }
+        if (++t[1] <= '9')
+            return 0xDA;
+        t[1] = '0';
+        ++t[0];
+        return 0xDB;
+    }
+
+    char prev[CLOCK_TEXT_LEN];
+    memcpy(prev, t, CLOCK_TEXT_LEN);
+    digits_from_local(t, local);
+    uint16_t changed = 0;
+    for (int i = 0; i < CLOCK_TEXT_LEN; ++i)
+        if (t[i] != prev[i])
+            changed |= 1 << i;
+    if (c->local == INT64_MIN || day_of(local) != day_of(c->local))
+        changed |= CLOCK_CHANGED_DAY;
+    c->local = local;
+    return changed;
+}
+
+// Appends s at *pos, truncating at len - 1
+static void put(char* buf, size_t len, size_t* pos, const char* s) {
+    while (*s && *pos + 1 < len)
+        buf[(*pos)++] = *s++;
+}
+
+static void put_uint(char* buf, size_t len, size_t* pos, uint32_t v) {
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    while (n && *pos + 1 < len)
+        buf[(*pos)++] = digits[--n];
+}
+
+size_t clock_format_date(int64_t local, char* buf, size_t len) {
+    if (!len)
+        return 0;
+    struct tm t;
+    zone_local_tm(local, &t);
+    size_t pos = 0;
+    put(buf, len, &pos, weekday_names[t.tm_wday]);
+    put(buf, len, &pos, ", ");
+    if (t.tm_mday < 10)
+        put(buf, len, &pos, "0");
+    put_uint(buf, len, &pos, t.tm_mday);
+    put(buf, len, &pos, " ");
+    put(buf, len, &pos, month_names[t.tm_mon]);
+    put(buf, len, &pos, " ");
+    put_uint(buf, len, &pos, t.tm_year + 1900);
+    buf[pos] = '\0';
+    return pos;
+}
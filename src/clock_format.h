@@ -0,0 +1,26 @@
+// clock_format.h - incremental HH:MM:SS text and calendar date formatting
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLOCK_TEXT_LEN 8            // "HH:MM:SS"
+#define CLOCK_DATE_MAX 32           // "Wednesday, 30 September 2026"
+
+// Change mask: bit i set when character i of the text changed
+#define CLOCK_CHANGED_TEXT 0x00FF
+#define CLOCK_CHANGED_DAY 0x0100    // local date changed (midnight or a jump)
+
+// Time of day of one zone kept as display characters, advanced in place
+struct ClockDigits {
+    char text[CLOCK_TEXT_LEN + 1];
+    int64_t local;                  // local time shown, seconds since 1970
+};
+
+void clock_digits_init(ClockDigits* c);
+// Moves the text to `local` and returns the change mask. A one-second step
+// ripples the digits with compares only; any other step re-derives them.
+uint16_t clock_digits_advance(ClockDigits* c, int64_t local);
+
+// "Thursday, 16 October 2026" into buf, no strftime; returns the length
+size_t clock_format_date(int64_t local, char* buf, size_t len);
@@ -0,0 +1,127 @@
+// digit_atlas.cpp - clock glyphs blended once into RGB565 cells and drawn as images
+#include "digit_atlas.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <esp_timer.h>
+
+// LVGL's 4 bpp coverage to opacity mapping (_lv_bpp4_opa_table)
+static const uint8_t bpp4_opa[16] = {0, 17, 34, 51, 68, 85, 102, 119, 136, 153, 170, 187, 204, 221, 238, 255};
+
+// Same decisions as the software blender: near-opaque copies, near-clear
+// keeps the background, everything else mixes
+static lv_color_t blend(lv_color_t fg, lv_color_t bg, lv_opa_t opa) {
+    if (opa >= LV_OPA_MAX)
+        return fg;
+    if (opa <= LV_OPA_MIN)
+        return bg;
+    return lv_color_mix(fg, bg, opa);
+}
+
+static void render_glyph(lv_color_t* cell, lv_coord_t w, lv_coord_t h, const lv_font_t* font, char c,
+                         lv_color_t fg, lv_color_t bg) {
+    for (int i = 0; i < w * h; ++i)
+        cell[i] = bg;
+    lv_font_glyph_dsc_t g;
+    if (!lv_font_get_glyph_dsc(font, &g, (uint32_t)c, 0) || !g.box_w || !g.box_h)
+        return;
+    const uint8_t* bitmap = lv_font_get_glyph_bitmap(font, (uint32_t)c);
+    if (!bitmap)
+        return;
+    // Placement as in lv_draw_letter(): boxes are stored bottom-up from
+    // the baseline, rows are packed without padding at 4 bpp
+    int x0 = g.ofs_x;
+    int y0 = (font->line_height - font->base_line) - g.box_h - g.ofs_y;
+    for (int y = 0; y < g.box_h; ++y) {
+        int py = y0 + y;
+        if (py < 0 || py >= h)
+            continue;
+        for (int x = 0; x < g.box_w; ++x) {
+            int px = x0 + x;
+            if (px < 0 || px >= w)
+                continue;
+            uint32_t bit = (uint32_t)(y * g.box_w + x) * 4;
+            uint8_t v = (bitmap[bit >> 3] >> (4 - (bit & 7))) & 0x0F;
+            cell[py * w + px] = blend(fg, bg, bpp4_opa[v]);
+        }
+    }
+}
+
+bool digit_atlas_build(DigitAtlas* a, const lv_font_t* font, lv_color_t fg, lv_color_t bg) {
+    memset(a, 0, sizeof(*a));
+    a->w = lv_font_get_glyph_width(font, '0', 0);
+    a->h = lv_font_get_line_height(font);
+    size_t cell_px = (size_t)a->w * a->h;
+    a->pixels = (lv_color_t*)malloc(cell_px * DIGIT_ATLAS_COUNT * sizeof(lv_color_t));
+    if (!a->pixels)
+        return false;
+    for (int i = 0; i < DIGIT_ATLAS_COUNT; ++i) {
+        lv_color_t* cell = a->pixels + i * cell_px;
+        render_glyph(cell, a->w, a->h, font, DIGIT_ATLAS_CHARS[i], fg, bg);
+        lv_img_dsc_t* d = &a->glyph[i];
+        d->header.cf = LV_IMG_CF_TRUE_COLOR;
+        d->header.always_zero = 0;
+        d->header.w = a->w;
+        d->header.h = a->h;
+        d->data_size = cell_px * sizeof(lv_color_t);
+        d->data = (const uint8_t*)cell;
+    }
+    return true;
+}
+
+void digit_atlas_free(DigitAtlas* a) {
+    free(a->pixels);
+    memset(a, 0, sizeof(*a));
+}
+
+const lv_img_dsc_t* digit_atlas_glyph(const DigitAtlas* a, char c) {
+    if (!a->pixels)
+        return nullptr;
+    const char* p = c ? strchr(DIGIT_ATLAS_CHARS, c) : nullptr;
+    return p ? &a->glyph[p - DIGIT_ATLAS_CHARS] : nullptr;
+}
+
+uint32_t digit_atlas_verify(const DigitAtlas* a, const lv_font_t* font, lv_color_t fg, lv_color_t bg,
+                            uint32_t* lvgl_us, uint32_t* atlas_us) {
+    size_t cell_px = (size_t)a->w * a->h;
+    lv_color_t* ref = (lv_color_t*)malloc(cell_px * sizeof(lv_color_t));
+    lv_color_t* dst = (lv_color_t*)malloc(cell_px * sizeof(lv_color_t));
+    uint32_t mismatches = 0;
+    int64_t lvgl_total = 0, atlas_total = 0;
+    if (!ref || !dst) {
+        free(ref);
+        free(dst);
+        return UINT32_MAX;
+    }
+    lv_obj_t* canvas = lv_canvas_create(lv_scr_act());
+    lv_obj_add_flag(canvas, LV_OBJ_FLAG_HIDDEN);
+    lv_canvas_set_buffer(canvas, ref, a->w, a->h, LV_IMG_CF_TRUE_COLOR);
+    lv_draw_label_dsc_t dsc;
+    lv_draw_label_dsc_init(&dsc);
+    dsc.font = font;
+    dsc.color = fg;
+    for (int i = 0; i < DIGIT_ATLAS_COUNT; ++i) {
+        char text[2] = {DIGIT_ATLAS_CHARS[i], '\0'};
+        int64_t t0 = esp_timer_get_time();
+        lv_canvas_fill_bg(canvas, bg, LV_OPA_COVER);
+        lv_canvas_draw_text(canvas, 0, 0, a->w, &dsc, text);
+        int64_t t1 = esp_timer_get_time();
+        // The atlas path: one cell copied row by row into a frame buffer
+        const lv_color_t* cell = (const lv_color_t*)a->glyph[i].data;
+        for (lv_coord_t y = 0; y < a->h; ++y)
+            memcpy(dst + y * a->w, cell + y * a->w, a->w * sizeof(lv_color_t));
+        int64_t t2 = esp_timer_get_time();
+        lvgl_total += t1 - t0;
+        atlas_total += t2 - t1;
+        for (size_t p = 0; p < cell_px; ++p) {
+            if (ref[p].full != dst[p].full)
+                ++mismatches;
+        }
+    }
+    lv_obj_del(canvas);
+    free(ref);
+    free(dst);
+    *lvgl_us = (uint32_t)(lvgl_total / DIGIT_ATLAS_COUNT);
+    *atlas_us = (uint32_t)(atlas_total / DIGIT_ATLAS_COUNT);
+    return mismatches;
+}
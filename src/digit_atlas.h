@@ -0,0 +1,33 @@
+// digit_atlas.h - clock glyphs blended once into RGB565 cells and drawn as images
+#pragma once
+
+#include <lvgl.h>
+
+// Every character ClockDigits text can hold
+#define DIGIT_ATLAS_CHARS "0123456789: "
+#define DIGIT_ATLAS_COUNT 12
+
+// One cell per character, pre-blended fg over bg in lv_color_t, which with
+// LV_COLOR_16_SWAP is already in panel byte order. Each glyph is an
+// LV_IMG_CF_TRUE_COLOR image, so LVGL draws a cell with a row copy instead
+// of rasterizing and blending the 4 bpp glyph again. An atlas holds one
+// fg/bg pair; each further colour pair is an atlas of its own.
+struct DigitAtlas {
+    lv_coord_t w;                   // advance of '0', the cell pitch
+    lv_coord_t h;                   // font line height
+    lv_color_t* pixels;             // DIGIT_ATLAS_COUNT cells of w * h
+    lv_img_dsc_t glyph[DIGIT_ATLAS_COUNT];
+};
+
+// Blends the glyphs exactly as LVGL's software renderer draws a label of
+// the same font and colour at the cell origin; false if out of memory
+bool digit_atlas_build(DigitAtlas* a, const lv_font_t* font, lv_color_t fg, lv_color_t bg);
+void digit_atlas_free(DigitAtlas* a);
+// Image source for c, or null if c is not in DIGIT_ATLAS_CHARS or the
+// atlas was not built
+const lv_img_dsc_t* digit_atlas_glyph(const DigitAtlas* a, char c);
+// Renders every glyph through LVGL on a canvas and compares it with its
+// cell; returns the number of differing pixels. The average time per glyph
+// of both paths goes to *lvgl_us and *atlas_us.
+uint32_t digit_atlas_verify(const DigitAtlas* a, const lv_font_t* font, lv_color_t fg, lv_color_t bg,
+                            uint32_t* lvgl_us, uint32_t* atlas_us);
@@ -0,0 +1,60 @@
+// frame_metrics.cpp - render and bus timing per flush, reported off-screen
+#include "frame_metrics.h"
+
+#include <stdio.h>
+#include <esp_attr.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+
+static const char* const metric_names[FRAME_METRIC_COUNT] = {
+    "flush_px", "render_us", "bus_us", "lv_timer_us",
+};
+
+static Histogram metrics[FRAME_METRIC_COUNT];
+static FrameBusTotals bus_base;     // bus counters at the last reset
+static int64_t interval_start_us = 0;
+// Flush completion is recorded from the SPI ISR
+static portMUX_TYPE metrics_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void IRAM_ATTR frame_metrics_add(FrameMetric m, uint32_t v) {
+    portENTER_CRITICAL_SAFE(&metrics_lock);
+    histogram_add(&metrics[m], v);
+    portEXIT_CRITICAL_SAFE(&metrics_lock);
+}
+
+void frame_metrics_take(FrameMetrics* out, const FrameBusTotals* bus_now, bool reset) {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&metrics_lock);
+    for (int i = 0; i < FRAME_METRIC_COUNT; ++i) {
+        out->hist[i] = metrics[i];
+        if (reset)
+            histogram_reset(&metrics[i]);
+    }
+    portEXIT_CRITICAL(&metrics_lock);
+    // Only the network loop takes, so the interval needs no lock
+    out->bus.transactions = bus_now->transactions - bus_base.transactions;
+    out->bus.bytes = bus_now->bytes - bus_base.bytes;
+    out->bus.busy_us = bus_now->busy_us - bus_base.busy_us;
+    out->interval_ms = (uint32_t)((now - interval_start_us) / 1000);
+    if (reset) {
+        bus_base = *bus_now;
+        interval_start_us = now;
+    }
+}
+
+int frame_metrics_format_json(const FrameMetrics* m, char* buf, size_t len) {
+    size_t pos = 0;
+    for (int i = 0; i < FRAME_METRIC_COUNT; ++i) {
+        char hist[128];
+        histogram_format_json(&m->hist[i], hist, sizeof(hist));
+        pos += snprintf(buf + (pos < len ? pos : len), pos < len ? len - pos : 0, "%s\"%s\":%s",
+                        i ? "," : "{", metric_names[i], hist);
+    }
+    uint32_t ms = m->interval_ms ? m->interval_ms : 1;
+    pos += snprintf(buf + (pos < len ? pos : len), pos < len ? len - pos : 0,
+                    ",\"bus\":{\"trans\":%u,\"bytes\":%u,\"busy_us\":%u,\"busy_pct\":%u,\"kbps\":%u},\"ms\":%u}",
+                    (unsigned)m->bus.transactions, (unsigned)m->bus.bytes, (unsigned)m->bus.busy_us,
+                    (unsigned)((uint64_t)m->bus.busy_us / 10 / ms),
+                    (unsigned)((uint64_t)m->bus.bytes * 8 / ms), (unsigned)m->interval_ms);
+    return (int)pos;
+}
@@ -0,0 +1,38 @@
+// frame_metrics.h - render and bus timing per flush, reported off-screen
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "histogram.h"
+
+enum FrameMetric {
+    FRAME_FLUSH_PX,                 // pixels per flushed area
+    FRAME_RENDER_US,                // LVGL drawing one area, without waiting for a free buffer
+    FRAME_BUS_US,                   // QSPI transfer of one area and its window, first byte to done
+    FRAME_TIMER_US,                 // one lv_timer_handler() call
+    FRAME_METRIC_COUNT
+};
+
+// Bus counters since boot, wrapping; only differences are reported
+struct FrameBusTotals {
+    uint32_t transactions;
+    uint32_t bytes;
+    uint32_t busy_us;
+};
+
+struct FrameMetrics {
+    Histogram hist[FRAME_METRIC_COUNT];
+    FrameBusTotals bus;             // over the interval
+    uint32_t interval_ms;
+};
+
+// From any task or ISR
+void frame_metrics_add(FrameMetric m, uint32_t v);
+// Copies what was recorded since the last reset, with the bus counters
+// taken against bus_now; reset starts a new interval
+void frame_metrics_take(FrameMetrics* out, const FrameBusTotals* bus_now, bool reset);
+// {"flush_px":{..},"render_us":{..},"bus_us":{..},"lv_timer_us":{..},
+//  "bus":{"trans":..,"bytes":..,"busy_us":..,"busy_pct":..,"kbps":..},"ms":..}
+// Returns the length, or the length needed when it did not fit
+int frame_metrics_format_json(const FrameMetrics* m, char* buf, size_t len);
@@ -0,0 +1,104 @@
+// heap_monitor.cpp - counts every heap call, to prove the tick path allocation-free
+#include "heap_monitor.h"
+
+#include <stdlib.h>
+
+#if defined(ESP_PLATFORM)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+static void* current_task() { return xTaskGetCurrentTaskHandle(); }
+#else
+static __thread char task_marker;
+static void* current_task() { return &task_marker; }
+#endif
+
+static HeapCounts all = {0, 0, 0};
+static HeapCounts watched = {0, 0, 0};
+static void* volatile watched_task = nullptr;
+
+static inline void count(uint32_t HeapCounts::*field) {
+    __atomic_fetch_add(&(all.*field), 1, __ATOMIC_RELAXED);
+    if (watched_task && current_task() == watched_task)
+        ++(watched.*field); // only that task writes it
+}
+
+static void count_realloc(void* p, size_t size) {
+    if (!p)
+        count(&HeapCounts::allocs);
+    else if (!size)
+        count(&HeapCounts::frees);
+    else
+        count(&HeapCounts::reallocs);
+}
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* p, size_t size);
+void __real_free(void* p);
+
+void* __wrap_malloc(size_t size) {
+    count(&HeapCounts::allocs);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    count(&HeapCounts::allocs);
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* p, size_t size) {
+    count_realloc(p, size);
+    return __real_realloc(p, size);
+}
+
+void __wrap_free(void* p) {
+    if (p)
+        count(&HeapCounts::frees);
+    __real_free(p);
+}
+
+#if defined(ESP_PLATFORM)
+void* __real_heap_caps_malloc(size_t size, uint32_t caps);
+void* __real_heap_caps_calloc(size_t n, size_t size, uint32_t caps);
+void* __real_heap_caps_realloc(void* p, size_t size, uint32_t caps);
+
+void* __wrap_heap_caps_malloc(size_t size, uint32_t caps) {
+    count(&HeapCounts::allocs);
+    return __real_heap_caps_malloc(size, caps);
+}
+
+void* __wrap_heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+    count(&HeapCounts::allocs);
+    return __real_heap_caps_calloc(n, size, caps);
+}
+
+void* __wrap_heap_caps_realloc(void* p, size_t size, uint32_t caps) {
+    count_realloc(p, size);
+    return __real_heap_caps_realloc(p, size, caps);
+}
+#endif
+}
+
+static void read_counts(const HeapCounts* c, HeapCounts* out) {
+    out->allocs = __atomic_load_n(&c->allocs, __ATOMIC_RELAXED);
+    out->frees = __atomic_load_n(&c->frees, __ATOMIC_RELAXED);
+    out->reallocs = __atomic_load_n(&c->reallocs, __ATOMIC_RELAXED);
+}
+
+void heap_monitor_read(HeapCounts* out) {
+    read_counts(&all, out);
+}
+
+void heap_monitor_watch_current_task() {
+    watched_task = current_task();
+}
+
+void heap_monitor_read_watched(HeapCounts* out) {
+    read_counts(&watched, out);
+}
+
+uint32_t heap_monitor_ops(const HeapCounts* before, const HeapCounts* after) {
+    return (after->allocs - before->allocs) + (after->frees - before->frees) +
+           (after->reallocs - before->reallocs);
+}
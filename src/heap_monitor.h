@@ -0,0 +1,28 @@
+// heap_monitor.h - counts every heap call, to prove the tick path allocation-free
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The counting happens in __wrap_malloc/calloc/realloc/free, linked in with
+// -Wl,--wrap (src/CMakeLists.txt, platformio.ini [env:native]), so LVGL,
+// Arduino String, PubSubClient, lwIP and C++ new are all seen. On ESP-IDF
+// heap_caps_malloc/calloc/realloc are wrapped as well, for FreeRTOS and
+// drivers that call them directly. heap_caps_free is not: free() itself
+// goes through it, so those frees would count twice.
+
+// Calls since boot; the difference across a piece of code is its churn
+struct HeapCounts {
+    uint32_t allocs;                // malloc, calloc, and realloc of null
+    uint32_t frees;                 // free of a block, and realloc to size 0
+    uint32_t reallocs;              // realloc of a live block
+};
+
+// Every task
+void heap_monitor_read(HeapCounts* out);
+// From now on calls made by the calling task are also counted apart, so
+// other tasks allocating meanwhile do not show up in its readings
+void heap_monitor_watch_current_task();
+void heap_monitor_read_watched(HeapCounts* out);
+// allocs + frees + reallocs between two readings
+uint32_t heap_monitor_ops(const HeapCounts* before, const HeapCounts* after);
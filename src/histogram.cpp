@@ -0,0 +1,34 @@
+// histogram.cpp - fixed power-of-two bucket histogram, no allocation
+#include "histogram.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void histogram_reset(Histogram* h) {
+    memset(h, 0, sizeof(*h));
+}
+
+uint32_t histogram_quantile(const Histogram* h, float q) {
+    if (!h->count)
+        return 0;
+    uint32_t rank = (uint32_t)(q * (h->count - 1)) + 1;
+    uint32_t seen = 0;
+    for (int k = 0; k < HISTOGRAM_BUCKETS; ++k) {
+        seen += h->bucket[k];
+        if (seen >= rank) {
+            if (k == 0)
+                return 0;
+            uint32_t upper = (k == HISTOGRAM_BUCKETS - 1) ? h->max : (1u << k) - 1;
+            return upper < h->max ? upper : h->max;
+        }
+    }
+    return h->max;
+}
+
+int histogram_format_json(const Histogram* h, char* buf, size_t len) {
+    return snprintf(buf, len, "{\"n\":%u,\"min\":%u,\"avg\":%u,\"p50\":%u,\"p99\":%u,\"max\":%u}",
+                    (unsigned)h->count, (unsigned)h->min,
+                    (unsigned)(h->count ? h->sum / h->count : 0),
+                    (unsigned)histogram_quantile(h, 0.5f), (unsigned)histogram_quantile(h, 0.99f),
+                    (unsigned)h->max);
+}
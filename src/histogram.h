@@ -0,0 +1,37 @@
+// histogram.h - fixed power-of-two bucket histogram, no allocation
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bucket 0 holds 0, bucket k holds [2^(k-1), 2^k); the last one also takes
+// everything larger. With microseconds, 21 buckets reach ~0.5 s.
+#define HISTOGRAM_BUCKETS 21
+
+struct Histogram {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t bucket[HISTOGRAM_BUCKETS];
+};
+
+void histogram_reset(Histogram* h);
+
+inline void histogram_add(Histogram* h, uint32_t v) {
+    int k = v ? 32 - __builtin_clz(v) : 0;
+    if (k >= HISTOGRAM_BUCKETS)
+        k = HISTOGRAM_BUCKETS - 1;
+    ++h->bucket[k];
+    if (!h->count || v < h->min)
+        h->min = v;
+    if (v > h->max)
+        h->max = v;
+    h->sum += v;
+    ++h->count;
+}
+
+// Upper bound of the bucket holding the given quantile (0-1), 0 when empty
+uint32_t histogram_quantile(const Histogram* h, float q);
+// {"n":..,"min":..,"avg":..,"p50":..,"p99":..,"max":..}; returns the length
+int histogram_format_json(const Histogram* h, char* buf, size_t len);
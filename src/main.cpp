@@ -10,9 +10,25 @@ extern "C" {
 #include <TouchLib.h>
 #include <WiFi.h>
 #include <PubSubClient.h>
+#include <esp_timer.h>
 #include <time.h>
 #include <string.h>
 #include <stdio.h>
+#include <assert.h>
+#include <sys/select.h>
+#include "zone_offset.h"
+#include "clock_format.h"
+#include "tick_scheduler.h"
+#include "time_sync.h"
+#include "histogram.h"
+#include "boot_trace.h"
+#include "boot_graph.h"
+#include "spsc_queue.h"
+#include "task_stats.h"
+#include "digit_atlas.h"
+#include "heap_monitor.h"
+#include "frame_metrics.h"
+#include "bus_bench.h"
 
 #define SCREEN_WIDTH 480
 #define SCREEN_HEIGHT 272
@@ -22,15 +38,40 @@ extern "C" {
 #define LEDC_BASE_FREQ 5000
 
 // QSPI pins for JC4827W543_4.3inch_ESP32S3_board
-Arduino_DataBus *bus = new Arduino_ESP32QSPI(
+Arduino_ESP32QSPI *bus = new Arduino_ESP32QSPI(
     45 /* cs */, 47 /* sck */, 21 /* d0 */, 48 /* d1 */, 40 /* d2 */, 39 /* d3 */);
 Arduino_NV3041A *panel = new Arduino_NV3041A(bus, GFX_NOT_DEFINED /* RST */, 0 /* rotation */, true /* IPS */);
-Arduino_GFX *gfx = new Arduino_Canvas(SCREEN_WIDTH, SCREEN_HEIGHT, panel);
 
+// Render architecture, only the selected one allocates memory:
+//   RENDER_LVGL_DIRECT        - LVGL bands go straight to the panel (two DMA bands)
+//   RENDER_CANVAS_FLUSH       - LVGL draws into an Arduino_Canvas, flushed after each frame
+//   RENDER_CANVAS_DIRECT_MODE - the canvas framebuffer is LVGL's direct_mode buffer
+#define RENDER_LVGL_DIRECT 0
+#define RENDER_CANVAS_FLUSH 1
+#define RENDER_CANVAS_DIRECT_MODE 2
+#ifndef RENDER_MODE
+#define RENDER_MODE RENDER_LVGL_DIRECT
+#endif
+
+#if RENDER_MODE == RENDER_LVGL_DIRECT
+Arduino_GFX *gfx = panel;
+#define SCR_BUF_LEN 68 // SCREEN_HEIGHT / 4, affordable without the canvas framebuffer
+// my_disp_flush() queues a whole band without blocking; LVGL does not flush
+// the next one before lv_disp_flush_ready(), so one band is all that is queued
+#define FLUSH_TRANSACTIONS (NV3041A_WINDOW_COMMANDS + \
+    (SCREEN_WIDTH * SCR_BUF_LEN + ESP32QSPI_ASYNC_PIXELS_AT_ONCE - 1) / ESP32QSPI_ASYNC_PIXELS_AT_ONCE)
+static_assert(ESP32QSPI_QUEUE_SIZE >= FLUSH_TRANSACTIONS, "raise ESP32QSPI_QUEUE_SIZE");
+#else
+Arduino_Canvas *canvas = new Arduino_Canvas(SCREEN_WIDTH, SCREEN_HEIGHT, panel);
+Arduino_GFX *gfx = canvas;
 #define SCR_BUF_LEN 32
+#endif
+
 static lv_disp_draw_buf_t draw_buf;
 static lv_disp_drv_t disp_drv;
-static lv_color_t disp_draw_buf[SCREEN_WIDTH * SCR_BUF_LEN];
+// Direct mode: two DMA-capable bands, LVGL renders into one while the other is on the bus
+static lv_color_t *disp_draw_buf1 = nullptr;
+static lv_color_t *disp_draw_buf2 = nullptr;
 
 // Touch GT911 I2C pins for JC4827W543_4.3inch_ESP32S3_board
 #define TOUCH_SCL 4
@@ -45,7 +86,37 @@ TouchLib touch(Wire, TOUCH_SDA, TOUCH_SCL, GT911_SLAVE_ADDRESS1, TOUCH_RST);
 #define WIFI_PASS "13157005"
 #define MQTT_BROKER "192.168.100.232"
 #define MQTT_TOPIC "esp32s3-1/tele"
-#define NTP_SERVER "pool.ntp.org"
+#define MQTT_BUFFER_SIZE 1024 // telemetry JSON exceeds the 256-byte default
+// Queried together; the clock follows the servers that agree
+static const char* const ntp_servers[] = {
+    "0.pool.ntp.org", "1.pool.ntp.org", "2.pool.ntp.org", "3.pool.ntp.org"};
+
+// Cities in display order, each with an IANA zone looked up in the tzdb
+// partition and a POSIX TZ rule used when the partition is not flashed.
+// The first city also shows seconds and drives the date line.
+struct City {
+    const char* name;
+    const char* zone;
+    const char* tz;
+};
+static const City cities[] = {
+    {"London",    "Europe/London",       "GMT0BST,M3.5.0/1,M10.5.0"},
+    {"New York",  "America/New_York",    "EST5EDT,M3.2.0,M11.1.0"},
+    {"Bangalore", "Asia/Kolkata",        "IST-5:30"},
+    {"Phoenix",   "America/Phoenix",     "MST7"},
+    {"Palo Alto", "America/Los_Angeles", "PST8PDT,M3.2.0,M11.1.0"},
+    {"Chicago",   "America/Chicago",     "CST6CDT,M3.2.0,M11.1.0"},
+};
+#define CITY_COUNT ((int)(sizeof(cities) / sizeof(cities[0])))
+static_assert(CITY_COUNT <= ZONE_TABLE_MAX, "raise ZONE_TABLE_MAX");
+#define CITY_ROW_SPACING 40
+#define CITY_ROWS ((SCREEN_HEIGHT - 32) / CITY_ROW_SPACING) // leave room for the date line
+#define CITY_COLUMN_WIDTH 400
+
+static Tzdb tzdb;
+static ZoneTable city_zones;
+static ZoneTime city_times[ZONE_TABLE_MAX];
+static ClockDigits city_clocks[ZONE_TABLE_MAX];
 
 // MQTT setup
 WiFiClient espClient;
@@ -60,11 +131,41 @@ lv_obj_t *time_label_blr = nullptr;
 static lv_obj_t *date_label = nullptr;
 
 void mqttCallback(char* topic, byte* payload, unsigned int length) {
-    // Handle incoming MQTT messages if needed
+    // Handle incoming MQTT messages if needed; anything for the display
+    // goes through ui_post(), which also wakes ui_task
+}
+
+// Set by report_boot_trace(); later reconnects are not part of the boot and
+// would only fill the trace with spans nobody reads
+static volatile bool boot_trace_reported = false;
+
+// Association and DHCP end in the WiFi event task; boot_trace is safe there
+// Station address from the IP events, 0 while there is none; the network
+// loop forwards changes to the UI
+static volatile uint32_t net_ip = 0;
+
+static void on_wifi_event(arduino_event_id_t event, arduino_event_info_t info) {
+    if (event == ARDUINO_EVENT_WIFI_STA_CONNECTED) {
+        if (!boot_trace_reported) {
+            boot_trace_end("wifi_assoc");
+            boot_trace_begin("dhcp");
+        }
+    } else if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+        net_ip = info.got_ip.ip_info.ip.addr;
+        if (!boot_trace_reported)
+            boot_trace_end("dhcp");
+    } else {
+        net_ip = 0;
+    }
 }
 
 void connectToWiFi() {
+    WiFi.onEvent(on_wifi_event, ARDUINO_EVENT_WIFI_STA_CONNECTED);
+    WiFi.onEvent(on_wifi_event, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    WiFi.onEvent(on_wifi_event, ARDUINO_EVENT_WIFI_STA_LOST_IP);
+    WiFi.onEvent(on_wifi_event, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
     WiFi.mode(WIFI_STA);
+    boot_trace_begin("wifi_assoc");
     WiFi.begin(WIFI_SSID, WIFI_PASS);
     while (WiFi.status() != WL_CONNECTED) {
         delay(500);
@@ -76,6 +177,8 @@ void connectToWiFi() {
 void connectToMQTT() {
     mqttClient.setServer(MQTT_BROKER, 1883);
     mqttClient.setCallback(mqttCallback);
+    mqttClient.setBufferSize(MQTT_BUFFER_SIZE);
+    boot_trace_begin("mqtt_connect");
     while (!mqttClient.connected()) {
         Serial.print("Connecting to MQTT...");
         if (mqttClient.connect("esp32s3-1")) {
@@ -88,15 +191,23 @@ void connectToMQTT() {
             delay(2000);
         }
     }
+    boot_trace_end("mqtt_connect");
 }
 
+// Starts background NTP; the loop picks up the solutions through time_sync_poll()
 void syncTime() {
-    configTime(0, 0, NTP_SERVER);
-    while (time(nullptr) < 100000) {
-        delay(500);
-        Serial.print("*");
-    }
-    Serial.println("\nTime synced");
+    boot_trace_begin("ntp_sync"); // ends at the first synced solution
+    int servers = time_sync_start(ntp_servers, sizeof(ntp_servers) / sizeof(ntp_servers[0]));
+    Serial.printf("NTP: %d servers, looked up in the background\n", servers);
+}
+
+// Set once connectToMQTT() has returned; PubSubClient is not thread-safe, so
+// the loop leaves it alone until then
+static volatile bool mqtt_ready = false;
+
+void mqtt_init() {
+    connectToMQTT();
+    mqtt_ready = true;
 }
 
 void lvgl_show_time(const char* timestr) {
@@ -109,88 +220,291 @@ void lvgl_show_time(const char* timestr) {
     lv_label_set_text(time_label, timestr);
 }
 
-// In lvgl_show_times, use a fixed-width font for all time labels
-void lvgl_show_times(const char* london, const char* ny, const char* blr, const char* phx, const char* palo, const char* chi, const char* date_str) {
-    int y = 10;
-    int spacing = 40;
-    // Use LVGL's Montserrat 32 font for city labels, and custom 32px monospace font for time strings
-    const lv_font_t* city_font = &lv_font_montserrat_32;
+// The time text is one image per character cell, drawn from the digit
+// atlas, so a tick only copies the cells that changed. The first city keeps
+// seconds, the others show HH:MM.
+#define CITY_TIME_LEN(i) ((i) == 0 ? CLOCK_TEXT_LEN : 5)
+
+#ifndef DIGIT_ATLAS_VERIFY
+#define DIGIT_ATLAS_VERIFY 0        // 1: compare the atlas with LVGL's rendering at boot
+#endif
+
+// Retained clock view: objects and shared styles are created once by
+// lvgl_create_clock_view(), ticks only set the text of changed cells
+static lv_style_t city_style;
+static lv_style_t date_style;
+static DigitAtlas time_atlas;
+// Text of date_label, set with lv_label_set_text_static so updates never
+// touch the heap
+static char date_text[96];
+static lv_obj_t *city_labels[ZONE_TABLE_MAX] = {nullptr};
+static lv_obj_t *time_cells[ZONE_TABLE_MAX][CLOCK_TEXT_LEN] = {{nullptr}};
+
+void lvgl_create_clock_view(int count) {
+    // Montserrat 32 for city names, the custom 32px monospace font for times
+    lv_style_init(&city_style);
+    lv_style_set_text_font(&city_style, &lv_font_montserrat_32);
+    lv_style_set_text_color(&city_style, lv_palette_main(LV_PALETTE_BLUE));
+    lv_style_init(&date_style);
+    lv_style_set_text_font(&date_style, &lv_font_montserrat_20);
+    lv_style_set_text_color(&date_style, lv_palette_main(LV_PALETTE_CYAN));
+
+    // Time glyphs are blended onto the black background once; every cell
+    // has the same size, so a new glyph invalidates just its cell
     const lv_font_t* time_font = &lv_font_mono_32;
-    lv_color_t city_color = lv_palette_main(LV_PALETTE_BLUE);
-    lv_color_t time_color = lv_palette_main(LV_PALETTE_YELLOW);
-    static lv_obj_t *city_labels[6] = {nullptr};
-    static lv_obj_t *time_labels[6] = {nullptr};
-    const char* city_names[] = {"London", "New York", "Bangalore", "Phoenix", "Palo Alto", "Chicago"};
-    const char* time_strs[] = {london, ny, blr, phx, palo, chi};
-    for (int i = 0; i < 6; ++i) {
-        if (!city_labels[i]) {
-            city_labels[i] = lv_label_create(lv_scr_act());
-            lv_obj_set_style_text_font(city_labels[i], city_font, 0);
-            lv_obj_set_style_text_color(city_labels[i], city_color, 0);
-            lv_obj_align(city_labels[i], LV_ALIGN_TOP_LEFT, 10, y);
-        } else {
-            lv_obj_set_style_text_font(city_labels[i], city_font, 0);
-            lv_obj_set_style_text_color(city_labels[i], city_color, 0);
-            lv_obj_align(city_labels[i], LV_ALIGN_TOP_LEFT, 10, y);
+    lv_color_t time_fg = lv_palette_main(LV_PALETTE_YELLOW);
+    if (!digit_atlas_build(&time_atlas, time_font, time_fg, lv_color_black()))
+        Serial.println("Digit atlas allocation failed!");
+#if DIGIT_ATLAS_VERIFY
+    uint32_t lvgl_us = 0, atlas_us = 0;
+    uint32_t diff = digit_atlas_verify(&time_atlas, time_font, time_fg, lv_color_black(), &lvgl_us, &atlas_us);
+    Serial.printf("Digit atlas: %u px differ from LVGL; per glyph %u us rendered, %u us copied\n",
+                  (unsigned)diff, (unsigned)lvgl_us, (unsigned)atlas_us);
+#endif
+    const lv_img_dsc_t* blank = digit_atlas_glyph(&time_atlas, ' ');
+    lv_coord_t cell_w = time_atlas.w;
+    for (int i = 0; i < count; ++i) {
+        int x = 10 + (i / CITY_ROWS) * CITY_COLUMN_WIDTH;
+        int y = 10 + (i % CITY_ROWS) * CITY_ROW_SPACING;
+        city_labels[i] = lv_label_create(lv_scr_act());
+        lv_obj_add_style(city_labels[i], &city_style, 0);
+        lv_obj_align(city_labels[i], LV_ALIGN_TOP_LEFT, x, y);
+        lv_label_set_text_static(city_labels[i], cities[i].name);
+        for (int k = 0; k < CITY_TIME_LEN(i); ++k) {
+            lv_obj_t* cell = lv_img_create(lv_scr_act());
+            if (blank)
+                lv_img_set_src(cell, blank);
+            lv_obj_set_pos(cell, x + 190 + k * cell_w, y);
+            time_cells[i][k] = cell;
         }
-        lv_label_set_text(city_labels[i], city_names[i]);
-        if (!time_labels[i]) {
-            time_labels[i] = lv_label_create(lv_scr_act());
-            lv_obj_set_style_text_font(time_labels[i], time_font, 0);
-            lv_obj_set_style_text_color(time_labels[i], time_color, 0);
-            lv_obj_align(time_labels[i], LV_ALIGN_TOP_LEFT, 200, y);
-        } else {
-            lv_obj_set_style_text_font(time_labels[i], time_font, 0);
-            lv_obj_set_style_text_color(time_labels[i], time_color, 0);
-            lv_obj_align(time_labels[i], LV_ALIGN_TOP_LEFT, 200, y);
-        }
-        // Extract only the time part (HH:MM:SS) from the formatted string
-        const char* time_part = time_strs[i];
-        size_t city_len = strlen(city_names[i]);
-        if (strncmp(time_part, city_names[i], city_len) == 0) {
-            time_part += city_len;
-            while (*time_part == ' ') time_part++;
-        }
-        char time_buf[16];
-        if (i == 0) {
-            // London: keep seconds
-            strncpy(time_buf, time_part, sizeof(time_buf) - 1);
-            time_buf[sizeof(time_buf) - 1] = '\0';
-        } else {
-            // Others: remove seconds (show HH:MM only)
-            strncpy(time_buf, time_part, 5); // HH:MM
-            time_buf[5] = '\0';
+    }
+    date_label = lv_label_create(lv_scr_act());
+    lv_obj_add_style(date_label, &date_style, 0);
+    lv_obj_align(date_label, LV_ALIGN_BOTTOM_LEFT, 10, 0); // Align to bottom left with 10px padding
+    lv_label_set_text_static(date_label, date_text);
+}
+
+void lvgl_show_times(const ClockDigits* clocks, const uint16_t* changed, int count) {
+    for (int i = 0; i < count; ++i) {
+        for (int k = 0; k < CITY_TIME_LEN(i); ++k) {
+            if (!(changed[i] & (1 << k)))
+                continue;
+            const lv_img_dsc_t* glyph = digit_atlas_glyph(&time_atlas, clocks[i].text[k]);
+            if (glyph)
+                lv_img_set_src(time_cells[i][k], glyph);
         }
-        lv_label_set_text(time_labels[i], time_buf);
-        y += spacing;
     }
-    // Date label at the bottom left, with IP address appended
-    char date_ip_str[80];
-    // Get local IP address as string
-    String ipStr = WiFi.localIP().toString();
-    snprintf(date_ip_str, sizeof(date_ip_str), "%s     %s", date_str, ipStr.c_str());
-    if (!date_label) {
-        date_label = lv_label_create(lv_scr_act());
-        lv_obj_set_style_text_font(date_label, &lv_font_montserrat_20, 0);
-        lv_obj_set_style_text_color(date_label, lv_palette_main(LV_PALETTE_CYAN), 0);
-        lv_obj_align(date_label, LV_ALIGN_BOTTOM_LEFT, 10, 0); // Align to bottom left with 10px padding
-    } else {
-        lv_obj_set_style_text_font(date_label, &lv_font_montserrat_20, 0);
-        lv_obj_set_style_text_color(date_label, lv_palette_main(LV_PALETTE_CYAN), 0);
-        lv_obj_align(date_label, LV_ALIGN_BOTTOM_LEFT, 10, 0);
+}
+
+// Date label at the bottom left, with IP address and an optional note
+// appended. Only called when one of them changes.
+void lvgl_show_date(const char* date_str, const char* ip_str, const char* note) {
+    snprintf(date_text, sizeof(date_text), "%s     %s%s%s", date_str, ip_str,
+             note ? "     " : "", note ? note : "");
+    lv_label_set_text_static(date_label, date_text); // same buffer, refreshes the label
+}
+
+// Boot milestones on esp_timer_get_time(), 0 until reached
+static volatile int64_t boot_first_pixel_us = 0;
+static int64_t boot_synced_us = 0;
+
+static inline void IRAM_ATTR mark_first_pixel() {
+    if (!boot_first_pixel_us)
+        boot_first_pixel_us = esp_timer_get_time();
+}
+
+// Second-flip tracking: set by commit_tick() around lv_refr_now(), so the
+// last band flushed while it is set ends the committed frame
+static bool flip_pending = false;
+// Bands complete in queue order, so counting them identifies the flip band
+static volatile uint32_t bands_queued = 0;
+static volatile uint32_t bands_done = 0;
+static volatile uint32_t flip_band = 0;
+
+// An area renders from the previous flush, or the start of the refresh,
+// until LVGL hands it over; time spent waiting in wait_cb for the other
+// band to leave the bus is not rendering
+static int64_t render_from_us = 0;
+static int64_t render_wait_us = 0;  // first wait_cb of this area, 0 if none
+
+void my_render_start(lv_disp_drv_t *disp) {
+    render_from_us = esp_timer_get_time();
+    render_wait_us = 0;
+}
+
+void my_disp_wait(lv_disp_drv_t *disp) {
+    if (!render_wait_us)
+        render_wait_us = esp_timer_get_time();
+}
+
+// Called on entry to every flush_cb; returns the time to pass to flush_end()
+static int64_t flush_begin(const lv_area_t *area) {
+    int64_t now = esp_timer_get_time();
+    frame_metrics_add(FRAME_RENDER_US, (uint32_t)((render_wait_us ? render_wait_us : now) - render_from_us));
+    frame_metrics_add(FRAME_FLUSH_PX, lv_area_get_size(area));
+    render_wait_us = 0;
+    return now;
+}
+
+// For flushes that finish on the bus before returning; the next area
+// renders from here
+static void flush_end(int64_t start_us) {
+    render_from_us = esp_timer_get_time();
+    frame_metrics_add(FRAME_BUS_US, (uint32_t)(render_from_us - start_us));
+}
+
+#ifndef BUS_BENCH
+#define BUS_BENCH 0                 // 1: measure each QSPI pixel writer at boot
+#endif
+
+#if BUS_BENCH
+static void print_bus_bench(const char *source, const BusBenchResult *results, int n) {
+    for (int i = 0; i < n; ++i) {
+        uint32_t rate = bus_bench_bytes_per_ms(&results[i]);
+        Serial.printf("[bus_bench] %s %s: %u.%02u MB/s\n", source, results[i].name,
+                      (unsigned)(rate / 1000), (unsigned)(rate % 1000 / 10));
     }
-    lv_label_set_text(date_label, date_ip_str);
 }
 
+// Before LVGL sets the flush-done callback, which the async pass would fire
+static void run_bus_bench() {
+    BusBenchResult results[BUS_BENCH_METHODS];
+    int n = bus_bench_run(bus, panel, SCREEN_WIDTH, SCREEN_HEIGHT, results);
+    if (!n)
+        Serial.println("Bus bench allocation failed!");
+    print_bus_bench("synthetic", results, n);
+}
+
+// writePixels() against writePixelsPreswapped() on the bands of the first
+// frame LVGL renders, reported once the frame is complete
+static BusBenchResult frame_bench[BUS_BENCH_BAND_RESULTS];
+static bool frame_bench_done = false;
+
+static void bench_frame_band(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t *color_p) {
+    if (frame_bench_done)
+        return;
+    bus_bench_band(bus, panel, (uint16_t *)&color_p->full, area->x1, area->y1,
+                   area->x2 - area->x1 + 1, area->y2 - area->y1 + 1, LV_COLOR_16_SWAP, frame_bench);
+    if (lv_disp_flush_is_last(disp)) {
+        frame_bench_done = true;
+        print_bus_bench("lvgl frame", frame_bench, BUS_BENCH_BAND_RESULTS);
+    }
+}
+#endif
+
+// Queues the band for DMA and returns; my_disp_flush_done() releases it.
+// With LV_COLOR_16_SWAP the band is already big-endian and goes out as-is.
 void IRAM_ATTR my_disp_flush(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t *color_p) {
     uint32_t w = (area->x2 - area->x1 + 1);
     uint32_t h = (area->y2 - area->y1 + 1);
+    uint32_t band = ++bands_queued;
+    if (flip_pending && lv_disp_flush_is_last(disp))
+        flip_band = band;
+#if BUS_BENCH
+    bench_frame_band(disp, area, color_p); // polled, before the band is timed
+#endif
+    flush_begin(area);
+    // Window and pixels queue as one chain behind the band still on the
+    // bus, instead of polling the window commands once it has finished
+    panel_command_t window[NV3041A_WINDOW_COMMANDS];
+    uint8_t n = panel->encodeAddrWindow(area->x1, area->y1, w, h, window);
+    panel->startWrite();
+    bus->writeCommandsAsync(window, n);
+    bus->writePixelsAsync((uint16_t *)&color_p->full, w * h, LV_COLOR_16_SWAP);
+    panel->endWrite();
+    render_from_us = esp_timer_get_time(); // the bus time is taken in the ISR
+}
+
+// Called from the SPI ISR once the last chunk of a band has been sent
+void IRAM_ATTR my_disp_flush_done(void *user_ctx) {
+    mark_first_pixel();
+    frame_metrics_add(FRAME_BUS_US, bus->lastAsyncUs());
+    if (++bands_done == flip_band)
+        tick_scheduler_flip_done();
+    lv_disp_flush_ready((lv_disp_drv_t *)user_ctx);
+}
+
+#if RENDER_MODE == RENDER_CANVAS_FLUSH
+// Copies the band into the canvas and pushes the whole canvas after the last band
+void my_canvas_flush(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t *color_p) {
+    int16_t w = (area->x2 - area->x1 + 1);
+    int16_t h = (area->y2 - area->y1 + 1);
+    int64_t start = flush_begin(area);
+#if LV_COLOR_16_SWAP
+    canvas->draw16bitBeRGBBitmap(area->x1, area->y1, (uint16_t *)&color_p->full, w, h);
+#else
+    canvas->draw16bitRGBBitmap(area->x1, area->y1, (uint16_t *)&color_p->full, w, h);
+#endif
+    if (lv_disp_flush_is_last(disp)) {
+        canvas->flush();
+        mark_first_pixel();
+        if (flip_pending)
+            tick_scheduler_flip_done();
+    }
+    flush_end(start); // includes the copy into the canvas
+    lv_disp_flush_ready(disp);
+}
+#endif
+
+#if RENDER_MODE == RENDER_CANVAS_DIRECT_MODE
+// LVGL renders in place into the full-screen framebuffer; push only the dirty area
+void my_direct_flush(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t *color_p) {
+    uint32_t w = (area->x2 - area->x1 + 1);
+    uint32_t h = (area->y2 - area->y1 + 1);
+    uint16_t *fb = canvas->getFramebuffer() + area->y1 * SCREEN_WIDTH + area->x1;
+    int64_t start = flush_begin(area);
     panel->startWrite();
     panel->setAddrWindow(area->x1, area->y1, w, h);
-    panel->writePixels((uint16_t *)&color_p->full, w * h);
+    if (w == SCREEN_WIDTH) {
+        h = 1;
+        w *= (area->y2 - area->y1 + 1);
+    }
+    for (uint32_t row = 0; row < h; ++row) {
+#if LV_COLOR_16_SWAP
+        bus->writePixelsPreswapped(fb, w);
+#else
+        bus->writePixels(fb, w);
+#endif
+        fb += SCREEN_WIDTH;
+    }
     panel->endWrite();
+    flush_end(start);
+    mark_first_pixel();
+    if (flip_pending && lv_disp_flush_is_last(disp))
+        tick_scheduler_flip_done();
     lv_disp_flush_ready(disp);
 }
+#endif
+
+#ifndef QSPI_CHUNK_BUDGET
+#define QSPI_CHUNK_BUDGET 0         // internal RAM for the QSPI bounce buffers, 0: keep the default chunk
+#endif
+
+#if QSPI_CHUNK_BUDGET
+// Picks the packed-transaction size on a full-screen fill, which blanks the panel
+static void tune_qspi_chunk() {
+    boot_trace_begin("qspi_tune");
+    esp32qspi_tune_t tune;
+    panel->startWrite();
+    panel->writeAddrWindow(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+    bool ok = bus->autoTuneChunkPixels(QSPI_CHUNK_BUDGET, SCREEN_WIDTH * SCREEN_HEIGHT, &tune);
+    panel->endWrite();
+    boot_trace_end("qspi_tune");
+    if (ok)
+        Serial.printf("QSPI chunk: %u px, %u ns per transaction, %u kB/s\n",
+                      (unsigned)tune.chunk_px, (unsigned)tune.overhead_ns, (unsigned)tune.bytes_per_ms);
+    else
+        Serial.println("QSPI chunk budget too small, keeping the default");
+}
+#endif
+
+// Internal RAM is what the canvas framebuffer and DMA bands compete for
+void report_heap(const char* stage) {
+    Serial.printf("[heap] %s: internal free %u, largest %u, dma free %u\n", stage,
+                  heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+                  heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL),
+                  heap_caps_get_free_size(MALLOC_CAP_DMA));
+}
 
 void setBrightness(uint8_t value) {
     uint32_t duty = 4095 * value / 255;
@@ -199,6 +513,9 @@ void setBrightness(uint8_t value) {
 
 // Global LVGL label for touch coordinates
 static lv_obj_t *touch_label = nullptr;
+// LVGL's touch polling timer; paused while nothing touches the panel and
+// resumed from the touch interrupt
+static lv_timer_t *touch_read_timer = nullptr;
 
 // LVGL touchpad read callback
 void my_touchpad_read(lv_indev_drv_t *indev_driver, lv_indev_data_t *data) {
@@ -218,6 +535,8 @@ void my_touchpad_read(lv_indev_drv_t *indev_driver, lv_indev_data_t *data) {
     } else {
         Serial.println("No touch detected");
         data->state = LV_INDEV_STATE_REL;
+        // Released: stop polling until the controller raises TOUCH_INT again
+        lv_timer_pause(indev_driver->read_timer);
         // Optionally clear the label when not touching
         if (touch_label) {
             // lv_label_set_text(touch_label, "Touch: -,-");
@@ -225,23 +544,65 @@ void my_touchpad_read(lv_indev_drv_t *indev_driver, lv_indev_data_t *data) {
     }
 }
 
+// Pixels LVGL redrew, summed over the refreshes of one tick
+static uint32_t tick_px = 0;
+
+// Called by LVGL after each refresh that had invalidated areas
+void my_disp_monitor(lv_disp_drv_t *disp, uint32_t time_ms, uint32_t px) {
+    tick_px += px;
+}
+
 void lvgl_init() {
     ledcSetup(LEDC_CHANNEL_0, LEDC_BASE_FREQ, LEDC_TIMER_12_BIT);
     ledcAttachPin(LCD_BL, LEDC_CHANNEL_0);
     setBrightness(250);
+    boot_trace_begin("gfx_begin");
     if (gfx->begin()) {
+#if QSPI_CHUNK_BUDGET
+        tune_qspi_chunk();
+#endif
+#if BUS_BENCH
+        run_bus_bench();
+#endif
         gfx->fillScreen(BLACK);
     } else {
         Serial.println("gfx->begin() failed!");
     }
+    boot_trace_end("gfx_begin");
+    report_heap("after gfx->begin()");
+    boot_trace_begin("lv_init");
     lv_init();
-    lv_disp_draw_buf_init(&draw_buf, disp_draw_buf, NULL, SCREEN_WIDTH * SCR_BUF_LEN);
+    boot_trace_end("lv_init");
     lv_disp_drv_init(&disp_drv);
     disp_drv.hor_res = SCREEN_WIDTH;
     disp_drv.ver_res = SCREEN_HEIGHT;
+#if RENDER_MODE == RENDER_LVGL_DIRECT
+    disp_draw_buf1 = (lv_color_t *)heap_caps_aligned_alloc(16, SCREEN_WIDTH * SCR_BUF_LEN * sizeof(lv_color_t), MALLOC_CAP_DMA);
+    disp_draw_buf2 = (lv_color_t *)heap_caps_aligned_alloc(16, SCREEN_WIDTH * SCR_BUF_LEN * sizeof(lv_color_t), MALLOC_CAP_DMA);
+    if (!disp_draw_buf1 || !disp_draw_buf2) {
+        Serial.println("LVGL draw buffer allocation failed!");
+    }
+    lv_disp_draw_buf_init(&draw_buf, disp_draw_buf1, disp_draw_buf2, SCREEN_WIDTH * SCR_BUF_LEN);
     disp_drv.flush_cb = my_disp_flush;
+    bus->setTransDoneCallback(my_disp_flush_done, &disp_drv);
+#elif RENDER_MODE == RENDER_CANVAS_FLUSH
+    disp_draw_buf1 = (lv_color_t *)malloc(SCREEN_WIDTH * SCR_BUF_LEN * sizeof(lv_color_t));
+    if (!disp_draw_buf1) {
+        Serial.println("LVGL draw buffer allocation failed!");
+    }
+    lv_disp_draw_buf_init(&draw_buf, disp_draw_buf1, NULL, SCREEN_WIDTH * SCR_BUF_LEN);
+    disp_drv.flush_cb = my_canvas_flush;
+#else // RENDER_CANVAS_DIRECT_MODE
+    lv_disp_draw_buf_init(&draw_buf, (lv_color_t *)canvas->getFramebuffer(), NULL, SCREEN_WIDTH * SCREEN_HEIGHT);
+    disp_drv.direct_mode = 1;
+    disp_drv.flush_cb = my_direct_flush;
+#endif
     disp_drv.draw_buf = &draw_buf;
+    disp_drv.monitor_cb = my_disp_monitor;
+    disp_drv.render_start_cb = my_render_start;
+    disp_drv.wait_cb = my_disp_wait;
     lv_disp_drv_register(&disp_drv);
+    report_heap("after LVGL display buffers");
 
     // Touch init
     // touch.begin(); // No longer needed, begin() is protected or handled by constructor
@@ -252,6 +613,8 @@ void lvgl_init() {
     indev_drv.type = LV_INDEV_TYPE_POINTER;
     indev_drv.read_cb = my_touchpad_read;
     lv_indev_drv_register(&indev_drv);
+    touch_read_timer = indev_drv.read_timer;
+    lv_timer_pause(touch_read_timer);
 
     // Create a label to display touch coordinates (disabled by default)
     touch_label = lv_label_create(lv_scr_act());
@@ -259,189 +622,454 @@ void lvgl_init() {
     lv_obj_align(touch_label, LV_ALIGN_TOP_MID, 0, 0);
 }
 
-// Helper: Find last Sunday of a month
-int last_sunday(int year, int month) {
-    struct tm t = {0};
-    t.tm_year = year - 1900;
-    t.tm_mon = month;
-    t.tm_mday = 31;
-    t.tm_hour = 1;
-    mktime(&t);
-    int wday = t.tm_wday;
-    t.tm_mday -= wday;
-    mktime(&t);
-    return t.tm_mday;
-}
-
-// Helper: Find Nth Sunday of a month (n >= 1)
-int nth_sunday(int year, int month, int n) {
-    struct tm t = {0};
-    t.tm_year = year - 1900;
-    t.tm_mon = month;
-    t.tm_mday = 1;
-    t.tm_hour = 1;
-    mktime(&t);
-    int wday = t.tm_wday;
-    int first_sunday = (wday == 0) ? 1 : (8 - wday);
-    return first_sunday + 7 * (n - 1);
-}
-
-// Returns true if DST is in effect for London (last Sunday March to last Sunday October)
-bool is_dst_london(const struct tm* t) {
-    int year = t->tm_year + 1900;
-    int mon = t->tm_mon;
-    int mday = t->tm_mday;
-    int wday = t->tm_wday;
-    if (mon < 2 || mon > 9) return false; // Jan, Feb, Nov, Dec: no DST
-    if (mon > 2 && mon < 9) return true;  // Apr-Sep: DST
-    if (mon == 2) { // March
-        int last = last_sunday(year, 2);
-        if (mday > last) return true;
-        if (mday < last) return false;
-        // On last Sunday: DST starts at 1:00 UTC
-        return t->tm_hour >= 1;
+// LVGL runs only in ui_task, pinned to UI_CORE; the network loop stays in
+// app_main on NET_CORE, next to the WiFi stack
+#define UI_CORE 1
+#define NET_CORE 0
+#define UI_TASK_PRIORITY 2          // above the network loop, which runs at 1
+#define UI_QUEUE_LEN 16
+#define UI_NOTIFY_MSG (1u << 2)     // next to the TICK_NOTIFY bits
+#define UI_NOTIFY_TOUCH (1u << 3)
+#define UI_NOTIFY_ALL (TICK_NOTIFY_ALL | UI_NOTIFY_MSG | UI_NOTIFY_TOUCH)
+#define UI_IDLE_MAX_MS 1000         // upper bound on a wait with no LVGL timer due
+#define TICK_HEAP_WARMUP 3          // ticks allowed to allocate, see note_tick_heap()
+#ifndef TICK_ALLOC_STRICT
+#define TICK_ALLOC_STRICT 0         // 1: abort when a tick after the warm-up allocates
+#endif
+#define NET_IDLE_MAX_MS 1000        // MQTT keepalive, WiFi state and reports
+
+// UI state owned by ui_task; the network loop sends changes through
+// ui_queue instead of touching LVGL or these copies
+enum UiMsgType : uint8_t {
+    UI_MSG_IP,                      // IPv4 address, 0 while disconnected
+    UI_MSG_SYNC_STATE,              // TimeSyncState
+    UI_MSG_SYNCED,                  // 1 once a server solution has been applied
+};
+
+struct UiMsg {
+    UiMsgType type;
+    uint32_t value;
+};
+
+static SpscQueue<UiMsg, UI_QUEUE_LEN> ui_queue;
+static TaskHandle_t ui_task_handle = nullptr;
+static uint32_t ui_ip = 0;
+static char ui_ip_text[16] = "0.0.0.0";   // formatted once per address change
+static TimeSyncState ui_sync_state = TIME_SYNC_IDLE;
+static bool ui_synced = false;
+
+// Network loop side; false if the queue is full, so the caller retries
+static bool ui_post(UiMsgType type, uint32_t value) {
+    UiMsg m = {type, value};
+    if (!spsc_push(&ui_queue, m))
+        return false;
+    if (ui_task_handle)
+        xTaskNotify(ui_task_handle, UI_NOTIFY_MSG, eSetBits);
+    return true;
+}
+
+// The GT911 pulses TOUCH_INT for every report while touched; either edge
+// restarts LVGL's touch polling
+static void IRAM_ATTR touch_isr() {
+    BaseType_t woken = pdFALSE;
+    if (ui_task_handle)
+        xTaskNotifyFromISR(ui_task_handle, UI_NOTIFY_TOUCH, eSetBits, &woken);
+    if (woken)
+        portYIELD_FROM_ISR();
+}
+
+// ui_task side
+static void ui_drain() {
+    UiMsg m;
+    while (spsc_pop(&ui_queue, &m)) {
+        switch (m.type) {
+        case UI_MSG_IP:
+            ui_ip = m.value;
+            // lwIP keeps the address in network order, first octet lowest
+            snprintf(ui_ip_text, sizeof(ui_ip_text), "%u.%u.%u.%u", (unsigned)(ui_ip & 0xFF),
+                     (unsigned)((ui_ip >> 8) & 0xFF), (unsigned)((ui_ip >> 16) & 0xFF), (unsigned)(ui_ip >> 24));
+            break;
+        case UI_MSG_SYNC_STATE:
+            ui_sync_state = (TimeSyncState)m.value;
+            break;
+        case UI_MSG_SYNCED:
+            ui_synced = m.value != 0;
+            break;
+        }
     }
-    if (mon == 9) { // October
-        int last = last_sunday(year, 9);
-        if (mday < last) return true;
-        if (mday > last) return false;
-        // On last Sunday: DST ends at 1:00 UTC
-        return t->tm_hour < 1;
+}
+
+#define TIMING_REPORT_INTERVAL_MS 60000UL
+
+// UI frame time, excluding the notification wait; frames while NTP is
+// waiting or slewing are also kept apart to show resync never stalls the
+// render loop. Filled by ui_task, taken by report_timing() under the lock.
+static Histogram loop_hist;
+static Histogram loop_sync_hist;
+// Pixels redrawn per committed tick, from my_disp_monitor()
+static Histogram tick_px_hist;
+// Heap calls ui_task made in prepare/commit; ticks after the warm-up that
+// allocate at all are counted apart
+static uint32_t tick_heap_ops = 0;
+static uint32_t tick_heap_ticks = 0;
+static portMUX_TYPE ui_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+// Network loop iteration time, owned by the network loop
+static Histogram net_hist;
+
+// Frame for the next second, computed before the boundary and shown on it
+static time_t prepared_second = 0;
+static uint16_t prepared_changed[ZONE_TABLE_MAX];
+static char prepared_date[CLOCK_DATE_MAX];
+static bool prepared_date_changed = false;
+
+void prepare_tick(time_t second) {
+    if (!time_sync_has_time())
+        return;
+    zone_table_convert_all(&city_zones, second, city_times);
+    for (int i = 0; i < city_zones.count; ++i)
+        prepared_changed[i] = clock_digits_advance(&city_clocks[i], city_times[i].local);
+    // The date line follows the first city and is rebuilt at its midnight
+    prepared_date_changed = prepared_changed[0] & CLOCK_CHANGED_DAY;
+    if (prepared_date_changed)
+        clock_format_date(city_times[0].local, prepared_date, sizeof(prepared_date));
+    prepared_second = second;
+}
+
+// Applies the prepared frame and renders it at once instead of waiting for
+// LVGL's next refresh period
+void commit_tick(time_t second) {
+    static uint32_t shown_ip = 0;
+    static int shown_synced = -1;
+    uint32_t ip = ui_ip;
+    if (!time_sync_has_time()) {
+        // Nothing restored and no server reply yet: no times to show
+        if (shown_synced != 0 || ip != shown_ip)
+            lvgl_show_date("Waiting for network time", ui_ip_text, nullptr);
+        shown_synced = 0;
+        shown_ip = ip;
+    } else {
+        if (prepared_second != second)
+            prepare_tick(second); // missed the prepare point, e.g. after a clock step
+        lvgl_show_times(city_clocks, prepared_changed, city_zones.count);
+        int synced = ui_synced;
+        if (prepared_date_changed || ip != shown_ip || synced != shown_synced) {
+            shown_ip = ip;
+            shown_synced = synced;
+            lvgl_show_date(prepared_date, ui_ip_text, synced ? nullptr : "unsynced");
+        }
+        time_sync_checkpoint();
     }
-    return false;
-}
-
-// Returns true if DST is in effect for New York (second Sunday March to first Sunday November)
-bool is_dst_ny(const struct tm* t) {
-    int year = t->tm_year + 1900;
-    int mon = t->tm_mon;
-    int mday = t->tm_mday;
-    int wday = t->tm_wday;
-    if (mon < 2 || mon > 10) return false; // Jan, Feb, Dec: no DST
-    if (mon > 2 && mon < 10) return true;  // Apr-Oct: DST
-    if (mon == 2) { // March
-        int second = nth_sunday(year, 2, 2);
-        if (mday > second) return true;
-        if (mday < second) return false;
-        // On second Sunday: DST starts at 2:00 local time (7:00 UTC)
-        return t->tm_hour >= 7;
+    flip_pending = true;
+    tick_px = 0;
+    lv_refr_now(NULL);
+    flip_pending = false;
+    portENTER_CRITICAL(&ui_stats_lock);
+    histogram_add(&tick_px_hist, tick_px);
+    portEXIT_CRITICAL(&ui_stats_lock);
+}
+
+// {"frame":{...}}: render, flush and bus figures, see frame_metrics.h
+static void format_frame_metrics(char* msg, size_t len, bool reset) {
+    esp32qspi_stats_t s;
+    bus->getStats(&s);
+    FrameBusTotals totals = {s.transactions, s.bytes, s.busy_us};
+    FrameMetrics m;
+    frame_metrics_take(&m, &totals, reset);
+    char frame[640];
+    frame_metrics_format_json(&m, frame, sizeof(frame));
+    snprintf(msg, len, "{\"frame\":%s}", frame);
+}
+
+// Second-flip latency and loop timing over the last interval, on serial and MQTT
+void report_timing() {
+    FlipLatencyStats s;
+    tick_scheduler_take_flip_stats(&s);
+    NtpSolution ntp = {};
+    time_sync_last_solution(&ntp);
+    Histogram loop, loop_sync, px;
+    portENTER_CRITICAL(&ui_stats_lock);
+    loop = loop_hist;
+    loop_sync = loop_sync_hist;
+    px = tick_px_hist;
+    uint32_t heap_ops = tick_heap_ops, heap_ticks = tick_heap_ticks;
+    tick_heap_ops = 0;
+    tick_heap_ticks = 0;
+    histogram_reset(&loop_hist);
+    histogram_reset(&loop_sync_hist);
+    histogram_reset(&tick_px_hist);
+    portEXIT_CRITICAL(&ui_stats_lock);
+    char loop_json[128], sync_json[128], net_json[128], px_json[128], msg[768];
+    histogram_format_json(&loop, loop_json, sizeof(loop_json));
+    histogram_format_json(&loop_sync, sync_json, sizeof(sync_json));
+    histogram_format_json(&net_hist, net_json, sizeof(net_json));
+    histogram_format_json(&px, px_json, sizeof(px_json));
+    snprintf(msg, sizeof(msg),
+             "{\"flip_latency_us\":{\"n\":%u,\"min\":%d,\"avg\":%d,\"max\":%d},"
+             "\"loop_us\":%s,\"loop_sync_us\":%s,\"net_loop_us\":%s,\"tick_px\":%s,"
+             "\"tick_heap_ops\":%u,\"tick_heap_ticks\":%u,"
+             "\"ntp\":\"%s\",\"ntp_updates\":%u,"
+             "\"ntp_offset_us\":%d,\"ntp_jitter_us\":%d,\"ntp_survivors\":%u,"
+             "\"freq_ppb\":%d,\"poll_s\":%u,\"boot_first_pixel_ms\":%d,\"boot_synced_ms\":%d}",
+             (unsigned)s.count, (int)s.min_us, (int)(s.count ? s.sum_us / s.count : 0), (int)s.max_us,
+             loop_json, sync_json, net_json, px_json, (unsigned)heap_ops, (unsigned)heap_ticks,
+             time_sync_state_name(time_sync_state()), (unsigned)time_sync_count(),
+             (int)ntp.offset_us, (int)ntp.jitter_us, (unsigned)ntp.survivors,
+             (int)time_sync_freq_ppb(), (unsigned)time_sync_poll_s(),
+             (int)(boot_first_pixel_us / 1000), (int)(boot_synced_us / 1000));
+    Serial.println(msg);
+    if (loop_sync.max > LV_DISP_DEF_REFR_PERIOD * 1000)
+        Serial.println("UI frame exceeded the refresh period during NTP sync");
+    if (mqtt_ready)
+        mqttClient.publish(MQTT_TOPIC, msg);
+    histogram_reset(&net_hist);
+
+    char cpu_json[384];
+    task_stats_format_json(cpu_json, sizeof(cpu_json));
+    snprintf(msg, sizeof(msg), "{\"cpu_pct\":%s}", cpu_json);
+    Serial.println(msg);
+    if (mqtt_ready)
+        mqttClient.publish(MQTT_TOPIC, msg);
+
+    format_frame_metrics(msg, sizeof(msg), true);
+    Serial.println(msg);
+    if (mqtt_ready)
+        mqttClient.publish(MQTT_TOPIC, msg);
+}
+
+// Line commands on the serial console, read from the network loop:
+// "metrics" prints the frame metrics so far without starting a new interval
+static void poll_serial_commands() {
+    static char line[32];
+    static size_t n = 0;
+    while (Serial.available()) {
+        int c = Serial.read();
+        if (c != '\n' && c != '\r') {
+            if (n < sizeof(line) - 1)
+                line[n++] = (char)c;
+            continue;
+        }
+        line[n] = '\0';
+        if (strcmp(line, "metrics") == 0) {
+            char msg[768];
+            format_frame_metrics(msg, sizeof(msg), false);
+            Serial.println(msg);
+        } else if (n) {
+            Serial.println("Commands: metrics");
+        }
+        n = 0;
     }
-    if (mon == 10) { // November
-        int first = nth_sunday(year, 10, 1);
-        if (mday < first) return true;
-        if (mday > first) return false;
-        // On first Sunday: DST ends at 2:00 local time (6:00 UTC)
-        return t->tm_hour < 6;
+}
+
+static void serial_write(const char* s, size_t len, void*) {
+    Serial.write((const uint8_t*)s, len);
+}
+
+// Once the clock is synced and MQTT is up: the full trace on serial, for
+// chrome://tracing or ui.perfetto.dev, and phase durations on MQTT
+void report_boot_trace() {
+    boot_trace_reported = true;
+    if (boot_first_pixel_us)
+        boot_trace_instant_at("first_pixel", boot_first_pixel_us);
+    boot_trace_instant("boot_done");
+    int n = boot_trace_count();
+    Serial.print("[boot_trace] ");
+    boot_trace_write_json(boot_trace_events(), n, serial_write, nullptr);
+    Serial.println();
+    char phases[512], msg[544];
+    boot_trace_summary_json(boot_trace_events(), n, phases, sizeof(phases));
+    snprintf(msg, sizeof(msg), "{\"boot_ms\":%s}", phases);
+    Serial.println(msg);
+    mqttClient.publish(MQTT_TOPIC, msg);
+}
+
+static BootGraph boot_graph;
+
+// Blocks until an NTP reply or MQTT data arrives, or timeout_ms passes
+static void net_wait(uint32_t timeout_ms) {
+    // PubSubClient takes one packet per loop(); the rest waits in the
+    // client's buffer, where select() cannot see it
+    if (mqtt_ready && espClient.available())
+        return;
+    fd_set fds;
+    FD_ZERO(&fds);
+    int max_fd = -1;
+    int ntp_fd = time_sync_socket();
+    int mqtt_fd = mqtt_ready ? espClient.fd() : -1;
+    if (ntp_fd >= 0) {
+        FD_SET(ntp_fd, &fds);
+        max_fd = ntp_fd;
     }
-    return false;
-}
-
-// Returns true if DST is in effect for California (same as New York)
-bool is_dst_ca(const struct tm* t) {
-    return is_dst_ny(t); // Follows US DST rules
-}
-
-// Returns true if DST is in effect for Chicago (same as New York)
-bool is_dst_chicago(const struct tm* t) {
-    return is_dst_ny(t); // Follows US DST rules
-}
-
-// Get local time for each city, with DST
-void get_city_times(time_t utc, struct tm* london, struct tm* ny, struct tm* blr, struct tm* phx, struct tm* palo, struct tm* chi) {
-    gmtime_r(&utc, london);
-    gmtime_r(&utc, ny);
-    gmtime_r(&utc, blr);
-    gmtime_r(&utc, phx);
-    gmtime_r(&utc, palo);
-    gmtime_r(&utc, chi);
-    // London: UTC+0, DST +1
-    struct tm t_london = *london;
-    if (is_dst_london(&t_london))
-        t_london.tm_hour += 1;
-    mktime(&t_london);
-    *london = t_london;
-    // New York: UTC-5, DST -4
-    struct tm t_ny = *ny;
-    t_ny.tm_hour -= 5;
-    mktime(&t_ny);
-    if (is_dst_ny(&t_ny)) {
-        t_ny.tm_hour += 1; // UTC-4
-        mktime(&t_ny);
+    if (mqtt_fd >= 0) {
+        FD_SET(mqtt_fd, &fds);
+        if (mqtt_fd > max_fd)
+            max_fd = mqtt_fd;
     }
-    *ny = t_ny;
-    // Bangalore: UTC+5:30, no DST
-    struct tm t_blr = *blr;
-    t_blr.tm_hour += 5;
-    t_blr.tm_min += 30;
-    mktime(&t_blr);
-    *blr = t_blr;
-    // Phoenix: UTC-7, no DST
-    struct tm t_phx = *phx;
-    t_phx.tm_hour -= 7;
-    mktime(&t_phx);
-    *phx = t_phx;
-    // Palo Alto: UTC-8, DST -7
-    struct tm t_palo = *palo;
-    t_palo.tm_hour -= 8;
-    mktime(&t_palo);
-    if (is_dst_ca(&t_palo)) {
-        t_palo.tm_hour += 1; // UTC-7
-        mktime(&t_palo);
+    if (max_fd < 0) {
+        vTaskDelay(pdMS_TO_TICKS(timeout_ms));
+        return;
     }
-    *palo = t_palo;
-    // Chicago: UTC-6, DST -5
-    struct tm t_chi = *chi;
-    t_chi.tm_hour -= 6;
-    mktime(&t_chi);
-    if (is_dst_chicago(&t_chi)) {
-        t_chi.tm_hour += 1; // UTC-5
-        mktime(&t_chi);
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    select(max_fd + 1, &fds, nullptr, nullptr, &tv);
+}
+
+// Accumulates the heap calls of one tick, prepare through commit. The first
+// ticks fill every cell and grow LVGL's render buffers, later ones must
+// not allocate: with TICK_ALLOC_STRICT that is an assertion.
+static void note_tick_heap(uint32_t ops, bool committed) {
+    static uint32_t ticks = 0;
+    static uint32_t pending = 0;
+    pending += ops;
+    if (!committed)
+        return;
+    if (++ticks > TICK_HEAP_WARMUP && pending) {
+        portENTER_CRITICAL(&ui_stats_lock);
+        tick_heap_ops += pending;
+        ++tick_heap_ticks;
+        portEXIT_CRITICAL(&ui_stats_lock);
+#if TICK_ALLOC_STRICT
+        assert(!"tick path allocated");
+#endif
+    }
+    pending = 0;
+}
+
+// Owns LVGL: tick frames, queued UI state, touch input and LVGL timers
+void ui_task(void*) {
+    heap_monitor_watch_current_task();
+    ui_drain();
+    lv_obj_set_style_bg_color(lv_scr_act(), lv_color_black(), 0);
+    lvgl_create_clock_view(city_zones.count);
+    commit_tick((time_t)(time_sync_now_us() / 1000000));
+    if (!tick_scheduler_start(xTaskGetCurrentTaskHandle(), time_sync_now_us))
+        Serial.println("Tick timer failed");
+    uint32_t idle_ms = 0;
+    while (1) {
+        // Sleeps until the next tick event, a UI message, a touch or the
+        // next LVGL timer; LVGL pauses its refresh timer while nothing is
+        // invalidated, so an idle second costs only the tick wakes
+        uint32_t events = 0;
+        xTaskNotifyWait(0, UI_NOTIFY_ALL, &events, pdMS_TO_TICKS(idle_ms));
+        int64_t iteration_start = esp_timer_get_time();
+        ui_drain();
+        if (events & UI_NOTIFY_TOUCH) {
+            lv_timer_resume(touch_read_timer);
+            lv_timer_ready(touch_read_timer);
+        }
+        HeapCounts heap_before, heap_after;
+        heap_monitor_read_watched(&heap_before);
+        if (events & TICK_NOTIFY_PREPARE)
+            prepare_tick(tick_scheduler_pending_second());
+        if (events & TICK_NOTIFY_COMMIT)
+            commit_tick(tick_scheduler_commit_second());
+        heap_monitor_read_watched(&heap_after);
+        if (events & (TICK_NOTIFY_PREPARE | TICK_NOTIFY_COMMIT))
+            note_tick_heap(heap_monitor_ops(&heap_before, &heap_after), events & TICK_NOTIFY_COMMIT);
+        int64_t timer_start = esp_timer_get_time();
+        uint32_t next_ms = lv_timer_handler(); // LV_NO_TIMER_READY when all are paused
+        frame_metrics_add(FRAME_TIMER_US, (uint32_t)(esp_timer_get_time() - timer_start));
+        idle_ms = next_ms < UI_IDLE_MAX_MS ? next_ms : UI_IDLE_MAX_MS;
+        uint32_t iteration_us = (uint32_t)(esp_timer_get_time() - iteration_start);
+        TimeSyncState s = ui_sync_state;
+        portENTER_CRITICAL(&ui_stats_lock);
+        histogram_add(&loop_hist, iteration_us);
+        if (s == TIME_SYNC_WAITING || s == TIME_SYNC_RESTORED || s == TIME_SYNC_SLEWING)
+            histogram_add(&loop_sync_hist, iteration_us);
+        portEXIT_CRITICAL(&ui_stats_lock);
+    }
+}
+
+void touch_init() {
+    Wire.begin(TOUCH_SDA, TOUCH_SCL); // Initialize I2C before using TouchLib
+    Wire.beginTransmission(GT911_SLAVE_ADDRESS1);
+    if (Wire.endTransmission() != 0)
+        Serial.println("Touch controller not responding");
+    pinMode(TOUCH_INT, INPUT);
+    attachInterrupt(TOUCH_INT, touch_isr, CHANGE);
+}
+
+void zones_init() {
+    if (!tzdb_open_partition(&tzdb))
+        Serial.println("No tzdb partition, using built-in TZ rules");
+    zone_table_init(&city_zones);
+    for (int i = 0; i < CITY_COUNT; ++i) {
+        clock_digits_init(&city_clocks[i]);
+        if (zone_table_add_tzdb(&city_zones, &tzdb, cities[i].zone) >= 0)
+            continue;
+        if (zone_table_add(&city_zones, cities[i].tz) < 0) {
+            Serial.printf("Bad TZ rule for %s: %s, using UTC\n", cities[i].name, cities[i].tz);
+            zone_table_add(&city_zones, "UTC0"); // keep zone indices aligned with cities[]
+        }
     }
-    *chi = t_chi;
 }
 
 extern "C" void app_main() {
     // Arduino core setup
+    boot_trace_begin("initArduino");
     initArduino();
+    boot_trace_end("initArduino");
     Serial.begin(115200);
-    Wire.begin(TOUCH_SDA, TOUCH_SCL); // Initialize I2C before using TouchLib
-    connectToWiFi();
-    syncTime();
-    connectToMQTT();
-    lvgl_init();
-    // Set black background
-    lv_obj_set_style_bg_color(lv_scr_act(), lv_color_black(), 0);
-    unsigned long last_ntp_sync = millis();
-    const unsigned long ntp_interval = 57UL * 60UL * 1000UL; // 57 minutes in ms
+    report_heap("boot");
+    if (time_sync_restore())
+        Serial.println("Time restored, unsynced");
+    // Panel reset and sleep-out delays, the touch bus, tz tables and the
+    // network chain mostly wait on hardware, so they all start at once;
+    // display init runs on UI_CORE, where the flush ISR then lives
+    if (!boot_graph_init(&boot_graph))
+        Serial.println("Boot graph failed");
+    BootStepMask ui_steps = boot_graph_add(&boot_graph, "display", lvgl_init, 0, UI_CORE, 6144);
+    ui_steps |= boot_graph_add(&boot_graph, "touch", touch_init, 0, tskNO_AFFINITY, 3072);
+    ui_steps |= boot_graph_add(&boot_graph, "zones", zones_init, 0, tskNO_AFFINITY, 4096);
+    BootStepMask wifi = boot_graph_add(&boot_graph, "wifi", connectToWiFi, 0, NET_CORE, 6144);
+    boot_graph_add(&boot_graph, "ntp", syncTime, wifi, NET_CORE, 6144);
+    boot_graph_add(&boot_graph, "mqtt", mqtt_init, wifi, NET_CORE, 6144);
+    if (!boot_graph_start(&boot_graph))
+        Serial.println("Boot task creation failed");
+    // First frame as soon as the UI chain is in, on a restored time if there
+    // is one; the network steps finish in the background
+    boot_graph_wait(&boot_graph, ui_steps, portMAX_DELAY);
+    xTaskCreatePinnedToCore(ui_task, "ui", 8192, nullptr, UI_TASK_PRIORITY, &ui_task_handle, UI_CORE);
+
+    // Network loop: NTP, MQTT and reporting; a stall here no longer delays
+    // a frame, UI changes go to ui_task through ui_queue. Sleeps in select()
+    // on the NTP and MQTT sockets until data arrives or a poll is due.
+    unsigned long last_timing_report = millis();
+    TimeSyncState sync_state = time_sync_state();
+    TimeSyncState sent_state = TIME_SYNC_IDLE;
+    bool sent_synced = false;
+    uint32_t sent_ip = 0;
     while (1) {
-        static time_t last_time = 0;
-        time_t now = time(nullptr);
-        if (now != last_time) {
-            last_time = now;
-            struct tm t_london, t_ny, t_blr, t_phx, t_palo, t_chi;
-            get_city_times(now, &t_london, &t_ny, &t_blr, &t_phx, &t_palo, &t_chi);
-            // Pad city names to align times
-            const char* city_names[] = {"London", "New York", "Bangalore", "Phoenix", "Palo Alto", "Chicago"};
-            char buf_london[40], buf_ny[40], buf_blr[40], buf_phx[40], buf_palo[40], buf_chi[40];
-            int pad = 11; // Longest city name + 1
-            snprintf(buf_london, sizeof(buf_london), "%-*s %02d:%02d:%02d", pad, city_names[0], t_london.tm_hour, t_london.tm_min, t_london.tm_sec);
-            snprintf(buf_ny, sizeof(buf_ny),     "%-*s %02d:%02d:%02d", pad, city_names[1], t_ny.tm_hour, t_ny.tm_min, t_ny.tm_sec);
-            snprintf(buf_blr, sizeof(buf_blr),   "%-*s %02d:%02d:%02d", pad, city_names[2], t_blr.tm_hour, t_blr.tm_min, t_blr.tm_sec);
-            snprintf(buf_phx, sizeof(buf_phx),   "%-*s %02d:%02d:%02d", pad, city_names[3], t_phx.tm_hour, t_phx.tm_min, t_phx.tm_sec);
-            snprintf(buf_palo, sizeof(buf_palo), "%-*s %02d:%02d:%02d", pad, city_names[4], t_palo.tm_hour, t_palo.tm_min, t_palo.tm_sec);
-            snprintf(buf_chi, sizeof(buf_chi),   "%-*s %02d:%02d:%02d", pad, city_names[5], t_chi.tm_hour, t_chi.tm_min, t_chi.tm_sec);
-            // Format date string from London time
-            char date_str[40];
-            strftime(date_str, sizeof(date_str), "%A, %d %B %Y", &t_london);
-            lvgl_show_times(buf_london, buf_ny, buf_blr, buf_phx, buf_palo, buf_chi, date_str);
+        uint32_t wait_ms = time_sync_wait_ms();
+        net_wait(wait_ms < NET_IDLE_MAX_MS ? wait_ms : NET_IDLE_MAX_MS);
+        int64_t iteration_start = esp_timer_get_time();
+        // NTP polls and corrections run in the background, see time_sync.h
+        TimeSyncState s = time_sync_poll();
+        if (s != sync_state) {
+            Serial.printf("NTP %s\n", time_sync_state_name(s));
+            sync_state = s;
+            if (!boot_synced_us && time_sync_synced()) {
+                boot_synced_us = esp_timer_get_time();
+                boot_trace_end("ntp_sync");
+            }
         }
-        // NTP resync every 57 minutes
-        if (millis() - last_ntp_sync > ntp_interval) {
-            syncTime();
-            last_ntp_sync = millis();
+        if (s != sent_state && ui_post(UI_MSG_SYNC_STATE, s))
+            sent_state = s;
+        bool synced = time_sync_synced();
+        if (synced != sent_synced && ui_post(UI_MSG_SYNCED, synced))
+            sent_synced = synced;
+        uint32_t ip = net_ip;
+        if (ip != sent_ip && ui_post(UI_MSG_IP, ip))
+            sent_ip = ip;
+        if (mqtt_ready)
+            mqttClient.loop();
+        poll_serial_commands();
+        if (!boot_trace_reported && boot_synced_us && mqtt_ready)
+            report_boot_trace();
+        if (millis() - last_timing_report > TIMING_REPORT_INTERVAL_MS) {
+            report_timing();
+            last_timing_report = millis();
         }
-        mqttClient.loop();
-        lv_timer_handler();
-        delay(10);
+        histogram_add(&net_hist, (uint32_t)(esp_timer_get_time() - iteration_start));
     }
 }
@@ -0,0 +1,383 @@
+// ntp_client.cpp - multi-server NTP client with clock filter and selection (RFC 5905)
+#include "ntp_client.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <netdb.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define NTP_PACKET_SIZE 48
+#define NTP_UNIX_EPOCH 2208988800ULL    // 1900-01-01 to 1970-01-01, seconds
+#define NTP_MODE_CLIENT 3
+#define NTP_MODE_SERVER 4
+#define NTP_LEAP_UNSYNC 3
+#define NTP_MAX_DIST_US 1500000         // RFC 5905 MAXDIST
+
+static int64_t system_clock_us() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+// ---- timestamps ----
+
+static uint64_t us_to_ntp(int64_t us) {
+    uint64_t sec = (uint64_t)(us / 1000000) + NTP_UNIX_EPOCH;
+    uint64_t frac = ((uint64_t)(us % 1000000) << 32) / 1000000;
+    return (sec << 32) | frac;
+}
+
+// NTP era 0 ends in 2036; seconds below 2^31 are taken as era 1
+static int64_t ntp_to_us(uint64_t ntp) {
+    uint32_t sec = (uint32_t)(ntp >> 32);
+    int64_t s = (int64_t)sec - (int64_t)NTP_UNIX_EPOCH;
+    if (!(sec & 0x80000000u))
+        s += 1LL << 32;
+    return s * 1000000 + (int64_t)((((ntp & 0xFFFFFFFFu) * 1000000) + (1u << 31)) >> 32);
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint64_t get64(const uint8_t* p) {
+    return ((uint64_t)get32(p) << 32) | get32(p + 4);
+}
+
+static void put64(uint8_t* p, uint64_t v) {
+    for (int i = 7; i >= 0; --i, v >>= 8)
+        p[i] = (uint8_t)v;
+}
+
+// NTP short format (16.16 seconds) to microseconds
+static int64_t short_to_us(uint32_t v) {
+    return ((int64_t)v * 1000000) >> 16;
+}
+
+// ---- setup ----
+
+bool ntp_client_init(NtpClient* c, ntp_clock_fn clock) {
+    memset(c, 0, sizeof(*c));
+    c->clock = clock ? clock : system_clock_us;
+    c->sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (c->sock < 0)
+        return false;
+    int flags = fcntl(c->sock, F_GETFL, 0);
+    if (fcntl(c->sock, F_SETFL, flags | O_NONBLOCK) < 0) {
+        ntp_client_close(c);
+        return false;
+    }
+    return true;
+}
+
+void ntp_client_close(NtpClient* c) {
+    if (c->sock >= 0)
+        close(c->sock);
+    c->sock = -1;
+}
+
+int ntp_client_add_peer_addr(NtpClient* c, const struct sockaddr_in* addr) {
+    if (c->peer_count >= NTP_MAX_PEERS)
+        return -1;
+    // Pool names can resolve to the same server twice; a duplicate would
+    // count as two votes in the selection
+    for (int i = 0; i < c->peer_count; ++i)
+        if (c->peers[i].addr.sin_addr.s_addr == addr->sin_addr.s_addr && c->peers[i].addr.sin_port == addr->sin_port)
+            return -1;
+    NtpPeer* p = &c->peers[c->peer_count];
+    memset(p, 0, sizeof(*p));
+    p->addr = *addr;
+    return c->peer_count++;
+}
+
+int ntp_client_add_peer(NtpClient* c, const char* host, uint16_t port) {
+    struct addrinfo hints, *res = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(host, nullptr, &hints, &res) != 0 || !res)
+        return -1;
+    struct sockaddr_in addr = *(struct sockaddr_in*)res->ai_addr;
+    freeaddrinfo(res);
+    addr.sin_port = htons(port);
+    return ntp_client_add_peer_addr(c, &addr);
+}
+
+void ntp_client_remove_peer(NtpClient* c, int i) {
+    if (i < 0 || i >= c->peer_count)
+        return;
+    memmove(&c->peers[i], &c->peers[i + 1], (c->peer_count - i - 1) * sizeof(NtpPeer));
+    --c->peer_count;
+}
+
+// ---- polling ----
+
+void ntp_client_poll(NtpClient* c) {
+    for (int i = 0; i < c->peer_count; ++i) {
+        NtpPeer* p = &c->peers[i];
+        uint8_t pkt[NTP_PACKET_SIZE];
+        memset(pkt, 0, sizeof(pkt));
+        pkt[0] = (4 << 3) | NTP_MODE_CLIENT; // LI 0, version 4
+        p->reach <<= 1;
+        if (p->polls < NTP_REACH_POLLS)
+            ++p->polls;
+        p->xmt_us = c->clock();
+        p->xmt_ntp = us_to_ntp(p->xmt_us);
+        put64(pkt + 40, p->xmt_ntp);
+        p->pending = sendto(c->sock, pkt, sizeof(pkt), 0, (const struct sockaddr*)&p->addr, sizeof(p->addr)) == sizeof(pkt);
+    }
+}
+
+bool ntp_client_busy(const NtpClient* c) {
+    for (int i = 0; i < c->peer_count; ++i)
+        if (c->peers[i].pending)
+            return true;
+    return false;
+}
+
+// Clock filter: keep the last NTP_FILTER_STAGES samples and take the one with
+// the lowest delay, which has the least queueing asymmetry in it
+static void clock_filter(NtpPeer* p, const NtpSample* s, int64_t now) {
+    int n = p->filter_count < NTP_FILTER_STAGES ? p->filter_count + 1 : NTP_FILTER_STAGES;
+    memmove(&p->filter[1], &p->filter[0], (n - 1) * sizeof(NtpSample));
+    p->filter[0] = *s;
+    p->filter_count = n;
+
+    NtpSample sorted[NTP_FILTER_STAGES];
+    int64_t dist[NTP_FILTER_STAGES];
+    for (int i = 0; i < n; ++i) {
+        sorted[i] = p->filter[i];
+        sorted[i].disp_us += (now - sorted[i].time_us) * NTP_PHI_PPM / 1000000;
+        dist[i] = sorted[i].delay_us / 2 + sorted[i].disp_us;
+    }
+    for (int i = 1; i < n; ++i)
+        for (int j = i; j > 0 && dist[j] < dist[j - 1]; --j) {
+            NtpSample t = sorted[j]; sorted[j] = sorted[j - 1]; sorted[j - 1] = t;
+            int64_t d = dist[j]; dist[j] = dist[j - 1]; dist[j - 1] = d;
+        }
+
+    p->offset_us = sorted[0].offset_us;
+    p->delay_us = sorted[0].delay_us;
+    p->disp_us = 0;
+    double sq = 0;
+    for (int i = 0; i < n; ++i) {
+        p->disp_us += sorted[i].disp_us >> (i + 1);
+        double d = (double)(sorted[i].offset_us - sorted[0].offset_us);
+        sq += d * d;
+    }
+    p->jitter_us = n > 1 ? (int64_t)sqrt(sq / (n - 1)) : 0;
+    p->valid = true;
+}
+
+static bool handle_reply(NtpClient* c, const uint8_t* pkt, const struct sockaddr_in* from, int64_t t4) {
+    NtpPeer* p = nullptr;
+    for (int i = 0; i < c->peer_count; ++i)
+        if (c->peers[i].pending && c->peers[i].addr.sin_addr.s_addr == from->sin_addr.s_addr &&
+            c->peers[i].addr.sin_port == from->sin_port)
+            p = &c->peers[i];
+    if (!p)
+        return false;
+
+    uint8_t leap = pkt[0] >> 6, mode = pkt[0] & 7, stratum = pkt[1];
+    uint64_t org = get64(pkt + 24), rec = get64(pkt + 32), xmt = get64(pkt + 40);
+    // Must answer our last request; kiss-o'-death and unsynchronized servers are ignored
+    if (mode != NTP_MODE_SERVER || org != p->xmt_ntp || !xmt || !rec)
+        return false;
+    p->pending = false;
+    if (leap == NTP_LEAP_UNSYNC || stratum == 0 || stratum > 15)
+        return false;
+
+    int64_t t1 = p->xmt_us, t2 = ntp_to_us(rec), t3 = ntp_to_us(xmt);
+    NtpSample s;
+    s.offset_us = ((t2 - t1) + (t3 - t4)) / 2;
+    s.delay_us = (t4 - t1) - (t3 - t2);
+    if (s.delay_us < 0)
+        s.delay_us = 0;
+    s.disp_us = 1 + (t4 - t1) * NTP_PHI_PPM / 1000000;
+    s.time_us = t4;
+
+    p->reach |= 1;
+    p->stratum = stratum;
+    p->root_delay_us = short_to_us(get32(pkt + 4));
+    p->root_disp_us = short_to_us(get32(pkt + 8));
+    clock_filter(p, &s, t4);
+    return true;
+}
+
+int ntp_client_service(NtpClient* c) {
+    int samples = 0;
+    for (;;) {
+        uint8_t pkt[NTP_PACKET_SIZE + 20];
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(c->sock, pkt, sizeof(pkt), 0, (struct sockaddr*)&from, &from_len);
+        if (n < 0)
+            break; // EWOULDBLOCK: nothing more queued
+        int64_t t4 = c->clock();
+        if (n >= NTP_PACKET_SIZE && handle_reply(c, pkt, &from, t4))
+            ++samples;
+    }
+    int64_t now = c->clock();
+    for (int i = 0; i < c->peer_count; ++i)
+        if (c->peers[i].pending && now - c->peers[i].xmt_us > NTP_TIMEOUT_US)
+            c->peers[i].pending = false;
+    return samples;
+}
+
+// ---- selection ----
+
+static int64_t root_distance(const NtpPeer* p, int64_t now) {
+    int64_t delay = p->root_delay_us + p->delay_us;
+    if (delay < 1000)
+        delay = 1000; // RFC 5905 MINDISP floor, in the same spirit
+    return delay / 2 + p->root_disp_us + p->disp_us + p->jitter_us +
+           (now - p->filter[0].time_us) * NTP_PHI_PPM / 1000000;
+}
+
+struct Endpoint {
+    int64_t value;
+    int type; // -1 low edge, 0 midpoint, +1 high edge
+};
+
+bool ntp_client_select(NtpClient* c, NtpSolution* out) {
+    int64_t now = c->clock();
+    int cand[NTP_MAX_PEERS];
+    int64_t dist[NTP_MAX_PEERS];
+    int n = 0;
+    for (int i = 0; i < c->peer_count; ++i) {
+        const NtpPeer* p = &c->peers[i];
+        if (!p->valid || !p->reach)
+            continue;
+        int64_t r = root_distance(p, now);
+        if (r >= NTP_MAX_DIST_US)
+            continue;
+        cand[n] = i;
+        dist[n++] = r;
+    }
+    if (!n)
+        return false;
+
+    // Intersection: the smallest interval containing the midpoints of a
+    // majority of correctness intervals [offset - r, offset + r]
+    Endpoint e[3 * NTP_MAX_PEERS];
+    int ne = 0;
+    for (int k = 0; k < n; ++k) {
+        int64_t off = c->peers[cand[k]].offset_us;
+        e[ne++] = {off - dist[k], -1};
+        e[ne++] = {off, 0};
+        e[ne++] = {off + dist[k], +1};
+    }
+    for (int i = 1; i < ne; ++i)
+        for (int j = i; j > 0 && e[j].value < e[j - 1].value; --j) {
+            Endpoint t = e[j]; e[j] = e[j - 1]; e[j - 1] = t;
+        }
+    int64_t low = 0, high = 0;
+    int allow;
+    for (allow = 0; 2 * allow < n; ++allow) {
+        int found = 0, chime = 0;
+        low = INT64_MAX;
+        high = INT64_MIN;
+        for (int j = 0; j < ne; ++j) {
+            chime -= e[j].type;
+            if (chime >= n - allow) {
+                low = e[j].value;
+                break;
+            }
+            if (e[j].type == 0)
+                ++found;
+        }
+        chime = 0;
+        for (int j = ne - 1; j >= 0; --j) {
+            chime += e[j].type;
+            if (chime >= n - allow) {
+                high = e[j].value;
+                break;
+            }
+            if (e[j].type == 0)
+                ++found;
+        }
+        if (found <= allow && low < high)
+            break;
+    }
+    if (2 * allow >= n)
+        return false;
+
+    // Survivors: truechimers, ordered by root distance
+    int surv[NTP_MAX_PEERS];
+    int64_t sdist[NTP_MAX_PEERS];
+    int ns = 0;
+    for (int k = 0; k < n; ++k) {
+        int64_t off = c->peers[cand[k]].offset_us;
+        if (off < low || off > high)
+            continue;
+        int j = ns++;
+        for (; j > 0 && sdist[j - 1] > dist[k]; --j) {
+            surv[j] = surv[j - 1];
+            sdist[j] = sdist[j - 1];
+        }
+        surv[j] = cand[k];
+        sdist[j] = dist[k];
+    }
+    out->truechimers = (uint8_t)ns;
+
+    // Cluster: drop the survivor furthest from the others while that spread
+    // is larger than the noise of the quietest peer
+    while (ns > NTP_CLUSTER_MIN) {
+        double max_sel = -1, min_peer = INFINITY;
+        int worst = 0;
+        for (int i = 0; i < ns; ++i) {
+            const NtpPeer* p = &c->peers[surv[i]];
+            double sq = 0;
+            for (int j = 0; j < ns; ++j) {
+                double d = (double)(c->peers[surv[j]].offset_us - p->offset_us);
+                sq += d * d;
+            }
+            double sel = sqrt(sq / (ns - 1));
+            if (sel > max_sel) {
+                max_sel = sel;
+                worst = i;
+            }
+            if (p->jitter_us < min_peer)
+                min_peer = (double)p->jitter_us;
+        }
+        if (max_sel <= min_peer)
+            break;
+        memmove(&surv[worst], &surv[worst + 1], (ns - worst - 1) * sizeof(int));
+        memmove(&sdist[worst], &sdist[worst + 1], (ns - worst - 1) * sizeof(int64_t));
+        --ns;
+    }
+
+    // Combine, weighting each survivor by 1 / root distance
+    double w_sum = 0, off_sum = 0;
+    for (int i = 0; i < ns; ++i) {
+        double w = 1.0 / (double)sdist[i];
+        w_sum += w;
+        off_sum += w * (double)c->peers[surv[i]].offset_us;
+    }
+    double offset = off_sum / w_sum;
+    double sq = 0;
+    for (int i = 0; i < ns; ++i) {
+        double d = (double)c->peers[surv[i]].offset_us - offset;
+        sq += d * d / (double)sdist[i];
+    }
+    double peer_jitter = (double)c->peers[surv[0]].jitter_us;
+    out->offset_us = (int64_t)llround(offset);
+    out->jitter_us = (int64_t)sqrt(sq / w_sum + peer_jitter * peer_jitter);
+    out->root_dist_us = sdist[0];
+    out->survivors = (uint8_t)ns;
+    return true;
+}
+
+void ntp_client_clock_adjusted(NtpClient* c, int64_t delta_us) {
+    for (int i = 0; i < c->peer_count; ++i) {
+        NtpPeer* p = &c->peers[i];
+        for (int k = 0; k < p->filter_count; ++k) {
+            p->filter[k].offset_us -= delta_us;
+            p->filter[k].time_us += delta_us;
+        }
+        p->offset_us -= delta_us;
+    }
+}
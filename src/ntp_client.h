@@ -0,0 +1,88 @@
+// ntp_client.h - multi-server NTP client with clock filter and selection (RFC 5905)
+#pragma once
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+#define NTP_PORT 123
+#define NTP_MAX_PEERS 4
+#define NTP_FILTER_STAGES 8
+#define NTP_CLUSTER_MIN 3           // the cluster algorithm stops pruning here
+#define NTP_TIMEOUT_US 2000000      // an unanswered request is dropped after this
+#define NTP_PHI_PPM 15              // dispersion growth, RFC 5905 PHI
+#define NTP_REACH_POLLS 8           // bits in the reach register
+
+// One offset/delay measurement, in microseconds
+struct NtpSample {
+    int64_t offset_us;
+    int64_t delay_us;
+    int64_t disp_us;
+    int64_t time_us;                // local clock when it was taken
+};
+
+struct NtpPeer {
+    struct sockaddr_in addr;
+    NtpSample filter[NTP_FILTER_STAGES]; // newest first
+    uint8_t filter_count;
+    uint8_t reach;                  // one bit per poll, 1 = answered
+    uint8_t polls;                  // requests sent, up to NTP_REACH_POLLS
+    uint8_t stratum;
+    int64_t root_delay_us;
+    int64_t root_disp_us;
+    // Clock filter output, valid once a sample has arrived
+    bool valid;
+    int64_t offset_us;
+    int64_t delay_us;
+    int64_t disp_us;
+    int64_t jitter_us;
+    // Outstanding request; the transmit timestamp comes back as the origin
+    bool pending;
+    uint64_t xmt_ntp;
+    int64_t xmt_us;
+};
+
+// Combined result of selection and clustering
+struct NtpSolution {
+    int64_t offset_us;              // add to the local clock
+    int64_t jitter_us;
+    int64_t root_dist_us;           // of the best survivor
+    uint8_t truechimers;
+    uint8_t survivors;
+};
+
+// Local UTC clock in microseconds since 1970
+typedef int64_t (*ntp_clock_fn)();
+
+struct NtpClient {
+    int sock;
+    ntp_clock_fn clock;
+    uint8_t peer_count;
+    NtpPeer peers[NTP_MAX_PEERS];
+};
+
+// Opens a non-blocking UDP socket; clock defaults to gettimeofday
+bool ntp_client_init(NtpClient* c, ntp_clock_fn clock);
+void ntp_client_close(NtpClient* c);
+// Resolves host (blocking DNS, call at startup) and adds it; returns the peer index or -1
+int ntp_client_add_peer(NtpClient* c, const char* host, uint16_t port);
+// Returns the peer index, or -1 when full or the address is already a peer
+int ntp_client_add_peer_addr(NtpClient* c, const struct sockaddr_in* addr);
+// Removes peer i; the peers after it move down one index
+void ntp_client_remove_peer(NtpClient* c, int i);
+// True once peer i has answered none of the last NTP_REACH_POLLS polls
+inline bool ntp_client_peer_unreachable(const NtpClient* c, int i) {
+    return c->peers[i].polls >= NTP_REACH_POLLS && !c->peers[i].reach;
+}
+
+// Sends one request to every peer; never blocks
+void ntp_client_poll(NtpClient* c);
+// Drains replies and expires old requests; returns the number of new samples
+int ntp_client_service(NtpClient* c);
+// True while any peer still has a request in flight
+bool ntp_client_busy(const NtpClient* c);
+// Intersection (Marzullo), cluster pruning and weighted combine; false
+// when no majority of peers agrees
+bool ntp_client_select(NtpClient* c, NtpSolution* out);
+// Call after the local clock was stepped or slewed by delta_us, with no
+// request in flight, so filter samples stay relative to the corrected clock
+void ntp_client_clock_adjusted(NtpClient* c, int64_t delta_us);
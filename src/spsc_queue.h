@@ -0,0 +1,36 @@
+// spsc_queue.h - lock-free ring for one producer task and one consumer task
+#pragma once
+
+#include <stdint.h>
+
+// Zero-initialised storage is an empty queue. Indices run freely and wrap
+// through the mask, so all N slots are usable.
+template <typename T, uint32_t N>
+struct SpscQueue {
+    static_assert(N && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+    T items[N];
+    uint32_t head;                  // next slot to write, producer only
+    uint32_t tail;                  // next slot to read, consumer only
+};
+
+// Producer side; false if the queue is full
+template <typename T, uint32_t N>
+bool spsc_push(SpscQueue<T, N>* q, const T& item) {
+    uint32_t head = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    if (head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) == N)
+        return false;
+    q->items[head & (N - 1)] = item;
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Consumer side; false if the queue is empty
+template <typename T, uint32_t N>
+bool spsc_pop(SpscQueue<T, N>* q, T* out) {
+    uint32_t tail = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == tail)
+        return false;
+    *out = q->items[tail & (N - 1)];
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
@@ -0,0 +1,59 @@
+// task_stats.cpp - per-task CPU share from the FreeRTOS run-time counters
+#include "task_stats.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#if configGENERATE_RUN_TIME_STATS && configUSE_TRACE_FACILITY
+
+struct TaskSample {
+    UBaseType_t number;
+    uint32_t runtime;
+};
+
+static TaskStatus_t status[TASK_STATS_MAX];
+static TaskSample last[TASK_STATS_MAX];
+static int last_count = 0;
+static uint32_t last_total = 0;
+
+static uint32_t previous_runtime(UBaseType_t number) {
+    for (int i = 0; i < last_count; ++i) {
+        if (last[i].number == number)
+            return last[i].runtime;
+    }
+    return 0; // started since the last call
+}
+
+size_t task_stats_format_json(char* buf, size_t len) {
+    uint32_t total = 0;
+    int count = (int)uxTaskGetSystemState(status, TASK_STATS_MAX, &total);
+    // The total is wall time on the run-time clock; every core accumulates
+    // it, so this is the reference for one core
+    uint32_t elapsed = total - last_total;
+    size_t pos = snprintf(buf, len, "{");
+    for (int i = 0; i < count; ++i) {
+        uint32_t busy = status[i].ulRunTimeCounter - previous_runtime(status[i].xTaskNumber);
+        unsigned pct = elapsed ? (unsigned)((uint64_t)busy * 100 / elapsed) : 0;
+        if (pos < len)
+            pos += snprintf(buf + pos, len - pos, "%s\"%s\":%u", i ? "," : "", status[i].pcTaskName, pct);
+    }
+    if (pos < len)
+        pos += snprintf(buf + pos, len - pos, "}");
+    for (int i = 0; i < count; ++i) {
+        last[i].number = status[i].xTaskNumber;
+        last[i].runtime = status[i].ulRunTimeCounter;
+    }
+    last_count = count;
+    last_total = total;
+    return pos;
+}
+
+#else
+
+size_t task_stats_format_json(char* buf, size_t len) {
+    return snprintf(buf, len, "{}");
+}
+
+#endif
@@ -0,0 +1,11 @@
+// task_stats.h - per-task CPU share from the FreeRTOS run-time counters
+#pragma once
+
+#include <stddef.h>
+
+#define TASK_STATS_MAX 24
+
+// {"task":pct,...} for the time since the previous call, in percent of one
+// core, so all tasks together add up to 100 per core; "{}" when the build
+// has no run-time stats (CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS)
+size_t task_stats_format_json(char* buf, size_t len);
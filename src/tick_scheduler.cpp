@@ -0,0 +1,112 @@
+// tick_scheduler.cpp - wakes the UI task just before and exactly on each wall-clock second
+#include "tick_scheduler.h"
+
+#include <string.h>
+#include <sys/time.h>
+#include <esp_attr.h>
+#include <esp_timer.h>
+
+#define US_PER_SEC 1000000LL
+
+static esp_timer_handle_t tick_timer = nullptr;
+static TaskHandle_t tick_task = nullptr;
+static tick_clock_fn tick_clock = nullptr;
+static volatile time_t pending_second = 0;
+static volatile time_t commit_second = 0;
+static bool commit_armed = false;
+
+// esp_timer_get_time() at the last committed boundary; the wall clock may be
+// slewed or stepped, the monotonic timer is what the ISR can read
+static volatile int64_t boundary_mono_us = 0;
+static volatile bool flip_open = false;
+static FlipLatencyStats flip_stats;
+static portMUX_TYPE flip_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static int64_t system_clock_us() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t)tv.tv_sec * US_PER_SEC + tv.tv_usec;
+}
+
+static void arm(int64_t delay_us) {
+    esp_timer_start_once(tick_timer, delay_us > 0 ? delay_us : 1);
+}
+
+// Runs in the esp_timer task. Alternates between the prepare point, LEAD
+// before a boundary, and the boundary itself; every wake re-reads the wall
+// clock so NTP slews and steps are followed.
+static void tick_timer_cb(void*) {
+    int64_t now = tick_clock();
+    time_t sec = (time_t)(now / US_PER_SEC);
+
+    if (commit_armed) {
+        int64_t boundary = (int64_t)pending_second * US_PER_SEC;
+        if (now >= boundary) {
+            commit_armed = false;
+            commit_second = pending_second;
+            boundary_mono_us = esp_timer_get_time() - (now - boundary);
+            flip_open = true;
+            xTaskNotify(tick_task, TICK_NOTIFY_COMMIT, eSetBits);
+        } else if (boundary - now <= US_PER_SEC) {
+            arm(boundary - now);
+            return;
+        } else {
+            commit_armed = false; // clock stepped back, start over
+        }
+    }
+
+    int64_t next = (int64_t)(sec + 1) * US_PER_SEC;
+    if (next - now <= TICK_PREPARE_LEAD_US) {
+        pending_second = sec + 1;
+        commit_armed = true;
+        xTaskNotify(tick_task, TICK_NOTIFY_PREPARE, eSetBits);
+        arm(next - now);
+    } else {
+        arm(next - TICK_PREPARE_LEAD_US - now);
+    }
+}
+
+bool tick_scheduler_start(TaskHandle_t task, tick_clock_fn clock) {
+    esp_timer_create_args_t args;
+    memset(&args, 0, sizeof(args));
+    args.callback = tick_timer_cb;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "tick";
+    if (esp_timer_create(&args, &tick_timer) != ESP_OK)
+        return false;
+    tick_task = task;
+    tick_clock = clock ? clock : system_clock_us;
+    memset(&flip_stats, 0, sizeof(flip_stats));
+    arm(1);
+    return true;
+}
+
+time_t tick_scheduler_pending_second() {
+    return pending_second;
+}
+
+time_t tick_scheduler_commit_second() {
+    return commit_second;
+}
+
+void IRAM_ATTR tick_scheduler_flip_done() {
+    if (!flip_open)
+        return;
+    int32_t latency = (int32_t)(esp_timer_get_time() - boundary_mono_us);
+    portENTER_CRITICAL_SAFE(&flip_lock);
+    flip_open = false;
+    if (!flip_stats.count || latency < flip_stats.min_us)
+        flip_stats.min_us = latency;
+    if (!flip_stats.count || latency > flip_stats.max_us)
+        flip_stats.max_us = latency;
+    flip_stats.sum_us += latency;
+    ++flip_stats.count;
+    portEXIT_CRITICAL_SAFE(&flip_lock);
+}
+
+void tick_scheduler_take_flip_stats(FlipLatencyStats* out) {
+    portENTER_CRITICAL(&flip_lock);
+    *out = flip_stats;
+    memset(&flip_stats, 0, sizeof(flip_stats));
+    portEXIT_CRITICAL(&flip_lock);
+}
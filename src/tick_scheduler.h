@@ -0,0 +1,39 @@
+// tick_scheduler.h - wakes the UI task just before and exactly on each wall-clock second
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Task notification bits, set with eSetBits on the task given to start()
+#define TICK_NOTIFY_PREPARE (1u << 0)   // next second is tick_scheduler_pending_second()
+#define TICK_NOTIFY_COMMIT  (1u << 1)   // tick_scheduler_commit_second() has just begun
+#define TICK_NOTIFY_ALL (TICK_NOTIFY_PREPARE | TICK_NOTIFY_COMMIT)
+
+#ifndef TICK_PREPARE_LEAD_US
+#define TICK_PREPARE_LEAD_US 20000      // time to compute the next frame before the boundary
+#endif
+
+// Second-flip latency: wall-clock boundary to the last pixel of that frame on the panel
+struct FlipLatencyStats {
+    uint32_t count;
+    int32_t min_us;
+    int32_t max_us;
+    int64_t sum_us;
+};
+
+// UTC in microseconds since 1970
+typedef int64_t (*tick_clock_fn)();
+
+// Starts the one-shot esp_timer chain on the given clock, gettimeofday if
+// null; false if the timer cannot be created
+bool tick_scheduler_start(TaskHandle_t task, tick_clock_fn clock);
+time_t tick_scheduler_pending_second();
+time_t tick_scheduler_commit_second();
+
+// Called once the last pixel of the committed frame is out; ISR safe.
+// Only the first call after each commit is recorded.
+void tick_scheduler_flip_done();
+// Copies the stats gathered since the last call and resets them
+void tick_scheduler_take_flip_stats(FlipLatencyStats* out);
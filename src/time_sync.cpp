@@ -0,0 +1,401 @@
+// time_sync.cpp - background multi-server NTP steering a disciplined clock
+#include "time_sync.h"
+
+#include <sys/time.h>
+#include <esp_attr.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <lwip/dns.h>
+#include <lwip/tcpip.h>
+#include <nvs.h>
+#include <string.h>
+
+#define SETTLED_POLL_S 256          // the drift is only saved once the loop has settled
+#define CHECKPOINT_MAGIC 0x54534331u // "TSC1"
+
+// Survives software resets, panics and watchdog resets, not power loss
+struct TimeCheckpoint {
+    uint32_t magic;
+    int64_t utc_us;                 // disciplined time ...
+    int64_t sys_us;                 // ... and the system clock at the same moment
+    uint32_t check;
+};
+RTC_NOINIT_ATTR static TimeCheckpoint rtc_checkpoint;
+
+enum LookupState : uint8_t {
+    LOOKUP_IDLE,
+    LOOKUP_PENDING,                 // the lwIP thread owns the slot's addr
+    LOOKUP_DONE,                    // addr holds the result
+    LOOKUP_FAILED,
+};
+
+// One per configured name; a pool name resolves to a different server each
+// time, so a name without a peer is looked up again
+struct ServerSlot {
+    const char* name;
+    int8_t peer;                    // index into ntp.peers, -1 while it has none
+    volatile LookupState lookup;
+    uint32_t addr;                  // IPv4, network order
+    int64_t next_lookup_us;
+};
+
+static NtpClient ntp;
+static NtpSolution last_solution;
+static ClockDiscipline clock_disc;
+static portMUX_TYPE clock_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool ntp_started = false;
+static uint32_t sync_count = 0;
+static uint32_t polls = 0;
+static int64_t last_sync_us = 0;
+static int64_t next_poll_us = 0;
+static int64_t saved_freq_ppb = 0;
+static int64_t saved_utc_s = 0;
+static int64_t last_save_us = 0;
+static bool round_open = false;
+static volatile TimeSyncState state = TIME_SYNC_IDLE; // read by time_sync_now_us() from any task
+static ServerSlot servers[NTP_MAX_PEERS];
+static uint8_t server_count = 0;
+
+static int64_t load_freq_ppb() {
+    nvs_handle_t h;
+    int32_t v = 0;
+    if (nvs_open(TIME_SYNC_NVS_NAMESPACE, NVS_READONLY, &h) == ESP_OK) {
+        nvs_get_i32(h, TIME_SYNC_NVS_FREQ_KEY, &v);
+        nvs_close(h);
+    }
+    return v;
+}
+
+static int64_t load_utc_s() {
+    nvs_handle_t h;
+    int64_t v = 0;
+    if (nvs_open(TIME_SYNC_NVS_NAMESPACE, NVS_READONLY, &h) == ESP_OK) {
+        nvs_get_i64(h, TIME_SYNC_NVS_TIME_KEY, &v);
+        nvs_close(h);
+    }
+    return v;
+}
+
+static void save_freq_ppb(int64_t freq) {
+    nvs_handle_t h;
+    if (nvs_open(TIME_SYNC_NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK)
+        return;
+    if (nvs_set_i32(h, TIME_SYNC_NVS_FREQ_KEY, (int32_t)freq) == ESP_OK && nvs_commit(h) == ESP_OK)
+        saved_freq_ppb = freq;
+    nvs_close(h);
+}
+
+static void save_utc_s(int64_t utc_s) {
+    nvs_handle_t h;
+    if (nvs_open(TIME_SYNC_NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK)
+        return;
+    if (nvs_set_i64(h, TIME_SYNC_NVS_TIME_KEY, utc_s) == ESP_OK && nvs_commit(h) == ESP_OK)
+        saved_utc_s = utc_s;
+    nvs_close(h);
+}
+
+static uint32_t checkpoint_check(const TimeCheckpoint* c) {
+    return c->magic ^ (uint32_t)c->utc_us ^ (uint32_t)(c->utc_us >> 32) ^
+           (uint32_t)c->sys_us ^ (uint32_t)(c->sys_us >> 32) ^ 0xA5A5A5A5u;
+}
+
+static int64_t system_clock_us() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+bool time_sync_restore() {
+    int64_t sys = system_clock_us(), estimate = 0;
+    saved_utc_s = load_utc_s();
+    if (rtc_checkpoint.magic == CHECKPOINT_MAGIC && rtc_checkpoint.check == checkpoint_check(&rtc_checkpoint) &&
+        sys >= rtc_checkpoint.sys_us)
+        estimate = rtc_checkpoint.utc_us + (sys - rtc_checkpoint.sys_us);
+    else
+        estimate = saved_utc_s * 1000000;
+    if (estimate <= 0)
+        return false;
+
+    struct timeval tv;
+    tv.tv_sec = (time_t)(estimate / 1000000);
+    tv.tv_usec = (suseconds_t)(estimate % 1000000);
+    settimeofday(&tv, nullptr);
+    saved_freq_ppb = load_freq_ppb();
+    int64_t mono = esp_timer_get_time();
+    portENTER_CRITICAL(&clock_lock);
+    clock_discipline_init(&clock_disc, saved_freq_ppb);
+    clock_discipline_seed(&clock_disc, estimate, mono);
+    state = TIME_SYNC_RESTORED;
+    portEXIT_CRITICAL(&clock_lock);
+    return true;
+}
+
+// Both run in the lwIP thread
+static void lookup_found(const char* name, const ip_addr_t* ip, void* arg) {
+    ServerSlot* s = (ServerSlot*)arg;
+    if (ip && IP_IS_V4(ip)) {
+        s->addr = ip4_addr_get_u32(ip_2_ip4(ip));
+        s->lookup = LOOKUP_DONE;
+    } else {
+        s->lookup = LOOKUP_FAILED;
+    }
+}
+
+static void lookup_start(void* arg) {
+    ServerSlot* s = (ServerSlot*)arg;
+    ip_addr_t ip;
+    err_t err = dns_gethostbyname_addrtype(s->name, &ip, lookup_found, s, LWIP_DNS_ADDRTYPE_IPV4);
+    if (err == ERR_OK)
+        lookup_found(s->name, &ip, s); // cached, or a literal address
+    else if (err != ERR_INPROGRESS)
+        s->lookup = LOOKUP_FAILED;
+}
+
+static void drop_peer(int peer) {
+    ntp_client_remove_peer(&ntp, peer);
+    for (int i = 0; i < server_count; ++i) {
+        if (servers[i].peer == peer)
+            servers[i].peer = -1;
+        else if (servers[i].peer > peer)
+            --servers[i].peer;
+    }
+}
+
+// Between rounds: replaces dead peers, adds finished lookups and starts new
+// ones in the lwIP thread, so DNS never stalls the caller
+static void refresh_peers(int64_t now) {
+    for (int i = 0; i < server_count; ++i) {
+        ServerSlot* s = &servers[i];
+        if (s->peer >= 0 && ntp_client_peer_unreachable(&ntp, s->peer))
+            drop_peer(s->peer);
+        if (s->lookup == LOOKUP_DONE) {
+            struct sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(NTP_PORT);
+            addr.sin_addr.s_addr = s->addr;
+            s->peer = (int8_t)ntp_client_add_peer_addr(&ntp, &addr);
+            s->lookup = LOOKUP_IDLE;
+            if (s->peer < 0)
+                s->next_lookup_us = now + (int64_t)TIME_SYNC_LOOKUP_RETRY_MS * 1000;
+        } else if (s->lookup == LOOKUP_FAILED) {
+            s->lookup = LOOKUP_IDLE;
+            s->next_lookup_us = now + (int64_t)TIME_SYNC_LOOKUP_RETRY_MS * 1000;
+        }
+        if (s->peer < 0 && s->lookup == LOOKUP_IDLE && now >= s->next_lookup_us) {
+            s->lookup = LOOKUP_PENDING;
+            if (tcpip_try_callback(lookup_start, s) != ERR_OK) {
+                s->lookup = LOOKUP_IDLE; // lwIP mailbox full
+                s->next_lookup_us = now + (int64_t)TIME_SYNC_ROUND_CHECK_MS * 1000;
+            }
+        }
+    }
+}
+
+// When refresh_peers() next has work: a lookup to collect or one to start
+static int64_t lookup_due_us(int64_t now) {
+    int64_t due = INT64_MAX;
+    for (int i = 0; i < server_count; ++i) {
+        const ServerSlot* s = &servers[i];
+        int64_t t = INT64_MAX;
+        if (s->lookup == LOOKUP_PENDING)
+            t = now + (int64_t)TIME_SYNC_ROUND_CHECK_MS * 1000;
+        else if (s->lookup != LOOKUP_IDLE)
+            return now;
+        else if (s->peer < 0)
+            t = s->next_lookup_us;
+        if (t < due)
+            due = t;
+    }
+    return due;
+}
+
+int time_sync_start(const char* const* names, int count) {
+    if (state == TIME_SYNC_IDLE) {
+        saved_freq_ppb = load_freq_ppb();
+        saved_utc_s = load_utc_s();
+        // gettimeofday() takes a mutex, so both clocks are read before the lock;
+        // a reader that sees the new state then waits for the seeded discipline
+        int64_t sys = system_clock_us(), mono = esp_timer_get_time();
+        portENTER_CRITICAL(&clock_lock);
+        clock_discipline_init(&clock_disc, saved_freq_ppb);
+        clock_discipline_seed(&clock_disc, sys, mono);
+        state = TIME_SYNC_WAITING;
+        portEXIT_CRITICAL(&clock_lock);
+    }
+    if (!ntp_client_init(&ntp, time_sync_now_us))
+        return 0;
+    server_count = (uint8_t)(count < NTP_MAX_PEERS ? count : NTP_MAX_PEERS);
+    for (int i = 0; i < server_count; ++i) {
+        servers[i].name = names[i];
+        servers[i].peer = -1;
+        servers[i].lookup = LOOKUP_IDLE;
+        servers[i].next_lookup_us = 0;
+    }
+    next_poll_us = esp_timer_get_time();
+    ntp_started = true;
+    return server_count;
+}
+
+bool time_sync_has_time() {
+    return state != TIME_SYNC_IDLE && state != TIME_SYNC_WAITING;
+}
+
+bool time_sync_synced() {
+    return sync_count > 0;
+}
+
+void time_sync_checkpoint() {
+    if (!sync_count)
+        return; // only pass on time that a server confirmed
+    TimeCheckpoint c;
+    c.magic = CHECKPOINT_MAGIC;
+    c.utc_us = time_sync_now_us();
+    c.sys_us = system_clock_us();
+    c.check = checkpoint_check(&c);
+    rtc_checkpoint = c;
+}
+
+int64_t time_sync_now_us() {
+    if (state == TIME_SYNC_IDLE)
+        return system_clock_us();
+    int64_t mono = esp_timer_get_time();
+    portENTER_CRITICAL_SAFE(&clock_lock);
+    int64_t now = clock_discipline_now(&clock_disc, mono);
+    portEXIT_CRITICAL_SAFE(&clock_lock);
+    return now;
+}
+
+static void apply(const NtpSolution* s) {
+    int64_t mono = esp_timer_get_time();
+    portENTER_CRITICAL(&clock_lock);
+    clock_discipline_update(&clock_disc, s->offset_us, s->jitter_us, mono);
+    portEXIT_CRITICAL(&clock_lock);
+    ntp_client_clock_adjusted(&ntp, s->offset_us);
+
+    // Keep libc time() close for everything that does not read the
+    // disciplined clock
+    struct timeval tv;
+    int64_t now = time_sync_now_us();
+    tv.tv_sec = (time_t)(now / 1000000);
+    tv.tv_usec = (suseconds_t)(now % 1000000);
+    settimeofday(&tv, nullptr);
+
+    int64_t freq = clock_disc.freq_ppb;
+    if (clock_disc.poll_s >= SETTLED_POLL_S &&
+        (freq - saved_freq_ppb > TIME_SYNC_SAVE_DELTA_PPB || saved_freq_ppb - freq > TIME_SYNC_SAVE_DELTA_PPB) &&
+        (!last_save_us || mono - last_save_us > (int64_t)TIME_SYNC_SAVE_MIN_MS * 1000)) {
+        save_freq_ppb(freq);
+        last_save_us = mono;
+    }
+    // The power-loss lower bound only has to be roughly right: rewritten once
+    // it is a day old, or when it lies ahead of a verified time
+    int64_t utc_s = now / 1000000;
+    if (utc_s - saved_utc_s >= TIME_SYNC_SAVE_TIME_S || utc_s < saved_utc_s)
+        save_utc_s(utc_s);
+    last_solution = *s;
+    last_sync_us = mono;
+    ++sync_count;
+}
+
+TimeSyncState time_sync_poll() {
+    if (!ntp_started)
+        return state;
+    int64_t now = esp_timer_get_time();
+    ntp_client_service(&ntp);
+
+    // A round ends when every peer answered or timed out
+    if (round_open && !ntp_client_busy(&ntp)) {
+        round_open = false;
+        NtpSolution s;
+        if (ntp_client_select(&ntp, &s))
+            apply(&s);
+    }
+    if (!round_open)
+        refresh_peers(now);
+    // A measurement taken mid-slew would see only part of the last correction
+    bool slewing = clock_discipline_slewing(&clock_disc, now);
+    // Until the first lookup lands there is nobody to poll
+    if (!round_open && !slewing && ntp.peer_count && now >= next_poll_us) {
+        ntp_client_poll(&ntp);
+        round_open = true;
+        ++polls;
+        next_poll_us = now + (polls < TIME_SYNC_BURST ? TIME_SYNC_BURST_MS * 1000 : (int64_t)clock_disc.poll_s * 1000000);
+    }
+
+    if (!sync_count)
+        state = state == TIME_SYNC_RESTORED ? TIME_SYNC_RESTORED : TIME_SYNC_WAITING;
+    else if (slewing)
+        state = TIME_SYNC_SLEWING;
+    else if (now - last_sync_us > (int64_t)TIME_SYNC_STALE_MS * 1000)
+        state = TIME_SYNC_STALE;
+    else
+        state = TIME_SYNC_SYNCED;
+    return state;
+}
+
+uint32_t time_sync_wait_ms() {
+    if (!ntp_started)
+        return UINT32_MAX;
+    // Replies wake the caller through the socket; timeouts need a re-check
+    if (round_open)
+        return TIME_SYNC_ROUND_CHECK_MS;
+    int64_t now = esp_timer_get_time();
+    int64_t due = ntp.peer_count ? next_poll_us : INT64_MAX;
+    if (clock_discipline_slewing(&clock_disc, now))
+        due = clock_disc.base_mono_us + clock_disc.slew_len_us;
+    if (sync_count && last_sync_us + (int64_t)TIME_SYNC_STALE_MS * 1000 < due)
+        due = last_sync_us + (int64_t)TIME_SYNC_STALE_MS * 1000;
+    int64_t lookup = lookup_due_us(now); // lookups finish without touching the socket
+    if (lookup < due)
+        due = lookup;
+    if (due <= now)
+        return 0;
+    int64_t ms = (due - now + 999) / 1000;
+    return ms < UINT32_MAX ? (uint32_t)ms : UINT32_MAX;
+}
+
+int time_sync_socket() {
+    return ntp_started ? ntp.sock : -1;
+}
+
+TimeSyncState time_sync_state() {
+    return state;
+}
+
+const char* time_sync_state_name(TimeSyncState s) {
+    switch (s) {
+    case TIME_SYNC_IDLE:
+        return "idle";
+    case TIME_SYNC_RESTORED:
+        return "restored";
+    case TIME_SYNC_WAITING:
+        return "waiting";
+    case TIME_SYNC_SLEWING:
+        return "slewing";
+    case TIME_SYNC_SYNCED:
+        return "synced";
+    case TIME_SYNC_STALE:
+        return "stale";
+    }
+    return "?";
+}
+
+uint32_t time_sync_count() {
+    return sync_count;
+}
+
+int32_t time_sync_freq_ppb() {
+    return (int32_t)clock_disc.freq_ppb;
+}
+
+uint32_t time_sync_poll_s() {
+    return clock_disc.poll_s;
+}
+
+bool time_sync_last_solution(NtpSolution* out) {
+    if (!sync_count)
+        return false;
+    *out = last_solution;
+    return true;
+}
@@ -0,0 +1,66 @@
+// time_sync.h - background multi-server NTP steering a disciplined clock
+#pragma once
+
+#include <stdint.h>
+
+#include "clock_discipline.h"
+#include "ntp_client.h"
+
+enum TimeSyncState : uint8_t {
+    TIME_SYNC_IDLE,     // not started
+    TIME_SYNC_RESTORED, // running from a checkpoint of an earlier run, not verified
+    TIME_SYNC_WAITING,  // no usable solution yet, the clock is not valid
+    TIME_SYNC_SLEWING,  // a phase correction is being spread out
+    TIME_SYNC_SYNCED,
+    TIME_SYNC_STALE,    // no solution for TIME_SYNC_STALE_MS
+};
+
+#define TIME_SYNC_BURST 4           // quick polls at start to fill the filters
+#define TIME_SYNC_BURST_MS 2000UL
+#define TIME_SYNC_STALE_MS (2UL * CLOCK_POLL_MAX_S * 1000UL)
+#define TIME_SYNC_NVS_NAMESPACE "clock"
+#define TIME_SYNC_NVS_FREQ_KEY "freq_ppb"
+#define TIME_SYNC_NVS_TIME_KEY "utc_s"
+#define TIME_SYNC_SAVE_MIN_MS (60UL * 60UL * 1000UL) // limits flash writes
+#define TIME_SYNC_SAVE_DELTA_PPB 100
+#define TIME_SYNC_SAVE_TIME_S (24L * 60L * 60L) // age of the saved lower bound before it is rewritten
+#define TIME_SYNC_ROUND_CHECK_MS 250UL // re-check interval while replies or lookups are due
+#define TIME_SYNC_LOOKUP_RETRY_MS 30000UL // after a failed lookup, or one that gave a server in use
+
+// Restores the clock before the network is up: from the RTC memory
+// checkpoint after a reset (the system clock keeps counting through it), or
+// from the last time saved in NVS after a power loss, which can only be a
+// lower bound. False if neither exists.
+bool time_sync_restore();
+// Starts polling the servers, up to NTP_MAX_PEERS names that must stay
+// valid; returns how many are used. The names are looked up from
+// time_sync_poll() without blocking it, and again whenever one has no peer:
+// its lookup failed, it gave a server another name already has, or its
+// server stopped answering for a full reach register. The drift saved by an
+// earlier run is applied from the start; the first solution steps the clock.
+// May run in another task than time_sync_poll().
+int time_sync_start(const char* const* servers, int count);
+// True once the clock holds a real or restored time
+bool time_sync_has_time();
+// True once a server solution has been applied
+bool time_sync_synced();
+// Saves the disciplined time to RTC memory; cheap, call every second
+void time_sync_checkpoint();
+// Disciplined UTC in microseconds, from esp_timer; follows the system clock
+// until the first solution
+int64_t time_sync_now_us();
+// Services replies, polls peers when due and applies new solutions; never blocks
+TimeSyncState time_sync_poll();
+// Milliseconds until time_sync_poll() has work other than a reply arriving
+// on time_sync_socket(); UINT32_MAX before time_sync_start()
+uint32_t time_sync_wait_ms();
+// The NTP socket, for select(); -1 before time_sync_start()
+int time_sync_socket();
+TimeSyncState time_sync_state();
+const char* time_sync_state_name(TimeSyncState s);
+// Corrections applied since start
+uint32_t time_sync_count();
+int32_t time_sync_freq_ppb();
+uint32_t time_sync_poll_s();
+// Last combined solution; false before the first one
+bool time_sync_last_solution(NtpSolution* out);
@@ -0,0 +1,108 @@
+// tzdb.cpp - read-in-place binary timezone database (see tools/mktzdb.py)
+#include "tzdb.h"
+
+#include <string.h>
+
+#if defined(ESP_PLATFORM)
+#include <esp_idf_version.h>
+#include <esp_partition.h>
+#endif
+
+static const char* db_string(const Tzdb* db, uint32_t off) {
+    return (const char*)db->base + off;
+}
+
+static const TzdbZone* db_zones(const Tzdb* db) {
+    const TzdbHeader* h = (const TzdbHeader*)db->base;
+    return (const TzdbZone*)(db->base + h->zones_off);
+}
+
+bool tzdb_open(Tzdb* db, const void* base, size_t size) {
+    const TzdbHeader* h = (const TzdbHeader*)base;
+    db->base = nullptr;
+    db->size = 0;
+    if (!base || size < sizeof(TzdbHeader) || memcmp(h->magic, "TZDB", 4) != 0 || h->version != TZDB_VERSION)
+        return false;
+    if (h->total_size > size || h->zones_off + (uint64_t)h->zone_count * sizeof(TzdbZone) > h->total_size ||
+        h->strings_off + (uint64_t)h->strings_size != h->total_size ||
+        ((const uint8_t*)base)[h->total_size - 1] != '\0')
+        return false;
+    db->base = (const uint8_t*)base;
+    db->size = h->total_size;
+    db->time_base = h->time_base;
+    return true;
+}
+
+bool tzdb_open_partition(Tzdb* db) {
+#if defined(ESP_PLATFORM)
+    const esp_partition_t* part = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)TZDB_PARTITION_SUBTYPE, TZDB_PARTITION_LABEL);
+    if (!part)
+        return false;
+    const void* ptr;
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    esp_partition_mmap_handle_t handle;
+    if (esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &ptr, &handle) != ESP_OK)
+        return false;
+#else
+    spi_flash_mmap_handle_t handle;
+    if (esp_partition_mmap(part, 0, part->size, SPI_FLASH_MMAP_DATA, &ptr, &handle) != ESP_OK)
+        return false;
+#endif
+    // The mapping stays for the lifetime of the firmware
+    return tzdb_open(db, ptr, part->size);
+#else
+    db->base = nullptr;
+    db->size = 0;
+    return false;
+#endif
+}
+
+const TzdbZone* tzdb_find_zone(const Tzdb* db, const char* name) {
+    if (!db->base)
+        return nullptr;
+    const TzdbHeader* h = (const TzdbHeader*)db->base;
+    const TzdbZone* zones = db_zones(db);
+    int lo = 0, hi = (int)h->zone_count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int c = strcmp(name, db_string(db, zones[mid].name_off));
+        if (c == 0)
+            return &zones[mid];
+        if (c < 0)
+            hi = mid - 1;
+        else
+            lo = mid + 1;
+    }
+    return nullptr;
+}
+
+const char* tzdb_zone_name(const Tzdb* db, const TzdbZone* z) {
+    return db_string(db, z->name_off);
+}
+
+const char* tzdb_zone_posix(const Tzdb* db, const TzdbZone* z) {
+    return db_string(db, z->posix_off);
+}
+
+void tzdb_lookup(const Tzdb* db, const TzdbZone* z, int64_t utc, TzdbOffset* out) {
+    const uint32_t* times = (const uint32_t*)(db->base + z->trans_off);
+    const uint8_t* idx = (const uint8_t*)(times + z->trans_count);
+    const TzdbType* types = (const TzdbType*)(db->base + z->types_off);
+
+    // Number of transitions at or before utc
+    int lo = 0, hi = z->trans_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (db->time_base + times[mid] <= utc)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    const TzdbType* t = &types[lo ? idx[lo - 1] : z->initial_type];
+    out->utoff = t->utoff;
+    out->is_dst = t->is_dst;
+    out->beyond_last = (lo == z->trans_count);
+    out->prev = lo ? db->time_base + times[lo - 1] : INT64_MIN;
+    out->next = out->beyond_last ? INT64_MAX : db->time_base + times[lo];
+}
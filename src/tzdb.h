@@ -0,0 +1,64 @@
+// tzdb.h - read-in-place binary timezone database (see tools/mktzdb.py)
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TZDB_PARTITION_LABEL "tzdb"
+#define TZDB_PARTITION_SUBTYPE 0x40
+#define TZDB_VERSION 2
+
+struct TzdbHeader {
+    char magic[4];          // "TZDB"
+    uint16_t version;
+    uint16_t zone_count;
+    uint32_t zones_off;
+    uint32_t strings_off;
+    uint32_t strings_size;
+    uint32_t total_size;
+    int64_t time_base;      // transition times count from here, covering 136 years
+};
+
+struct TzdbZone {
+    uint32_t name_off;
+    uint32_t posix_off;     // POSIX TZ rule for instants after the last transition
+    uint32_t trans_off;     // uint32_t times[trans_count], then uint8_t type_idx[trans_count]
+    uint32_t types_off;     // TzdbType[type_count]
+    uint16_t trans_count;
+    uint8_t type_count;
+    uint8_t initial_type;   // in force before the first transition
+};
+
+struct TzdbType {
+    int32_t utoff;
+    uint8_t is_dst;
+    uint8_t pad[3];
+};
+
+struct Tzdb {
+    const uint8_t* base;
+    size_t size;
+    int64_t time_base;
+};
+
+// Result of a lookup: the offset holds for prev <= utc < next. `beyond_last`
+// means utc is past the last stored transition and the POSIX rule applies.
+struct TzdbOffset {
+    int32_t utoff;
+    bool is_dst;
+    bool beyond_last;
+    int64_t prev;
+    int64_t next;
+};
+
+// Validates the header of an image that is already mapped; false if malformed
+bool tzdb_open(Tzdb* db, const void* base, size_t size);
+// Maps the "tzdb" flash partition in place, no RAM copy
+bool tzdb_open_partition(Tzdb* db);
+
+// Binary search by IANA name, e.g. "Europe/London"; nullptr if absent
+const TzdbZone* tzdb_find_zone(const Tzdb* db, const char* name);
+const char* tzdb_zone_name(const Tzdb* db, const TzdbZone* z);
+const char* tzdb_zone_posix(const Tzdb* db, const TzdbZone* z);
+// Binary search of the zone's transitions
+void tzdb_lookup(const Tzdb* db, const TzdbZone* z, int64_t utc, TzdbOffset* out);
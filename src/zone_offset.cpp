@@ -0,0 +1,253 @@
+// zone_offset.cpp - UTC to local time for a table of POSIX TZ zones
+#include "zone_offset.h"
+
+#include <ctype.h>
+#include <string.h>
+
+static int64_t floor_div(int64_t a, int64_t b) {
+    return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+}
+
+// Inverse of days_from_civil
+static void civil_from_days(int64_t z, int32_t* y, uint32_t* m, uint32_t* d) {
+    z += 719468;
+    const int64_t era = floor_div(z, 146097);
+    const uint32_t doe = (uint32_t)(z - era * 146097);
+    const uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const uint32_t mp = (5 * doy + 2) / 153;
+    *d = doy - (153 * mp + 2) / 5 + 1;
+    *m = mp < 10 ? mp + 3 : mp - 9;
+    *y = (int32_t)(yoe + era * 400 + (*m <= 2));
+}
+
+// ---- POSIX TZ parsing ----
+
+static const char* parse_name(const char* p) {
+    if (*p == '<') {
+        while (*p && *p != '>')
+            ++p;
+        return *p == '>' ? p + 1 : nullptr;
+    }
+    const char* s = p;
+    while (isalpha((unsigned char)*p))
+        ++p;
+    return (p - s >= 3) ? p : nullptr;
+}
+
+static const char* parse_number(const char* p, int* out, int max) {
+    if (!isdigit((unsigned char)*p))
+        return nullptr;
+    int v = 0;
+    while (isdigit((unsigned char)*p)) {
+        v = v * 10 + (*p++ - '0');
+        if (v > max)
+            return nullptr;
+    }
+    *out = v;
+    return p;
+}
+
+// [+|-]hh[:mm[:ss]] in seconds
+static const char* parse_hms(const char* p, int32_t* out, int max_hours) {
+    int sign = 1;
+    if (*p == '+' || *p == '-')
+        sign = (*p++ == '-') ? -1 : 1;
+    int h = 0, m = 0, s = 0;
+    if (!(p = parse_number(p, &h, max_hours)))
+        return nullptr;
+    if (*p == ':' && !(p = parse_number(p + 1, &m, 59)))
+        return nullptr;
+    if (*p == ':' && !(p = parse_number(p + 1, &s, 59)))
+        return nullptr;
+    *out = sign * (h * 3600 + m * 60 + s);
+    return p;
+}
+
+static const char* parse_dst_rule(const char* p, DstRule* r) {
+    int a, b, c;
+    memset(r, 0, sizeof(*r));
+    if (*p == 'M') {
+        if (!(p = parse_number(p + 1, &a, 12)) || *p != '.' ||
+            !(p = parse_number(p + 1, &b, 5)) || *p != '.' ||
+            !(p = parse_number(p + 1, &c, 6)) || a < 1 || b < 1)
+            return nullptr;
+        r->kind = DST_RULE_MONTH_WEEK_DAY;
+        r->month = a;
+        r->week = b;
+        r->wday = c;
+    } else if (*p == 'J') {
+        if (!(p = parse_number(p + 1, &a, 365)) || a < 1)
+            return nullptr;
+        r->kind = DST_RULE_JULIAN_1;
+        r->yday = a;
+    } else {
+        if (!(p = parse_number(p, &a, 365)))
+            return nullptr;
+        r->kind = DST_RULE_JULIAN_0;
+        r->yday = a;
+    }
+    r->time = 2 * 3600;
+    if (*p == '/' && !(p = parse_hms(p + 1, &r->time, 167)))
+        return nullptr;
+    return p;
+}
+
+bool zone_rule_parse(const char* tz, ZoneRule* out) {
+    const char* p = tz;
+    int32_t off;
+    memset(out, 0, sizeof(*out));
+    if (!p || !(p = parse_name(p)) || !(p = parse_hms(p, &off, 24)))
+        return false;
+    out->std_offset = -off; // POSIX offsets count west of UTC
+    if (!*p)
+        return true;
+
+    if (!(p = parse_name(p)))
+        return false;
+    out->has_dst = true;
+    out->dst_offset = out->std_offset + 3600;
+    if (*p && *p != ',') {
+        if (!(p = parse_hms(p, &off, 24)))
+            return false;
+        out->dst_offset = -off;
+    }
+    if (!*p) {
+        // No rules given: use the current US ones, like glibc
+        out->start = {DST_RULE_MONTH_WEEK_DAY, 3, 2, 0, 0, 7200};
+        out->end = {DST_RULE_MONTH_WEEK_DAY, 11, 1, 0, 0, 7200};
+        return true;
+    }
+    if (*p != ',' || !(p = parse_dst_rule(p + 1, &out->start)) ||
+        *p != ',' || !(p = parse_dst_rule(p + 1, &out->end)))
+        return false;
+    return *p == '\0';
+}
+
+// ---- zone table ----
+
+void zone_table_init(ZoneTable* t) {
+    memset(t, 0, sizeof(*t));
+}
+
+int zone_table_add(ZoneTable* t, const char* tz) {
+    ZoneRule r;
+    if (t->count >= ZONE_TABLE_MAX || !zone_rule_parse(tz, &r))
+        return -1;
+    int i = t->count++;
+    t->std_offset[i] = r.std_offset;
+    t->dst_offset[i] = r.dst_offset;
+    t->has_dst[i] = r.has_dst;
+    t->start[i] = r.start;
+    t->end[i] = r.end;
+    t->prev_transition[i] = INT64_MAX; // forces a refresh on first use
+    t->next_transition[i] = INT64_MIN;
+    t->offset[i] = r.std_offset;
+    t->is_dst[i] = 0;
+    return i;
+}
+
+int zone_table_add_tzdb(ZoneTable* t, const Tzdb* db, const char* name) {
+    const TzdbZone* z = tzdb_find_zone(db, name);
+    if (!z)
+        return -1;
+    int i = zone_table_add(t, tzdb_zone_posix(db, z));
+    if (i < 0) {
+        // No usable footer: keep the offset of the last transition
+        TzdbOffset o;
+        tzdb_lookup(db, z, INT64_MAX, &o);
+        if ((i = zone_table_add(t, "UTC0")) < 0)
+            return -1;
+        t->std_offset[i] = t->offset[i] = o.utoff;
+    }
+    t->tzdb = db;
+    t->tzdb_zone[i] = z;
+    return i;
+}
+
+static void zone_rule_refresh(ZoneTable* t, int i, int64_t utc) {
+    if (!t->has_dst[i]) {
+        t->prev_transition[i] = INT64_MIN;
+        t->next_transition[i] = INT64_MAX;
+        t->offset[i] = t->std_offset[i];
+        t->is_dst[i] = 0;
+        return;
+    }
+
+    int32_t y;
+    uint32_t m, d;
+    civil_from_days(floor_div(utc + t->std_offset[i], 86400), &y, &m, &d);
+
+    // Transitions of the neighbouring years, in order; works for either hemisphere
+    int64_t at[6];
+    bool dst_after[6];
+    int n = 0;
+    for (int32_t year = y - 1; year <= y + 1; ++year) {
+        int64_t start = dst_rule_utc(year, t->start[i], t->std_offset[i]);
+        int64_t end = dst_rule_utc(year, t->end[i], t->dst_offset[i]);
+        bool start_first = start < end;
+        at[n] = start_first ? start : end;
+        dst_after[n++] = start_first;
+        at[n] = start_first ? end : start;
+        dst_after[n++] = !start_first;
+    }
+
+    int k = 0;
+    while (k < n - 1 && at[k + 1] <= utc)
+        ++k;
+    t->prev_transition[i] = at[k];
+    t->next_transition[i] = at[k + 1];
+    t->is_dst[i] = dst_after[k];
+    t->offset[i] = dst_after[k] ? t->dst_offset[i] : t->std_offset[i];
+}
+
+void zone_table_refresh(ZoneTable* t, int i, int64_t utc) {
+    if (!t->tzdb_zone[i]) {
+        zone_rule_refresh(t, i, utc);
+        return;
+    }
+    TzdbOffset o;
+    tzdb_lookup(t->tzdb, t->tzdb_zone[i], utc, &o);
+    if (o.beyond_last) {
+        zone_rule_refresh(t, i, utc);
+        if (t->prev_transition[i] < o.prev)
+            t->prev_transition[i] = o.prev;
+        return;
+    }
+    t->prev_transition[i] = o.prev;
+    t->next_transition[i] = o.next;
+    t->offset[i] = o.utoff;
+    t->is_dst[i] = o.is_dst;
+}
+
+void zone_table_convert_all(ZoneTable* t, int64_t utc, ZoneTime out[]) {
+    for (int i = 0; i < t->count; ++i) {
+        int32_t offset = zone_table_offset(t, i, utc);
+        int64_t local = utc + offset;
+        int32_t secs = (int32_t)(local - floor_div(local, 86400) * 86400);
+        out[i].local = local;
+        out[i].offset = offset;
+        out[i].hour = secs / 3600;
+        out[i].min = (secs / 60) % 60;
+        out[i].sec = secs % 60;
+        out[i].is_dst = t->is_dst[i];
+    }
+}
+
+void zone_local_tm(int64_t local, struct tm* out) {
+    int64_t days = floor_div(local, 86400);
+    int32_t secs = (int32_t)(local - days * 86400);
+    int32_t y;
+    uint32_t m, d;
+    civil_from_days(days, &y, &m, &d);
+
+    memset(out, 0, sizeof(*out));
+    out->tm_sec = secs % 60;
+    out->tm_min = (secs / 60) % 60;
+    out->tm_hour = secs / 3600;
+    out->tm_mday = d;
+    out->tm_mon = m - 1;
+    out->tm_year = y - 1900;
+    out->tm_wday = weekday_from_days(days);
+    out->tm_yday = (int)(days - days_from_civil(y, 1, 1));
+}
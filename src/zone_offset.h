@@ -0,0 +1,136 @@
+// zone_offset.h - UTC to local time for a table of POSIX TZ zones
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#include "tzdb.h"
+
+#ifndef ZONE_TABLE_MAX
+#define ZONE_TABLE_MAX 24
+#endif
+
+enum DstRuleKind : uint8_t {
+    DST_RULE_MONTH_WEEK_DAY, // Mm.w.d
+    DST_RULE_JULIAN_1,       // Jn, 1-365, February 29 never counted
+    DST_RULE_JULIAN_0,       // n, 0-365, February 29 counted
+};
+
+// DST switch in POSIX form: week 1-5 (5 = last) of month 1-12,
+// weekday 0-6 (Sunday = 0), or a day of the year, at `time` seconds
+// after local midnight.
+struct DstRule {
+    uint8_t kind;
+    uint8_t month;
+    uint8_t week;
+    uint8_t wday;
+    uint16_t yday;
+    int32_t time;
+};
+
+struct ZoneRule {
+    int32_t std_offset; // seconds east of UTC
+    int32_t dst_offset;
+    bool has_dst;
+    DstRule start;      // in local standard time
+    DstRule end;        // in local daylight time
+};
+
+// Struct-of-arrays zone table. The offset of zone i is valid for
+// prev_transition[i] <= utc < next_transition[i]. Zones backed by the tz
+// database use its transitions and fall back to their POSIX rule after the
+// last one.
+struct ZoneTable {
+    uint8_t count;
+    const Tzdb* tzdb;
+    const TzdbZone* tzdb_zone[ZONE_TABLE_MAX];
+    int32_t std_offset[ZONE_TABLE_MAX];
+    int32_t dst_offset[ZONE_TABLE_MAX];
+    uint8_t has_dst[ZONE_TABLE_MAX];
+    DstRule start[ZONE_TABLE_MAX];
+    DstRule end[ZONE_TABLE_MAX];
+    int64_t prev_transition[ZONE_TABLE_MAX];
+    int64_t next_transition[ZONE_TABLE_MAX];
+    int32_t offset[ZONE_TABLE_MAX];
+    uint8_t is_dst[ZONE_TABLE_MAX];
+};
+
+struct ZoneTime {
+    int64_t local;      // seconds since 1970-01-01 local time
+    int32_t offset;
+    uint8_t hour, min, sec;
+    uint8_t is_dst;
+};
+
+// Civil calendar <-> day number, March-based years (H. Hinnant's algorithm).
+// Single-return constexpr so built-in rules resolve at compile time.
+constexpr int32_t civil_era(int32_t y) { return (y >= 0 ? y : y - 399) / 400; }
+constexpr uint32_t civil_yoe(int32_t y) { return (uint32_t)(y - civil_era(y) * 400); }
+constexpr uint32_t civil_doy(uint32_t m, uint32_t d) { return (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1; }
+constexpr uint32_t civil_doe(uint32_t yoe, uint32_t doy) { return yoe * 365 + yoe / 4 - yoe / 100 + doy; }
+
+// Days since 1970-01-01
+constexpr int64_t days_from_civil(int32_t y, uint32_t m, uint32_t d) {
+    return (int64_t)civil_era(y - (m <= 2)) * 146097
+           + civil_doe(civil_yoe(y - (m <= 2)), civil_doy(m, d)) - 719468;
+}
+
+constexpr bool is_leap_year(int32_t y) {
+    return y % 4 == 0 && (y % 100 != 0 || y % 400 == 0);
+}
+
+constexpr uint32_t days_in_month(int32_t y, uint32_t m) {
+    return m == 2 ? (is_leap_year(y) ? 29 : 28)
+                  : (m == 4 || m == 6 || m == 9 || m == 11) ? 30 : 31;
+}
+
+// 1970-01-01 was a Thursday
+constexpr uint32_t weekday_from_days(int64_t days) {
+    return (uint32_t)(((days + 4) % 7 + 7) % 7);
+}
+
+constexpr int64_t dst_rule_mwd_day(int32_t year, const DstRule& r) {
+    return r.week == 5
+        ? days_from_civil(year, r.month, days_in_month(year, r.month))
+              - (int64_t)((weekday_from_days(days_from_civil(year, r.month, days_in_month(year, r.month))) + 7 - r.wday) % 7)
+        : days_from_civil(year, r.month, 1)
+              + (int64_t)((r.wday + 7 - weekday_from_days(days_from_civil(year, r.month, 1))) % 7)
+              + 7 * (r.week - 1);
+}
+
+// Day number (days since 1970-01-01) on which the rule fires in `year`
+constexpr int64_t dst_rule_day(int32_t year, const DstRule& r) {
+    return r.kind == DST_RULE_MONTH_WEEK_DAY ? dst_rule_mwd_day(year, r)
+         : r.kind == DST_RULE_JULIAN_1 ? days_from_civil(year, 1, 1) + r.yday - 1 + (is_leap_year(year) && r.yday >= 60)
+         : days_from_civil(year, 1, 1) + r.yday;
+}
+
+// UTC instant of a rule in `year`, given the offset in force just before it
+constexpr int64_t dst_rule_utc(int32_t year, const DstRule& r, int32_t offset_before) {
+    return dst_rule_day(year, r) * 86400 + r.time - offset_before;
+}
+
+// Parses e.g. "EST5EDT,M3.2.0,M11.1.0" or "<+0530>-5:30"; false on syntax errors
+bool zone_rule_parse(const char* tz, ZoneRule* out);
+
+void zone_table_init(ZoneTable* t);
+// Returns the zone index, or -1 if the table is full or `tz` does not parse
+int zone_table_add(ZoneTable* t, const char* tz);
+// Adds an IANA zone, e.g. "Europe/London"; -1 if it is not in the database
+int zone_table_add_tzdb(ZoneTable* t, const Tzdb* db, const char* name);
+// Recomputes the cached offset and transition bracket of zone i around `utc`
+void zone_table_refresh(ZoneTable* t, int i, int64_t utc);
+
+// Steady state is one compare and an add per zone; a refresh only happens
+// when a transition is crossed.
+inline int32_t zone_table_offset(ZoneTable* t, int i, int64_t utc) {
+    if (utc >= t->next_transition[i] || utc < t->prev_transition[i])
+        zone_table_refresh(t, i, utc);
+    return t->offset[i];
+}
+
+// One pass over all zones, no libc time calls
+void zone_table_convert_all(ZoneTable* t, int64_t utc, ZoneTime out[]);
+
+// Broken-down calendar date for a local time from ZoneTime::local
+void zone_local_tm(int64_t local, struct tm* out);
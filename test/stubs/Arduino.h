@@ -0,0 +1,58 @@
+// Arduino.h - host stand-in for the Arduino-ESP32 core, enough for lib/Arduino_GFX
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Print.h"
+#include "fake_esp.h"
+
+#ifndef ESP32
+#define ESP32 1                     // the core defines it, the bus and panel code depends on it
+#endif
+
+#define PROGMEM
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+
+#define SPI_MODE0 0
+#define SPI_MODE1 1
+#define SPI_MODE2 2
+#define SPI_MODE3 3
+
+#define log_e(fmt, ...) fprintf(stderr, "[E] " fmt "\n", ##__VA_ARGS__)
+#define log_w(fmt, ...) fprintf(stderr, "[W] " fmt "\n", ##__VA_ARGS__)
+#define log_i(fmt, ...) ((void)0)
+#define log_d(fmt, ...) ((void)0)
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+class __FlashStringHelper;
+
+class String {
+public:
+    String(const char* s = "") : s_(s) {}
+    unsigned int length() const { return (unsigned int)strlen(s_); }
+    const char* c_str() const { return s_; }
+
+private:
+    const char* s_;
+};
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline uint32_t digitalPinToBitMask(uint8_t pin) { return 1u << (pin & 31); }
+
+// Time passes on the simulated clock, so queued SPI work completes meanwhile
+inline void delay(uint32_t ms) {
+    fake_esp_delay((int64_t)ms * 1000);
+}
+inline unsigned long micros() { return (unsigned long)esp_timer_get_time(); }
+inline unsigned long millis() { return (unsigned long)(esp_timer_get_time() / 1000); }
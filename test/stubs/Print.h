@@ -0,0 +1,17 @@
+// Print.h - host stand-in for the Arduino Print base class
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t n = 0;
+        while (size--)
+            n += write(*buffer++);
+        return n;
+    }
+};
@@ -0,0 +1,4 @@
+// SPI.h - host stand-in, the SPI_MODE constants come with Arduino.h
+#pragma once
+
+#include <Arduino.h>
@@ -0,0 +1,4 @@
+// spi_master.h - host stand-in, see fake_esp.h
+#pragma once
+
+#include "../fake_esp.h"
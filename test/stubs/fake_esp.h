@@ -0,0 +1,419 @@
+// fake_esp.h - simulated ESP-IDF clock, DMA heap and SPI master for host tests
+//
+// Time only moves when the code under test waits (delay, a blocking
+// get_trans_result/polling_end) or when a test calls fake_esp_advance().
+// Queued transactions are laid out back to back on a simulated bus and the
+// device's pre/post callbacks fire as the clock passes their start and end,
+// the way the SPI ISR would.
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERROR_CHECK(x) ((void)(x))
+
+typedef uint32_t TickType_t;
+#define portMAX_DELAY 0xFFFFFFFFu
+
+// ---- heap_caps ----------------------------------------------------------
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+
+#define FAKE_ESP_DMA_BLOCKS 64
+#define FAKE_SPI_LOG 1024
+
+struct FakeSpiRecord {
+    uint16_t cmd;
+    uint32_t addr;
+    uint32_t bits;    // data phase
+    uint32_t flags;   // spi_transaction_t flags
+    uint8_t data[4];  // first data bytes
+    bool queued;      // false: polled
+    bool dma_ok;      // the buffer was DMA capable, or the data went inline
+    int64_t start_us;
+    int64_t end_us;
+};
+
+struct FakeEsp {
+    int64_t now_us;
+
+    struct {
+        uintptr_t start, end;
+    } dma[FAKE_ESP_DMA_BLOCKS];
+
+    // device
+    void (*pre_cb)(void*);
+    void (*post_cb)(void*);
+    int queue_size;
+    uint32_t clock_hz;
+    uint8_t command_bits, address_bits;
+    int64_t bus_free_us;
+
+    // queued transactions not reclaimed yet, oldest first
+    struct {
+        void* trans;
+        int64_t start_us, end_us;
+        uint8_t stage;  // 0 waiting, 1 pre_cb ran, 2 post_cb ran
+    } pending[64];
+    int pending_count;
+    int max_outstanding;
+    int overflows;      // more outstanding than the device queue holds
+    int mixed;          // polled while queued transactions were outstanding
+
+    // polled transaction in progress
+    void* poll_trans;
+    int64_t poll_end_us;
+
+    // time the task spent blocked on the bus
+    int64_t wait_us;
+    int64_t delay_us;
+    int delays_in_flight;  // delay() calls made with queued work outstanding
+
+    FakeSpiRecord log[FAKE_SPI_LOG];
+    uint32_t log_count;  // may exceed FAKE_SPI_LOG, later records are dropped
+};
+
+inline FakeEsp& fake_esp() {
+    static FakeEsp s;
+    return s;
+}
+
+inline int64_t esp_timer_get_time() { return fake_esp().now_us; }
+
+inline void* heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t caps) {
+    size = (size + alignment - 1) / alignment * alignment;
+    void* p = aligned_alloc(alignment, size ? size : alignment);
+    if (p && (caps & MALLOC_CAP_DMA)) {
+        FakeEsp& e = fake_esp();
+        for (int i = 0; i < FAKE_ESP_DMA_BLOCKS; ++i) {
+            if (!e.dma[i].start) {
+                e.dma[i].start = (uintptr_t)p;
+                e.dma[i].end = (uintptr_t)p + size;
+                break;
+            }
+        }
+    }
+    return p;
+}
+
+inline void* heap_caps_malloc(size_t size, uint32_t caps) { return heap_caps_aligned_alloc(4, size, caps); }
+
+inline void heap_caps_free(void* p) {
+    FakeEsp& e = fake_esp();
+    for (int i = 0; i < FAKE_ESP_DMA_BLOCKS; ++i) {
+        if (e.dma[i].start == (uintptr_t)p)
+            e.dma[i].start = e.dma[i].end = 0;
+    }
+    free(p);
+}
+
+// Only memory from heap_caps_*alloc(MALLOC_CAP_DMA) counts, like internal RAM
+// does on the target; stack, static and plain malloc memory stand in for PSRAM
+inline bool esp_ptr_dma_capable(const void* p) {
+    FakeEsp& e = fake_esp();
+    for (int i = 0; i < FAKE_ESP_DMA_BLOCKS; ++i) {
+        if ((uintptr_t)p >= e.dma[i].start && (uintptr_t)p < e.dma[i].end)
+            return true;
+    }
+    return false;
+}
+
+// ---- GPIO ---------------------------------------------------------------
+
+inline uint32_t* fake_gpio_reg(int i) {
+    static uint32_t regs[4];
+    return &regs[i];
+}
+#define GPIO_OUT_W1TS_REG (fake_gpio_reg(0))
+#define GPIO_OUT_W1TC_REG (fake_gpio_reg(1))
+#define GPIO_OUT1_W1TS_REG (fake_gpio_reg(2))
+#define GPIO_OUT1_W1TC_REG (fake_gpio_reg(3))
+
+// ---- spi_master ---------------------------------------------------------
+
+typedef enum { SPI1_HOST = 0, SPI2_HOST = 1, SPI3_HOST = 2 } spi_host_device_t;
+#define SPI_DMA_CH_AUTO 3
+
+#define SPICOMMON_BUSFLAG_MASTER (1 << 0)
+#define SPICOMMON_BUSFLAG_GPIO_PINS (1 << 2)
+#define SPI_DEVICE_HALFDUPLEX (1 << 4)
+
+#define SPI_TRANS_MODE_DIO (1 << 0)
+#define SPI_TRANS_MODE_QIO (1 << 1)
+#define SPI_TRANS_USE_RXDATA (1 << 2)
+#define SPI_TRANS_USE_TXDATA (1 << 3)
+#define SPI_TRANS_MODE_DIOQIO_ADDR (1 << 4)
+#define SPI_TRANS_VARIABLE_CMD (1 << 5)
+#define SPI_TRANS_VARIABLE_ADDR (1 << 6)
+#define SPI_TRANS_VARIABLE_DUMMY (1 << 7)
+#define SPI_TRANS_CS_KEEP_ACTIVE (1 << 8)
+#define SPI_TRANS_MULTILINE_CMD (1 << 9)
+#define SPI_TRANS_MULTILINE_ADDR SPI_TRANS_MODE_DIOQIO_ADDR
+
+struct spi_transaction_t;
+typedef void (*transaction_cb_t)(spi_transaction_t* trans);
+
+// Field order follows IDF 4.4, the bus uses designated initializers
+typedef struct {
+    int mosi_io_num;
+    int miso_io_num;
+    int sclk_io_num;
+    int quadwp_io_num;
+    int quadhd_io_num;
+    int data4_io_num;
+    int data5_io_num;
+    int data6_io_num;
+    int data7_io_num;
+    int max_transfer_sz;
+    uint32_t flags;
+    int intr_flags;
+} spi_bus_config_t;
+
+typedef struct {
+    uint8_t command_bits;
+    uint8_t address_bits;
+    uint8_t dummy_bits;
+    uint8_t mode;
+    uint16_t duty_cycle_pos;
+    uint16_t cs_ena_pretrans;
+    uint8_t cs_ena_posttrans;
+    int clock_speed_hz;
+    int input_delay_ns;
+    int spics_io_num;
+    uint32_t flags;
+    int queue_size;
+    transaction_cb_t pre_cb;
+    transaction_cb_t post_cb;
+} spi_device_interface_config_t;
+
+struct spi_transaction_t {
+    uint32_t flags;
+    uint16_t cmd;
+    uint64_t addr;
+    size_t length;
+    size_t rxlength;
+    void* user;
+    union {
+        const void* tx_buffer;
+        uint8_t tx_data[4];
+    };
+    union {
+        void* rx_buffer;
+        uint8_t rx_data[4];
+    };
+};
+
+typedef struct {
+    struct spi_transaction_t base;
+    uint8_t command_bits;
+    uint8_t address_bits;
+    uint8_t dummy_bits;
+} spi_transaction_ext_t;
+
+typedef FakeEsp* spi_device_handle_t;
+
+#ifndef FAKE_SPI_OVERHEAD_US
+#define FAKE_SPI_OVERHEAD_US 4  // setup and ISR time around each transaction
+#endif
+
+// Resets the clock, the bus and the log; DMA blocks stay registered
+inline void fake_esp_reset() {
+    FakeEsp& e = fake_esp();
+    e.now_us = 0;
+    e.bus_free_us = 0;
+    e.pending_count = 0;
+    e.max_outstanding = 0;
+    e.overflows = 0;
+    e.mixed = 0;
+    e.poll_trans = NULL;
+    e.wait_us = 0;
+    e.delay_us = 0;
+    e.delays_in_flight = 0;
+    e.log_count = 0;
+}
+
+inline int64_t fake_spi_duration_us(const spi_transaction_t* t) {
+    FakeEsp& e = fake_esp();
+    uint32_t data_lines = (t->flags & SPI_TRANS_MODE_QIO) ? 4 : (t->flags & SPI_TRANS_MODE_DIO) ? 2 : 1;
+    uint32_t cmd_lines = (t->flags & SPI_TRANS_MULTILINE_CMD) ? data_lines : 1;
+    uint32_t addr_lines = (t->flags & SPI_TRANS_MULTILINE_ADDR) ? data_lines : 1;
+    uint32_t cmd_bits = e.command_bits, addr_bits = e.address_bits;
+    const spi_transaction_ext_t* x = (const spi_transaction_ext_t*)t;
+    if (t->flags & SPI_TRANS_VARIABLE_CMD)
+        cmd_bits = x->command_bits;
+    if (t->flags & SPI_TRANS_VARIABLE_ADDR)
+        addr_bits = x->address_bits;
+    uint64_t clocks = cmd_bits / cmd_lines + addr_bits / addr_lines + t->length / data_lines;
+    return FAKE_SPI_OVERHEAD_US + (int64_t)(clocks * 1000000 / (e.clock_hz ? e.clock_hz : 80000000));
+}
+
+inline void fake_spi_record(const spi_transaction_t* t, bool queued, int64_t start, int64_t end) {
+    FakeEsp& e = fake_esp();
+    if (e.log_count < FAKE_SPI_LOG) {
+        FakeSpiRecord& r = e.log[e.log_count];
+        const void* buf = (t->flags & SPI_TRANS_USE_TXDATA) ? t->tx_data : t->tx_buffer;
+        r.cmd = t->cmd;
+        r.addr = (uint32_t)t->addr;
+        r.bits = (uint32_t)t->length;
+        r.flags = t->flags;
+        memset(r.data, 0, 4);
+        if (buf && t->length)
+            memcpy(r.data, buf, t->length >= 32 ? 4 : (t->length + 7) / 8);
+        r.queued = queued;
+        r.dma_ok = !t->length || (t->flags & SPI_TRANS_USE_TXDATA) || esp_ptr_dma_capable(t->tx_buffer);
+        r.start_us = start;
+        r.end_us = end;
+    }
+    ++e.log_count;
+}
+
+// Runs the simulated ISR up to `until`: pre/post callbacks of every queued
+// transaction whose start/end falls at or before it, in bus order
+inline void fake_esp_run_until(int64_t until) {
+    FakeEsp& e = fake_esp();
+    for (int i = 0; i < e.pending_count; ++i) {
+        if (e.pending[i].stage == 0 && e.pending[i].start_us <= until) {
+            e.now_us = e.pending[i].start_us > e.now_us ? e.pending[i].start_us : e.now_us;
+            e.pending[i].stage = 1;
+            if (e.pre_cb)
+                e.pre_cb(e.pending[i].trans);
+        }
+        if (e.pending[i].stage == 1 && e.pending[i].end_us <= until) {
+            e.now_us = e.pending[i].end_us > e.now_us ? e.pending[i].end_us : e.now_us;
+            e.pending[i].stage = 2;
+            if (e.post_cb)
+                e.post_cb(e.pending[i].trans);
+        }
+    }
+    if (until > e.now_us)
+        e.now_us = until;
+}
+
+// Lets `us` pass, e.g. the CPU rendering
+inline void fake_esp_advance(int64_t us) { fake_esp_run_until(fake_esp().now_us + us); }
+
+// Advances to the next callback of the queued work; false when there is none
+inline bool fake_esp_step() {
+    FakeEsp& e = fake_esp();
+    for (int i = 0; i < e.pending_count; ++i) {
+        if (e.pending[i].stage < 2) {
+            fake_esp_run_until(e.pending[i].stage ? e.pending[i].end_us : e.pending[i].start_us);
+            return true;
+        }
+    }
+    return false;
+}
+
+inline int fake_spi_outstanding() {
+    FakeEsp& e = fake_esp();
+    int n = 0;
+    for (int i = 0; i < e.pending_count; ++i)
+        n += e.pending[i].stage < 2;
+    return n;
+}
+
+// Bus busy time within [from, to), from the log
+inline int64_t fake_spi_busy_us(int64_t from, int64_t to) {
+    FakeEsp& e = fake_esp();
+    int64_t busy = 0;
+    for (uint32_t i = 0; i < e.log_count && i < FAKE_SPI_LOG; ++i) {
+        int64_t s = e.log[i].start_us > from ? e.log[i].start_us : from;
+        int64_t t = e.log[i].end_us < to ? e.log[i].end_us : to;
+        if (t > s)
+            busy += t - s;
+    }
+    return busy;
+}
+
+inline void fake_esp_delay(int64_t us) {
+    FakeEsp& e = fake_esp();
+    if (fake_spi_outstanding())
+        ++e.delays_in_flight;
+    e.delay_us += us;
+    fake_esp_advance(us);
+}
+
+inline esp_err_t spi_bus_initialize(spi_host_device_t, const spi_bus_config_t*, int) { return ESP_OK; }
+
+inline esp_err_t spi_bus_add_device(spi_host_device_t, const spi_device_interface_config_t* cfg,
+                                    spi_device_handle_t* handle) {
+    FakeEsp& e = fake_esp();
+    e.pre_cb = (void (*)(void*))cfg->pre_cb;
+    e.post_cb = (void (*)(void*))cfg->post_cb;
+    e.queue_size = cfg->queue_size;
+    e.clock_hz = (uint32_t)cfg->clock_speed_hz;
+    e.command_bits = cfg->command_bits;
+    e.address_bits = cfg->address_bits;
+    *handle = &e;
+    return ESP_OK;
+}
+
+inline esp_err_t spi_device_acquire_bus(spi_device_handle_t, TickType_t) { return ESP_OK; }
+inline void spi_device_release_bus(spi_device_handle_t) {}
+
+inline esp_err_t spi_device_queue_trans(spi_device_handle_t h, spi_transaction_t* t, TickType_t) {
+    FakeEsp& e = *h;
+    if (e.pending_count >= e.queue_size)
+        ++e.overflows;
+    if (e.pending_count == (int)(sizeof(e.pending) / sizeof(e.pending[0])))
+        return ESP_FAIL;
+    int64_t start = e.bus_free_us > e.now_us ? e.bus_free_us : e.now_us;
+    int64_t end = start + fake_spi_duration_us(t);
+    e.bus_free_us = end;
+    e.pending[e.pending_count].trans = t;
+    e.pending[e.pending_count].start_us = start;
+    e.pending[e.pending_count].end_us = end;
+    e.pending[e.pending_count].stage = 0;
+    ++e.pending_count;
+    if (e.pending_count > e.max_outstanding)
+        e.max_outstanding = e.pending_count;
+    fake_spi_record(t, true, start, end);
+    fake_esp_run_until(e.now_us);
+    return ESP_OK;
+}
+
+inline esp_err_t spi_device_get_trans_result(spi_device_handle_t h, spi_transaction_t** out, TickType_t) {
+    FakeEsp& e = *h;
+    if (!e.pending_count)
+        return ESP_FAIL;
+    if (e.pending[0].end_us > e.now_us) {
+        e.wait_us += e.pending[0].end_us - e.now_us;
+        fake_esp_run_until(e.pending[0].end_us);
+    }
+    *out = (spi_transaction_t*)e.pending[0].trans;
+    --e.pending_count;
+    memmove(&e.pending[0], &e.pending[1], e.pending_count * sizeof(e.pending[0]));
+    return ESP_OK;
+}
+
+inline esp_err_t spi_device_polling_start(spi_device_handle_t h, spi_transaction_t* t, TickType_t) {
+    FakeEsp& e = *h;
+    if (e.pending_count)
+        ++e.mixed;
+    int64_t start = e.bus_free_us > e.now_us ? e.bus_free_us : e.now_us;
+    e.poll_trans = t;
+    e.poll_end_us = start + fake_spi_duration_us(t);
+    e.bus_free_us = e.poll_end_us;
+    fake_spi_record(t, false, start, e.poll_end_us);
+    return ESP_OK;
+}
+
+inline esp_err_t spi_device_polling_end(spi_device_handle_t h, TickType_t) {
+    FakeEsp& e = *h;
+    if (e.poll_end_us > e.now_us) {
+        e.wait_us += e.poll_end_us - e.now_us;
+        fake_esp_run_until(e.poll_end_us);
+    }
+    e.poll_trans = NULL;
+    return ESP_OK;
+}
@@ -0,0 +1,14 @@
+// gfx_host.h - builds the lib/Arduino_GFX pieces the tests drive into the test itself
+//
+// Only one test file includes it, so the library sources can be pulled in
+// directly instead of linking the library for the host.
+#pragma once
+
+#include <Arduino.h>
+
+#include "Arduino_DataBus.cpp"
+#include "Arduino_G.cpp"
+#include "Arduino_GFX.cpp"
+#include "Arduino_TFT.cpp"
+#include "databus/Arduino_ESP32QSPI.cpp"
+#include "display/Arduino_NV3041A.cpp"
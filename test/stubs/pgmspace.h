@@ -0,0 +1,2 @@
+// pgmspace.h - host stand-in, flash and RAM share one address space
+#pragma once
@@ -0,0 +1,290 @@
+// test_batch_commands - batchOperation() tables compiled into queued commands
+//
+// compileBatchCommands() output is decoded back and compared with a plain
+// walk of the same table, driving it the way batchOperation() does: compile
+// a run, otherwise run the one operation it stopped at. Then the QSPI bus
+// runs the tables on the simulated SPI host and the log is decoded the same
+// way, including the wait at each DELAY.
+#include <gfx_host.h>
+#include <unity.h>
+
+#define MAX_STEPS 512
+
+// One register write, or the table position of an operation that is not one
+struct Step {
+    bool is_cmd;
+    panel_command_t cmd;
+    size_t pos;
+};
+
+struct Steps {
+    Step s[MAX_STEPS];
+    int n;
+    int runs;                       // compile calls that returned commands
+    int longest;                    // most commands from one call
+};
+
+static size_t op_size(const uint8_t* ops, size_t i) {
+    switch (ops[i]) {
+    case WRITE_COMMAND_8:
+    case WRITE_DATA_8:
+    case DELAY:
+        return 2;
+    case WRITE_COMMAND_16:
+    case WRITE_DATA_16:
+    case WRITE_C8_D8:
+        return 3;
+    case WRITE_C8_D16:
+        return 4;
+    case WRITE_BYTES:
+        return 2 + ops[i + 1];
+    case WRITE_C8_BYTES:
+        return 3 + ops[i + 2];
+    default:
+        return 1;
+    }
+}
+
+static void add_cmd(Steps* out, uint8_t c, const uint8_t* data, uint8_t len) {
+    TEST_ASSERT_LESS_THAN(MAX_STEPS, out->n);
+    Step* s = &out->s[out->n++];
+    memset(s, 0, sizeof(*s));
+    s->is_cmd = true;
+    s->cmd.cmd = c;
+    s->cmd.len = len;
+    memcpy(s->cmd.data, data, len);
+}
+
+static void add_other(Steps* out, size_t pos) {
+    TEST_ASSERT_LESS_THAN(MAX_STEPS, out->n);
+    Step* s = &out->s[out->n++];
+    memset(s, 0, sizeof(*s));
+    s->pos = pos;
+}
+
+// What the table means, one operation at a time
+static void walk(const uint8_t* ops, size_t len, Steps* out) {
+    memset(out, 0, sizeof(*out));
+    for (size_t i = 0; i < len; i += op_size(ops, i)) {
+        switch (ops[i]) {
+        case WRITE_COMMAND_8:
+            add_cmd(out, ops[i + 1], nullptr, 0);
+            break;
+        case WRITE_C8_D8:
+            add_cmd(out, ops[i + 1], ops + i + 2, 1);
+            break;
+        case WRITE_C8_D16:
+            add_cmd(out, ops[i + 1], ops + i + 2, 2);
+            break;
+        case WRITE_C8_BYTES:
+            if (ops[i + 2] <= 4) {
+                add_cmd(out, ops[i + 1], ops + i + 3, ops[i + 2]);
+                break;
+            }
+            /* fall through */
+        default:
+            add_other(out, i);
+            break;
+        }
+    }
+}
+
+// The same table through compileBatchCommands(), max commands per call
+static void compile(const uint8_t* ops, size_t len, uint8_t max, Steps* out) {
+    memset(out, 0, sizeof(*out));
+    panel_command_t cmds[ESP32QSPI_BATCH_COMMANDS];
+    size_t i = 0;
+    while (i < len) {
+        size_t start = i;
+        uint8_t n = compileBatchCommands(ops, len, &i, cmds, max);
+        TEST_ASSERT_LESS_OR_EQUAL(max, n);
+        if (n) {
+            TEST_ASSERT_TRUE(i > start && i <= len);
+            for (uint8_t k = 0; k < n; ++k)
+                add_cmd(out, cmds[k].cmd, cmds[k].data, cmds[k].len);
+            ++out->runs;
+            if (n > out->longest)
+                out->longest = n;
+            continue;
+        }
+        TEST_ASSERT_EQUAL(start, i);
+        add_other(out, i);
+        i += op_size(ops, i);
+    }
+}
+
+static void assert_same(const Steps* want, const Steps* got) {
+    TEST_ASSERT_EQUAL(want->n, got->n);
+    for (int k = 0; k < want->n; ++k) {
+        char msg[48];
+        snprintf(msg, sizeof(msg), "step %d", k);
+        const Step* a = &want->s[k];
+        const Step* b = &got->s[k];
+        TEST_ASSERT_EQUAL_MESSAGE(a->is_cmd, b->is_cmd, msg);
+        if (!a->is_cmd) {
+            TEST_ASSERT_EQUAL_MESSAGE(a->pos, b->pos, msg);
+            continue;
+        }
+        TEST_ASSERT_EQUAL_HEX8_MESSAGE(a->cmd.cmd, b->cmd.cmd, msg);
+        TEST_ASSERT_EQUAL_MESSAGE(a->cmd.len, b->cmd.len, msg);
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE(a->cmd.data, b->cmd.data, a->cmd.len, msg);
+    }
+}
+
+static void round_trip(const uint8_t* ops, size_t len, uint8_t max, Steps* got) {
+    static Steps want;
+    walk(ops, len, &want);
+    compile(ops, len, max, got);
+    assert_same(&want, got);
+}
+
+// Register writes of every compiled shape, with a DELAY in the middle
+static const uint8_t mixed_ops[] = {
+    BEGIN_WRITE,
+    WRITE_COMMAND_8, 0x11,
+    WRITE_C8_D8, 0xFF, 0xA5,
+    WRITE_C8_D16, 0x36, 0x12, 0x34,
+    WRITE_C8_BYTES, 0x2A, 4, 0x00, 0x00, 0x01, 0xDF,
+    WRITE_C8_BYTES, 0x2B, 1, 0x7E,
+    WRITE_C8_BYTES, 0x2C, 0,
+    END_WRITE,
+    DELAY, 120,
+    BEGIN_WRITE,
+    WRITE_C8_D8, 0x3A, 0x55,
+    WRITE_C8_BYTES, 0xE0, 5, 1, 2, 3, 4, 5, // too long to compile
+    WRITE_C8_D8, 0x29, 0x00,
+    WRITE_DATA_8, 0x42,
+    WRITE_COMMAND_16, 0x12, 0x34,
+    WRITE_C8_D8, 0x35, 0x00,
+    END_WRITE,
+};
+
+void setUp() {
+    fake_esp_reset();
+}
+
+void tearDown() {}
+
+void test_mixed_table_round_trip() {
+    static Steps got;
+    round_trip(mixed_ops, sizeof(mixed_ops), ESP32QSPI_BATCH_COMMANDS, &got);
+    // 6 compiled up to END_WRITE, then 1, 1 and 1 between the stops
+    TEST_ASSERT_EQUAL(4, got.runs);
+    TEST_ASSERT_EQUAL(6, got.longest);
+}
+
+// The DELAY is never folded into a run: the commands before it are one
+// run, those after it start another
+void test_delay_splits_runs() {
+    static const uint8_t ops[] = {
+        WRITE_C8_D8, 0x01, 1, WRITE_C8_D8, 0x02, 2, WRITE_C8_D8, 0x03, 3,
+        DELAY, 10,
+        DELAY, 20,
+        WRITE_C8_D8, 0x04, 4, WRITE_C8_D8, 0x05, 5,
+    };
+    static Steps got;
+    round_trip(ops, sizeof(ops), ESP32QSPI_BATCH_COMMANDS, &got);
+    TEST_ASSERT_EQUAL(7, got.n);
+    TEST_ASSERT_FALSE(got.s[3].is_cmd);
+    TEST_ASSERT_EQUAL(9, got.s[3].pos);
+    TEST_ASSERT_FALSE(got.s[4].is_cmd);
+    TEST_ASSERT_EQUAL(11, got.s[4].pos);
+    TEST_ASSERT_EQUAL(2, got.runs);
+    TEST_ASSERT_EQUAL(3, got.longest);
+}
+
+// A run longer than the command array is split into full calls, in order
+void test_long_runs_split() {
+    static uint8_t ops[3 * 50];
+    for (int k = 0; k < 50; ++k) {
+        ops[3 * k] = WRITE_C8_D8;
+        ops[3 * k + 1] = (uint8_t)(0x80 + k);
+        ops[3 * k + 2] = (uint8_t)k;
+    }
+    static Steps got;
+    round_trip(ops, sizeof(ops), ESP32QSPI_BATCH_COMMANDS, &got);
+    TEST_ASSERT_EQUAL(50, got.n);
+    TEST_ASSERT_EQUAL((50 + ESP32QSPI_BATCH_COMMANDS - 1) / ESP32QSPI_BATCH_COMMANDS, got.runs);
+    TEST_ASSERT_EQUAL(ESP32QSPI_BATCH_COMMANDS, got.longest);
+    for (uint8_t max = 1; max <= 7; ++max) {
+        round_trip(ops, sizeof(ops), max, &got);
+        TEST_ASSERT_EQUAL((50 + max - 1) / max, got.runs);
+    }
+}
+
+// The panel's real init table, at every array size
+void test_nv3041a_init_round_trip() {
+    static Steps got;
+    for (uint8_t max = 1; max <= ESP32QSPI_BATCH_COMMANDS; ++max)
+        round_trip(nv3041a_init_operations, sizeof(nv3041a_init_operations), max, &got);
+    TEST_ASSERT_GREATER_THAN(ESP32QSPI_BATCH_COMMANDS, got.n); // long runs in it
+    TEST_ASSERT_EQUAL(ESP32QSPI_BATCH_COMMANDS, got.longest);
+}
+
+// A table cut inside an operation compiles up to it and reads nothing past len
+void test_truncated_tables() {
+    static const uint8_t ops[] = {
+        WRITE_C8_D8, 0x01, 1, WRITE_C8_D16, 0x02, 2, 3, WRITE_C8_BYTES, 0x03, 3, 7, 8, 9,
+    };
+    static const size_t cuts[] = {1, 2, 4, 5, 6, 8, 9, 10, 11, 12};
+    static const uint8_t compiled[] = {0, 0, 1, 1, 1, 2, 2, 2, 2, 2};
+    for (size_t k = 0; k < sizeof(cuts) / sizeof(cuts[0]); ++k) {
+        uint8_t* copy = (uint8_t*)malloc(cuts[k]); // a read past the cut is an overflow here
+        memcpy(copy, ops, cuts[k]);
+        panel_command_t cmds[ESP32QSPI_BATCH_COMMANDS];
+        size_t i = 0;
+        uint8_t n = compileBatchCommands(copy, cuts[k], &i, cmds, ESP32QSPI_BATCH_COMMANDS);
+        char msg[32];
+        snprintf(msg, sizeof(msg), "cut at %u", (unsigned)cuts[k]);
+        TEST_ASSERT_EQUAL_MESSAGE(compiled[k], n, msg);
+        TEST_ASSERT_EQUAL_MESSAGE(n == 0 ? 0 : n == 1 ? 3 : 7, i, msg);
+        free(copy);
+    }
+}
+
+// The table on the bus: the queued transactions decode back to the compiled
+// commands, and each DELAY waits for the wire before it starts counting
+void test_bus_runs_table() {
+    Arduino_ESP32QSPI bus(45, 47, 21, 48, 40, 39);
+    TEST_ASSERT_TRUE(bus.begin());
+    while (fake_spi_outstanding())
+        fake_esp_step();
+    static const uint8_t ops[] = {
+        WRITE_C8_D8, 0x01, 1, WRITE_C8_D16, 0x02, 2, 3, WRITE_COMMAND_8, 0x03,
+        DELAY, 120,
+        WRITE_C8_BYTES, 0x04, 4, 9, 8, 7, 6,
+    };
+    static Steps want;
+    walk(ops, sizeof(ops), &want);
+    int from = fake_esp().log_count;
+    int64_t start = esp_timer_get_time();
+    bus.batchOperation(ops, sizeof(ops));
+    while (fake_spi_outstanding())
+        fake_esp_step();
+    TEST_ASSERT_EQUAL(0, fake_esp().delays_in_flight);
+    TEST_ASSERT_EQUAL(0, fake_esp().overflows);
+    TEST_ASSERT_EQUAL(4, fake_esp().log_count - from);
+    int w = 0;
+    for (int k = 0; k < 4; ++k, ++w) {
+        while (!want.s[w].is_cmd)
+            ++w;
+        const FakeSpiRecord& r = fake_esp().log[from + k];
+        TEST_ASSERT_TRUE(r.queued);
+        TEST_ASSERT_EQUAL_HEX32((uint32_t)want.s[w].cmd.cmd << 8, r.addr);
+        TEST_ASSERT_EQUAL(want.s[w].cmd.len * 8, r.bits);
+        TEST_ASSERT_EQUAL_MEMORY(want.s[w].cmd.data, r.data, want.s[w].cmd.len);
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL(fake_esp().log[from + 2].end_us + 120000, fake_esp().log[from + 3].start_us);
+    TEST_ASSERT_LESS_THAN(start + 121000, fake_esp().log[from + 3].start_us);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_mixed_table_round_trip);
+    RUN_TEST(test_delay_splits_runs);
+    RUN_TEST(test_long_runs_split);
+    RUN_TEST(test_nv3041a_init_round_trip);
+    RUN_TEST(test_truncated_tables);
+    RUN_TEST(test_bus_runs_table);
+    return UNITY_END();
+}
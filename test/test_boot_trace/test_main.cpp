@@ -0,0 +1,346 @@
+// test_boot_trace - the trace and summary encoders produce valid JSON
+//
+// A small strict JSON parser checks every document and collects the decoded
+// "name" values, so escaping is checked by round trip rather than by
+// comparing text.
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <unity.h>
+
+#include "boot_trace.h"
+
+struct Json {
+    const char* p;
+    const char* end;
+    std::vector<std::string> names;     // values of "name" keys, decoded
+    std::vector<std::string> keys;      // every key, decoded
+    int objects;
+};
+
+static bool parse_value(Json* j);
+
+static void skip_ws(Json* j) {
+    while (j->p < j->end && (*j->p == ' ' || *j->p == '\n' || *j->p == '\r' || *j->p == '\t'))
+        ++j->p;
+}
+
+static bool parse_string(Json* j, std::string* out) {
+    if (j->p >= j->end || *j->p != '"')
+        return false;
+    for (++j->p; j->p < j->end; ++j->p) {
+        unsigned char c = (unsigned char)*j->p;
+        if (c == '"') {
+            ++j->p;
+            return true;
+        }
+        if (c < 0x20)
+            return false; // control characters must be escaped
+        if (c != '\\') {
+            out->push_back((char)c);
+            continue;
+        }
+        if (++j->p >= j->end)
+            return false;
+        switch (*j->p) {
+        case '"': out->push_back('"'); break;
+        case '\\': out->push_back('\\'); break;
+        case '/': out->push_back('/'); break;
+        case 'b': out->push_back('\b'); break;
+        case 'f': out->push_back('\f'); break;
+        case 'n': out->push_back('\n'); break;
+        case 'r': out->push_back('\r'); break;
+        case 't': out->push_back('\t'); break;
+        case 'u': {
+            unsigned v = 0;
+            for (int k = 0; k < 4; ++k) {
+                if (++j->p >= j->end)
+                    return false;
+                char h = *j->p;
+                v <<= 4;
+                if (h >= '0' && h <= '9') v |= h - '0';
+                else if (h >= 'a' && h <= 'f') v |= h - 'a' + 10;
+                else if (h >= 'A' && h <= 'F') v |= h - 'A' + 10;
+                else return false;
+            }
+            if (v >= 0x80)
+                return false; // the encoder only escapes ASCII
+            out->push_back((char)v);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+static bool parse_number(Json* j) {
+    const char* start = j->p;
+    if (j->p < j->end && *j->p == '-')
+        ++j->p;
+    if (j->p >= j->end || *j->p < '0' || *j->p > '9')
+        return false;
+    if (*j->p == '0' && j->p + 1 < j->end && j->p[1] >= '0' && j->p[1] <= '9')
+        return false; // no leading zeros
+    while (j->p < j->end && *j->p >= '0' && *j->p <= '9')
+        ++j->p;
+    return j->p > start;
+}
+
+static bool parse_object(Json* j) {
+    ++j->p;
+    ++j->objects;
+    skip_ws(j);
+    if (j->p < j->end && *j->p == '}') {
+        ++j->p;
+        return true;
+    }
+    for (;;) {
+        std::string key;
+        skip_ws(j);
+        if (!parse_string(j, &key))
+            return false;
+        j->keys.push_back(key);
+        skip_ws(j);
+        if (j->p >= j->end || *j->p++ != ':')
+            return false;
+        skip_ws(j);
+        if (key == "name" && j->p < j->end && *j->p == '"') {
+            std::string v;
+            if (!parse_string(j, &v))
+                return false;
+            j->names.push_back(v);
+        } else if (!parse_value(j)) {
+            return false;
+        }
+        skip_ws(j);
+        if (j->p >= j->end)
+            return false;
+        if (*j->p == '}') {
+            ++j->p;
+            return true;
+        }
+        if (*j->p++ != ',')
+            return false;
+    }
+}
+
+static bool parse_array(Json* j) {
+    ++j->p;
+    skip_ws(j);
+    if (j->p < j->end && *j->p == ']') {
+        ++j->p;
+        return true;
+    }
+    for (;;) {
+        skip_ws(j);
+        if (!parse_value(j))
+            return false;
+        skip_ws(j);
+        if (j->p >= j->end)
+            return false;
+        if (*j->p == ']') {
+            ++j->p;
+            return true;
+        }
+        if (*j->p++ != ',')
+            return false;
+    }
+}
+
+static bool parse_value(Json* j) {
+    skip_ws(j);
+    if (j->p >= j->end)
+        return false;
+    std::string ignored;
+    switch (*j->p) {
+    case '{': return parse_object(j);
+    case '[': return parse_array(j);
+    case '"': return parse_string(j, &ignored);
+    default: return parse_number(j);
+    }
+}
+
+static bool parse(const std::string& doc, Json* j) {
+    j->p = doc.data();
+    j->end = doc.data() + doc.size();
+    j->objects = 0;
+    if (!parse_value(j))
+        return false;
+    skip_ws(j);
+    return j->p == j->end;
+}
+
+static void collect(const char* s, size_t len, void* ctx) {
+    ((std::string*)ctx)->append(s, len);
+}
+
+static std::string trace_json(const BootTraceEvent* events, int count) {
+    std::string doc;
+    boot_trace_write_json(events, count, collect, &doc);
+    return doc;
+}
+
+static BootTraceEvent event(const char* name, uint8_t phase, int64_t ts) {
+    BootTraceEvent e;
+    e.ts_us = ts;
+    e.name = name;
+    e.phase = phase;
+    e.tid = 1;
+    return e;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_trace_is_valid_json() {
+    BootTraceEvent ev[] = {
+        event("reset", BOOT_TRACE_INSTANT, 0),
+        event("wifi_assoc", BOOT_TRACE_BEGIN, 1200),
+        event("wifi_assoc", BOOT_TRACE_END, 843000),
+        event("dhcp", BOOT_TRACE_BEGIN, 843100),
+        event("dhcp", BOOT_TRACE_END, 1290000),
+    };
+    std::string doc = trace_json(ev, 5);
+    Json j;
+    TEST_ASSERT_TRUE_MESSAGE(parse(doc, &j), doc.c_str());
+    TEST_ASSERT_EQUAL(6, j.objects);
+    TEST_ASSERT_EQUAL(5, (int)j.names.size());
+    TEST_ASSERT_EQUAL_STRING("wifi_assoc", j.names[2].c_str());
+    TEST_ASSERT_TRUE(doc.find("\"ts\":843000") != std::string::npos);
+
+    std::string empty = trace_json(ev, 0);
+    TEST_ASSERT_TRUE_MESSAGE(parse(empty, &j), empty.c_str());
+}
+
+void test_names_are_escaped() {
+    const char* names[] = {"say \"hi\"", "C:\\boot\\", "tab\there", "line\nbreak", "bell\x07", "\x1f"};
+    int n = sizeof(names) / sizeof(names[0]);
+    BootTraceEvent ev[8];
+    for (int i = 0; i < n; ++i)
+        ev[i] = event(names[i], BOOT_TRACE_INSTANT, i * 1000);
+    Json j;
+    std::string doc = trace_json(ev, n);
+    TEST_ASSERT_TRUE_MESSAGE(parse(doc, &j), doc.c_str());
+    TEST_ASSERT_EQUAL(n, (int)j.names.size());
+    for (int i = 0; i < n; ++i)
+        TEST_ASSERT_EQUAL_STRING(names[i], j.names[i].c_str());
+
+    char buf[512];
+    size_t len = boot_trace_summary_json(ev, n, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL(strlen(buf), len);
+    Json s;
+    TEST_ASSERT_TRUE_MESSAGE(parse(buf, &s), buf);
+    TEST_ASSERT_EQUAL(n, (int)s.keys.size());
+    for (int i = 0; i < n; ++i)
+        TEST_ASSERT_EQUAL_STRING(names[i], s.keys[i].c_str());
+}
+
+// A name longer than the encode buffer is cut between characters, never
+// inside an escape sequence
+void test_long_names_stay_valid() {
+    char name[200];
+    for (int i = 0; i < (int)sizeof(name) - 1; ++i)
+        name[i] = i % 3 == 0 ? '"' : i % 3 == 1 ? '\x01' : 'x';
+    name[sizeof(name) - 1] = '\0';
+    for (int shift = 0; shift < 3; ++shift) {
+        BootTraceEvent ev[2] = {event(name + shift, BOOT_TRACE_BEGIN, 10), event(name + shift, BOOT_TRACE_END, 5010)};
+        Json j;
+        std::string doc = trace_json(ev, 2);
+        TEST_ASSERT_TRUE_MESSAGE(parse(doc, &j), doc.c_str());
+        TEST_ASSERT_EQUAL(2, (int)j.names.size());
+        TEST_ASSERT_GREATER_THAN(0, (int)j.names[0].size());
+        TEST_ASSERT_EQUAL(0, strncmp(name + shift, j.names[0].c_str(), j.names[0].size()));
+
+        char buf[256];
+        boot_trace_summary_json(ev, 2, buf, sizeof(buf));
+        Json s;
+        TEST_ASSERT_TRUE_MESSAGE(parse(buf, &s), buf);
+    }
+}
+
+// Durations of closed pairs, times of instants, open phases left out
+void test_summary_pairs_phases() {
+    BootTraceEvent ev[] = {
+        event("boot", BOOT_TRACE_BEGIN, 0),
+        event("wifi", BOOT_TRACE_BEGIN, 1000),
+        event("lvgl_first_frame", BOOT_TRACE_INSTANT, 350000),
+        event("wifi", BOOT_TRACE_END, 901000),
+    };
+    char buf[128];
+    size_t len = boot_trace_summary_json(ev, 4, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("{\"wifi\":900,\"lvgl_first_frame\":350}", buf);
+    TEST_ASSERT_EQUAL(strlen(buf), len);
+}
+
+// A summary that does not fit returns the length it needs and leaves a
+// terminated prefix of it
+void test_summary_truncates() {
+    BootTraceEvent ev[] = {
+        event("wifi_assoc", BOOT_TRACE_BEGIN, 0),
+        event("wifi_assoc", BOOT_TRACE_END, 800000),
+        event("mqtt_connect", BOOT_TRACE_BEGIN, 900000),
+        event("mqtt_connect", BOOT_TRACE_END, 1500000),
+    };
+    char full[128];
+    size_t need = boot_trace_summary_json(ev, 4, full, sizeof(full));
+    for (size_t len = 0; len <= need + 1; ++len) {
+        char buf[128];
+        memset(buf, '#', sizeof(buf));
+        TEST_ASSERT_EQUAL(need, boot_trace_summary_json(ev, 4, buf, len));
+        if (!len) {
+            TEST_ASSERT_EQUAL('#', buf[0]); // nothing written
+            continue;
+        }
+        size_t kept = len - 1 < need ? len - 1 : need;
+        TEST_ASSERT_EQUAL(kept, strlen(buf));
+        TEST_ASSERT_EQUAL(0, strncmp(full, buf, kept));
+    }
+}
+
+// The recorder keeps the first BOOT_TRACE_MAX_EVENTS events and drops the
+// rest; what it kept still encodes to a valid trace
+void test_recorder_drops_past_capacity() {
+    static char names[BOOT_TRACE_MAX_EVENTS + 8][16];
+    for (int i = 0; i < BOOT_TRACE_MAX_EVENTS + 8; ++i) {
+        snprintf(names[i], sizeof(names[i]), "phase_%d", i);
+        if (i & 1)
+            boot_trace_end(names[i - 1]);
+        else
+            boot_trace_begin(names[i]);
+        TEST_ASSERT_EQUAL(i < BOOT_TRACE_MAX_EVENTS ? i + 1 : BOOT_TRACE_MAX_EVENTS, boot_trace_count());
+    }
+    boot_trace_instant_at("late", 123);
+    TEST_ASSERT_EQUAL(BOOT_TRACE_MAX_EVENTS, boot_trace_count());
+
+    const BootTraceEvent* ev = boot_trace_events();
+    TEST_ASSERT_EQUAL_STRING("phase_0", ev[0].name);
+    TEST_ASSERT_EQUAL_STRING(names[BOOT_TRACE_MAX_EVENTS - 2], ev[BOOT_TRACE_MAX_EVENTS - 1].name);
+    TEST_ASSERT_EQUAL(BOOT_TRACE_END, ev[BOOT_TRACE_MAX_EVENTS - 1].phase);
+    for (int i = 1; i < BOOT_TRACE_MAX_EVENTS; ++i)
+        TEST_ASSERT_TRUE(ev[i].ts_us >= ev[i - 1].ts_us);
+
+    Json j;
+    std::string doc = trace_json(ev, boot_trace_count());
+    TEST_ASSERT_TRUE(parse(doc, &j));
+    TEST_ASSERT_EQUAL(BOOT_TRACE_MAX_EVENTS, (int)j.names.size());
+    char buf[2048];
+    size_t len = boot_trace_summary_json(ev, boot_trace_count(), buf, sizeof(buf));
+    TEST_ASSERT_LESS_THAN(sizeof(buf), len);
+    Json s;
+    TEST_ASSERT_TRUE_MESSAGE(parse(buf, &s), buf);
+    TEST_ASSERT_EQUAL(BOOT_TRACE_MAX_EVENTS / 2, (int)s.keys.size());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_trace_is_valid_json);
+    RUN_TEST(test_names_are_escaped);
+    RUN_TEST(test_long_names_stay_valid);
+    RUN_TEST(test_summary_pairs_phases);
+    RUN_TEST(test_summary_truncates);
+    RUN_TEST(test_recorder_drops_past_capacity); // fills the recorder for good, keep last
+    return UNITY_END();
+}
@@ -0,0 +1,184 @@
+// test_clock_discipline - the PLL/FLL against a simulated drifting oscillator
+//
+// The monotonic clock runs off by a fixed rate from UTC, and each poll
+// measures the offset with uniform jitter, as an NTP exchange would. The
+// discipline has to learn the rate, lengthen its poll interval to the
+// maximum, and keep the phase error within a few jitters between polls.
+#include <stdio.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include "clock_discipline.h"
+
+#define UTC_EPOCH_US 1750000000000000LL
+#define UPDATES 300
+#define SETTLED 100                 // updates at the end that must be settled
+#define SAMPLES 16                  // phase error samples between two polls
+
+struct Oscillator {
+    int64_t error_ppb;              // UTC rate minus the monotonic clock's
+    int64_t jitter_us;
+    uint32_t rng;
+};
+
+static int64_t true_utc(const Oscillator& osc, int64_t mono_us) {
+    return UTC_EPOCH_US + mono_us + mono_us * osc.error_ppb / 1000000000;
+}
+
+static int64_t noise(Oscillator& osc) {
+    osc.rng ^= osc.rng << 13;
+    osc.rng ^= osc.rng >> 17;
+    osc.rng ^= osc.rng << 5;
+    return (int64_t)(osc.rng % (uint32_t)(2 * osc.jitter_us + 1)) - osc.jitter_us;
+}
+
+static int64_t phase_error(const Oscillator& osc, const ClockDiscipline& d, int64_t mono_us) {
+    return llabs(true_utc(osc, mono_us) - clock_discipline_now(&d, mono_us));
+}
+
+struct RunReport {
+    int steps;
+    int max_poll_at;                // first update at CLOCK_POLL_MAX_S, or -1
+    int64_t freq_error_ppb;         // worst over the settled updates
+    int64_t phase_error_us;         // worst over the settled updates
+};
+
+// Polls every poll_s from mono_us, sampling the phase error in between
+static RunReport run(Oscillator& osc, ClockDiscipline& d, int64_t& mono_us, int updates) {
+    RunReport r = {0, -1, 0, 0};
+    for (int i = 0; i < updates; ++i) {
+        int64_t offset = true_utc(osc, mono_us) - clock_discipline_now(&d, mono_us) + noise(osc);
+        if (clock_discipline_update(&d, offset, osc.jitter_us, mono_us) == CLOCK_UPDATE_STEP)
+            ++r.steps;
+        if (r.max_poll_at < 0 && d.poll_s == CLOCK_POLL_MAX_S)
+            r.max_poll_at = i;
+        int64_t next = mono_us + (int64_t)d.poll_s * 1000000;
+        if (i >= updates - SETTLED) {
+            int64_t f = llabs(d.freq_ppb - osc.error_ppb);
+            if (f > r.freq_error_ppb)
+                r.freq_error_ppb = f;
+            for (int64_t m = mono_us; m < next; m += (next - mono_us) / SAMPLES) {
+                int64_t e = phase_error(osc, d, m);
+                if (e > r.phase_error_us)
+                    r.phase_error_us = e;
+            }
+        }
+        mono_us = next;
+    }
+    return r;
+}
+
+static void print_report(const Oscillator& osc, const RunReport& r) {
+    printf("%+8.3f ppm, jitter %5lld us: poll max after %3d updates, freq error %5lld ppb, phase error %6lld us\n",
+           osc.error_ppb / 1000.0, (long long)osc.jitter_us, r.max_poll_at, (long long)r.freq_error_ppb,
+           (long long)r.phase_error_us);
+}
+
+static ClockDiscipline disc;
+
+void setUp() {
+    clock_discipline_init(&disc, 0);
+}
+
+void tearDown() {}
+
+// From no knowledge of the drift and a clock seeded far off
+void test_converges_to_oscillator_error() {
+    static const int64_t errors_ppb[] = {-150000, -20000, 0, 3500, 40000, 100000, 400000};
+    static const int64_t jitters_us[] = {500, 2000, 8000};
+    for (size_t e = 0; e < sizeof(errors_ppb) / sizeof(errors_ppb[0]); ++e) {
+        for (size_t j = 0; j < sizeof(jitters_us) / sizeof(jitters_us[0]); ++j) {
+            Oscillator osc = {errors_ppb[e], jitters_us[j], 12345u + (uint32_t)(e * 31 + j)};
+            int64_t mono = 5000000;
+            clock_discipline_init(&disc, 0);
+            clock_discipline_seed(&disc, UTC_EPOCH_US - 86400000000LL, mono);
+            TEST_ASSERT_FALSE(disc.valid);
+            RunReport r = run(osc, disc, mono, UPDATES);
+            print_report(osc, r);
+            // only the first update steps; everything after is slewed
+            TEST_ASSERT_EQUAL(1, r.steps);
+            TEST_ASSERT_TRUE(disc.valid);
+            TEST_ASSERT_GREATER_OR_EQUAL(0, r.max_poll_at);
+            TEST_ASSERT_LESS_THAN(UPDATES - SETTLED, r.max_poll_at);
+            // the rate within one jitter over a maximum poll interval,
+            // the phase within a few jitters
+            TEST_ASSERT_LESS_THAN(osc.jitter_us * 1000 / CLOCK_POLL_MAX_S, r.freq_error_ppb);
+            TEST_ASSERT_LESS_THAN(4 * osc.jitter_us + 1000, r.phase_error_us);
+        }
+    }
+}
+
+// A drift restored from flash starts the poll interval growing at once
+void test_restored_drift_settles_faster() {
+    Oscillator osc = {40000, 2000, 777};
+    int64_t mono = 5000000;
+    RunReport cold = run(osc, disc, mono, UPDATES);
+
+    osc.rng = 777;
+    mono = 5000000;
+    clock_discipline_init(&disc, disc.freq_ppb);
+    RunReport warm = run(osc, disc, mono, UPDATES);
+    print_report(osc, warm);
+    TEST_ASSERT_EQUAL(1, warm.steps);
+    TEST_ASSERT_LESS_THAN(cold.max_poll_at, warm.max_poll_at);
+    TEST_ASSERT_LESS_THAN(4 * osc.jitter_us + 1000, warm.phase_error_us);
+}
+
+// The poll interval doubles after CLOCK_POLL_LIMIT quiet updates, halves on
+// an offset outside the noise, and a step sends it back to the minimum
+void test_poll_interval() {
+    Oscillator osc = {0, 1000, 99};
+    int64_t mono = 5000000;
+    run(osc, disc, mono, UPDATES);
+    TEST_ASSERT_EQUAL(CLOCK_POLL_MAX_S, disc.poll_s);
+
+    osc.jitter_us = 0;
+    for (int i = 1; i < CLOCK_POLL_LIMIT; ++i) {
+        clock_discipline_update(&disc, 0, 0, mono);
+        mono += (int64_t)disc.poll_s * 1000000;
+    }
+    TEST_ASSERT_EQUAL(CLOCK_POLL_MAX_S, disc.poll_s);
+    TEST_ASSERT_EQUAL(CLOCK_UPDATE_SLEW, clock_discipline_update(&disc, 50000, 1000, mono));
+    TEST_ASSERT_EQUAL(CLOCK_POLL_MAX_S / 2, disc.poll_s);
+    TEST_ASSERT_TRUE(clock_discipline_slewing(&disc, mono + 1000000));
+    // 50 ms at CLOCK_MAX_SLEW_PPM
+    TEST_ASSERT_FALSE(clock_discipline_slewing(&disc, mono + 50000LL * 1000000 / CLOCK_MAX_SLEW_PPM));
+
+    mono += 1000000;
+    TEST_ASSERT_EQUAL(CLOCK_UPDATE_STEP, clock_discipline_update(&disc, CLOCK_STEP_US + 1, 1000, mono));
+    TEST_ASSERT_EQUAL(CLOCK_POLL_MIN_S, disc.poll_s);
+    TEST_ASSERT_FALSE(clock_discipline_slewing(&disc, mono));
+}
+
+// The largest slewed offset, backwards: the clock keeps moving forwards and
+// its rate leaves the learned one by no more than CLOCK_MAX_SLEW_PPM
+void test_slew_rate_is_bounded() {
+    Oscillator osc = {0, 0, 1};
+    int64_t mono = 5000000;
+    run(osc, disc, mono, 10);
+    int64_t offset = -(CLOCK_STEP_US - 1);
+    TEST_ASSERT_EQUAL(CLOCK_UPDATE_SLEW, clock_discipline_update(&disc, offset, 0, mono));
+    int64_t end = mono + disc.slew_len_us;
+    int64_t rate = 1000000 + disc.freq_ppb / 1000;
+    int64_t prev = clock_discipline_now(&disc, mono);
+    for (int64_t m = mono + 1000000; m < end + 10000000; m += 1000000) {
+        int64_t now = clock_discipline_now(&disc, m);
+        TEST_ASSERT_GREATER_THAN(prev, now);
+        TEST_ASSERT_LESS_OR_EQUAL(CLOCK_MAX_SLEW_PPM + 1, llabs(now - prev - rate));
+        prev = now;
+    }
+    TEST_ASSERT_FALSE(clock_discipline_slewing(&disc, end));
+    // the whole offset was applied
+    int64_t dt = end - mono;
+    TEST_ASSERT_EQUAL(disc.base_utc_us + dt + dt * disc.freq_ppb / 1000000000 + offset,
+                      clock_discipline_now(&disc, end));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_converges_to_oscillator_error);
+    RUN_TEST(test_restored_drift_settles_faster);
+    RUN_TEST(test_poll_interval);
+    RUN_TEST(test_slew_rate_is_bounded);
+    return UNITY_END();
+}
@@ -0,0 +1,181 @@
+// test_clock_format - incremental clock digits and the date line against libc
+//
+// clock_digits_advance() text and change masks are compared with gmtime_r +
+// strftime over 800 days of one-second runs and jumps between them;
+// clock_format_date() with strftime("%A, %d %B %Y"). The tick cost of six
+// zones is reported next to the snprintf formatting it replaced, with the
+// heap calls counted by heap_monitor.
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unity.h>
+
+#include "clock_format.h"
+#include "heap_monitor.h"
+
+#define START 1735689600LL          // 2025-01-01
+#define DAYS 800
+#define RUN_S 600                   // one-second steps per run
+#define ZONES 6
+#define BENCH_TICKS 2000000
+
+static void libc_text(int64_t local, char* out) {
+    time_t t = (time_t)local;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    strftime(out, CLOCK_TEXT_LEN + 1, "%H:%M:%S", &tm);
+}
+
+static int64_t libc_day(int64_t local) {
+    return local / 86400 - (local % 86400 < 0);
+}
+
+// Advances c to local and checks text and mask against the previous libc text
+static void step_and_check(ClockDigits* c, int64_t local, char* prev) {
+    char want[CLOCK_TEXT_LEN + 1];
+    libc_text(local, want);
+    bool first = c->local == INT64_MIN;
+    bool new_day = first || libc_day(local) != libc_day(c->local);
+    uint16_t mask = clock_digits_advance(c, local);
+    if (strcmp(want, c->text) != 0) {
+        char msg[96];
+        snprintf(msg, sizeof(msg), "at %lld: %s, libc %s", (long long)local, c->text, want);
+        TEST_FAIL_MESSAGE(msg);
+    }
+    uint16_t want_mask = new_day ? CLOCK_CHANGED_DAY : 0;
+    for (int i = 0; i < CLOCK_TEXT_LEN; ++i)
+        if (first ? want[i] != ' ' : want[i] != prev[i])
+            want_mask |= 1 << i;
+    if (mask != want_mask) {
+        char msg[96];
+        snprintf(msg, sizeof(msg), "at %lld (%s): mask %03x, expected %03x", (long long)local, want, mask, want_mask);
+        TEST_FAIL_MESSAGE(msg);
+    }
+    memcpy(prev, want, CLOCK_TEXT_LEN + 1);
+}
+
+void setUp() {
+    heap_monitor_watch_current_task();
+}
+
+void tearDown() {}
+
+// Every day: a run across midnight, a run from a time of day that drifts
+// through the day, and the jumps between them (steps, DST, a resync)
+void test_digits_match_libc() {
+    ClockDigits c;
+    clock_digits_init(&c);
+    char prev[CLOCK_TEXT_LEN + 1];
+    memset(prev, ' ', CLOCK_TEXT_LEN);
+    prev[CLOCK_TEXT_LEN] = '\0';
+    for (int64_t day = 0; day < DAYS; ++day) {
+        int64_t midnight = START + day * 86400;
+        for (int64_t t = midnight - RUN_S / 2; t < midnight + RUN_S / 2; ++t)
+            step_and_check(&c, t, prev);
+        int64_t from = midnight + (day * 3607) % 86400;
+        for (int64_t t = from; t < from + RUN_S; ++t)
+            step_and_check(&c, t, prev);
+        // a backwards step and an hour jump, as after a resync and at DST
+        step_and_check(&c, from + RUN_S - 7, prev);
+        step_and_check(&c, from + RUN_S + 3600, prev);
+    }
+    // the same second again changes nothing
+    uint16_t mask = clock_digits_advance(&c, c.local);
+    TEST_ASSERT_EQUAL(0, mask);
+}
+
+// Negative local times, before 1970, take the same path
+void test_digits_before_1970() {
+    ClockDigits c;
+    clock_digits_init(&c);
+    char prev[CLOCK_TEXT_LEN + 1] = "        ";
+    for (int64_t t = -2 * 86400 - 5; t < -2 * 86400 + 5; ++t)
+        step_and_check(&c, t, prev);
+    step_and_check(&c, -1, prev);
+    step_and_check(&c, 0, prev);
+}
+
+void test_date_matches_strftime() {
+    for (int64_t day = -3653; day < 47482; ++day) { // 1960 to 2100
+        int64_t local = day * 86400 + (day * 7919) % 86400;
+        time_t t = (time_t)local;
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        char want[CLOCK_DATE_MAX + 8], got[CLOCK_DATE_MAX];
+        size_t n = strftime(want, sizeof(want), "%A, %d %B %Y", &tm);
+        TEST_ASSERT_LESS_THAN(CLOCK_DATE_MAX, n);
+        TEST_ASSERT_EQUAL(n, clock_format_date(local, got, sizeof(got)));
+        TEST_ASSERT_EQUAL_STRING(want, got);
+    }
+}
+
+void test_date_truncates() {
+    char want[CLOCK_DATE_MAX], buf[CLOCK_DATE_MAX];
+    int64_t local = 1789516800; // Wednesday, 16 September 2026
+    size_t n = clock_format_date(local, want, sizeof(want));
+    TEST_ASSERT_EQUAL_STRING("Wednesday, 16 September 2026", want);
+    for (size_t len = 1; len <= n; ++len) {
+        TEST_ASSERT_EQUAL(len - 1, clock_format_date(local, buf, len));
+        TEST_ASSERT_EQUAL(0, strncmp(want, buf, len - 1));
+    }
+    TEST_ASSERT_EQUAL(0, clock_format_date(local, buf, 0));
+}
+
+static int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Six zones per tick, as on the device, against snprintf of every zone
+void test_tick_cost() {
+    static const int32_t offsets[ZONES] = {0, -5 * 3600, 19800, -7 * 3600, -8 * 3600, -6 * 3600};
+    ClockDigits clocks[ZONES];
+    for (int z = 0; z < ZONES; ++z) {
+        clock_digits_init(&clocks[z]);
+        clock_digits_advance(&clocks[z], START - 1 + offsets[z]);
+    }
+    char date[CLOCK_DATE_MAX];
+    volatile uint32_t sink = 0;
+
+    HeapCounts before, after;
+    heap_monitor_read_watched(&before);
+    int64_t t0 = now_ns();
+    for (int64_t t = START; t < START + BENCH_TICKS; ++t) {
+        uint16_t changed = 0;
+        for (int z = 0; z < ZONES; ++z)
+            changed |= clock_digits_advance(&clocks[z], t + offsets[z]);
+        if (changed & CLOCK_CHANGED_DAY)
+            sink += (uint32_t)clock_format_date(t, date, sizeof(date));
+        sink += changed;
+    }
+    int64_t digits_ns = now_ns() - t0;
+    heap_monitor_read_watched(&after);
+    uint32_t ops = heap_monitor_ops(&before, &after);
+
+    char text[ZONES][16];
+    t0 = now_ns();
+    for (int64_t t = START; t < START + BENCH_TICKS / 10; ++t)
+        for (int z = 0; z < ZONES; ++z) {
+            int32_t s = (int32_t)((t + offsets[z]) % 86400);
+            sink += (uint32_t)snprintf(text[z], sizeof(text[z]), "%02d:%02d:%02d", s / 3600, s / 60 % 60, s % 60);
+        }
+    int64_t snprintf_ns = (now_ns() - t0) * 10;
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "%d zones: %.1f ns/tick incremental, %.1f ns/tick snprintf, %u heap calls",
+             ZONES, (double)digits_ns / BENCH_TICKS, (double)snprintf_ns / BENCH_TICKS, (unsigned)ops);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_EQUAL(0, ops);
+    TEST_ASSERT_LESS_THAN(snprintf_ns, digits_ns);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_digits_match_libc);
+    RUN_TEST(test_digits_before_1970);
+    RUN_TEST(test_date_matches_strftime);
+    RUN_TEST(test_date_truncates);
+    RUN_TEST(test_tick_cost);
+    return UNITY_END();
+}
@@ -0,0 +1,219 @@
+// test_digit_atlas - atlas cells against LVGL's own rendering of the glyphs
+//
+// LVGL runs on the host behind a display driver that drops its flushes.
+// Each glyph of DIGIT_ATLAS_CHARS is drawn with lv_canvas_draw_text() onto
+// the colour pair's background and must match its atlas cell pixel for
+// pixel, for the firmware's colours and for pairs that exercise every
+// blending branch. The report compares the cost of both ways to a cell.
+#include <lvgl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unity.h>
+
+#include "digit_atlas.h"
+
+extern "C" const lv_font_t lv_font_mono_32;
+
+#define SCREEN_WIDTH 480
+#define SCREEN_HEIGHT 272
+#define BENCH_ROUNDS 200
+
+struct ColourPair {
+    const char* name;
+    lv_color_t fg;
+    lv_color_t bg;
+};
+
+static lv_disp_draw_buf_t draw_buf;
+static lv_color_t draw_pixels[SCREEN_WIDTH * 10];
+static lv_disp_drv_t disp_drv;
+
+static void drop_flush(lv_disp_drv_t* drv, const lv_area_t*, lv_color_t*) {
+    lv_disp_flush_ready(drv);
+}
+
+static void lvgl_host_init() {
+    lv_init();
+    lv_disp_draw_buf_init(&draw_buf, draw_pixels, nullptr, SCREEN_WIDTH * 10);
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.hor_res = SCREEN_WIDTH;
+    disp_drv.ver_res = SCREEN_HEIGHT;
+    disp_drv.flush_cb = drop_flush;
+    disp_drv.draw_buf = &draw_buf;
+    lv_disp_drv_register(&disp_drv);
+}
+
+static int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// A canvas of one cell, drawing text the way a label of the font would
+struct CellCanvas {
+    lv_obj_t* obj;
+    lv_color_t* pixels;
+    lv_draw_label_dsc_t dsc;
+};
+
+static void canvas_open(CellCanvas* c, const DigitAtlas* a, lv_color_t fg) {
+    c->pixels = (lv_color_t*)malloc((size_t)a->w * a->h * sizeof(lv_color_t));
+    TEST_ASSERT_NOT_NULL(c->pixels);
+    c->obj = lv_canvas_create(lv_scr_act());
+    lv_obj_add_flag(c->obj, LV_OBJ_FLAG_HIDDEN);
+    lv_canvas_set_buffer(c->obj, c->pixels, a->w, a->h, LV_IMG_CF_TRUE_COLOR);
+    lv_draw_label_dsc_init(&c->dsc);
+    c->dsc.font = &lv_font_mono_32;
+    c->dsc.color = fg;
+}
+
+static void canvas_draw(CellCanvas* c, const DigitAtlas* a, char ch, lv_color_t bg) {
+    char text[2] = {ch, '\0'};
+    lv_canvas_fill_bg(c->obj, bg, LV_OPA_COVER);
+    lv_canvas_draw_text(c->obj, 0, 0, a->w, &c->dsc, text);
+}
+
+static void canvas_close(CellCanvas* c) {
+    lv_obj_del(c->obj);
+    free(c->pixels);
+}
+
+// Differing pixels over all glyphs; the first of each glyph is printed
+static uint32_t compare_with_lvgl(const DigitAtlas* a, const ColourPair& p) {
+    CellCanvas canvas;
+    canvas_open(&canvas, a, p.fg);
+    uint32_t mismatches = 0;
+    for (int i = 0; i < DIGIT_ATLAS_COUNT; ++i) {
+        char ch = DIGIT_ATLAS_CHARS[i];
+        canvas_draw(&canvas, a, ch, p.bg);
+        const lv_color_t* cell = (const lv_color_t*)digit_atlas_glyph(a, ch)->data;
+        bool reported = false;
+        for (int px = 0; px < a->w * a->h; ++px) {
+            if (canvas.pixels[px].full == cell[px].full)
+                continue;
+            ++mismatches;
+            if (!reported) {
+                printf("%s '%c' at (%d, %d): lvgl %04x, atlas %04x\n", p.name, ch, px % a->w, px / a->w,
+                       canvas.pixels[px].full, cell[px].full);
+                reported = true;
+            }
+        }
+    }
+    canvas_close(&canvas);
+    return mismatches;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+// Opaque, clear and mixed coverage over dark, light and coloured grounds
+void test_cells_match_lvgl() {
+    const ColourPair pairs[] = {
+        {"yellow/black", lv_palette_main(LV_PALETTE_YELLOW), lv_color_black()}, // as in src/main.cpp
+        {"white/black", lv_color_white(), lv_color_black()},
+        {"black/white", lv_color_black(), lv_color_white()},
+        {"cyan/indigo", lv_palette_main(LV_PALETTE_CYAN), lv_palette_darken(LV_PALETTE_INDIGO, 3)},
+        {"red/green", lv_color_make(0xff, 0x20, 0x08), lv_color_make(0x10, 0xc0, 0x30)},
+    };
+    for (size_t i = 0; i < sizeof(pairs) / sizeof(pairs[0]); ++i) {
+        DigitAtlas atlas;
+        TEST_ASSERT_TRUE(digit_atlas_build(&atlas, &lv_font_mono_32, pairs[i].fg, pairs[i].bg));
+        TEST_ASSERT_EQUAL(lv_font_get_glyph_width(&lv_font_mono_32, '0', 0), atlas.w);
+        TEST_ASSERT_EQUAL(lv_font_get_line_height(&lv_font_mono_32), atlas.h);
+        TEST_ASSERT_EQUAL(0, compare_with_lvgl(&atlas, pairs[i]));
+        // the firmware's own check, DIGIT_ATLAS_VERIFY, agrees
+        uint32_t lvgl_us, atlas_us;
+        TEST_ASSERT_EQUAL(0, digit_atlas_verify(&atlas, &lv_font_mono_32, pairs[i].fg, pairs[i].bg, &lvgl_us,
+                                                &atlas_us));
+        digit_atlas_free(&atlas);
+    }
+}
+
+// Two colour pairs are two atlases, side by side
+void test_atlas_per_colour_pair() {
+    DigitAtlas day, night;
+    TEST_ASSERT_TRUE(digit_atlas_build(&day, &lv_font_mono_32, lv_color_black(), lv_color_white()));
+    TEST_ASSERT_TRUE(digit_atlas_build(&night, &lv_font_mono_32, lv_color_white(), lv_color_black()));
+    TEST_ASSERT_TRUE(day.pixels != night.pixels);
+    const lv_color_t* d = (const lv_color_t*)digit_atlas_glyph(&day, '8')->data;
+    const lv_color_t* n = (const lv_color_t*)digit_atlas_glyph(&night, '8')->data;
+    TEST_ASSERT_EQUAL_HEX16(lv_color_white().full, d[0].full);
+    TEST_ASSERT_EQUAL_HEX16(lv_color_black().full, n[0].full);
+    ColourPair day_pair = {"day", lv_color_black(), lv_color_white()};
+    ColourPair night_pair = {"night", lv_color_white(), lv_color_black()};
+    TEST_ASSERT_EQUAL(0, compare_with_lvgl(&day, day_pair));
+    TEST_ASSERT_EQUAL(0, compare_with_lvgl(&night, night_pair));
+    digit_atlas_free(&day);
+    digit_atlas_free(&night);
+}
+
+void test_glyph_lookup() {
+    DigitAtlas atlas;
+    memset(&atlas, 0, sizeof(atlas));
+    TEST_ASSERT_NULL(digit_atlas_glyph(&atlas, '0'));
+    TEST_ASSERT_TRUE(digit_atlas_build(&atlas, &lv_font_mono_32, lv_color_white(), lv_color_black()));
+    for (int i = 0; i < DIGIT_ATLAS_COUNT; ++i) {
+        const lv_img_dsc_t* g = digit_atlas_glyph(&atlas, DIGIT_ATLAS_CHARS[i]);
+        TEST_ASSERT_TRUE(g == &atlas.glyph[i]);
+        TEST_ASSERT_EQUAL(LV_IMG_CF_TRUE_COLOR, g->header.cf);
+        TEST_ASSERT_EQUAL(atlas.w, g->header.w);
+        TEST_ASSERT_EQUAL(atlas.h, g->header.h);
+        TEST_ASSERT_EQUAL((uint32_t)atlas.w * atlas.h * sizeof(lv_color_t), g->data_size);
+    }
+    TEST_ASSERT_NULL(digit_atlas_glyph(&atlas, 'a'));
+    TEST_ASSERT_NULL(digit_atlas_glyph(&atlas, '\0'));
+    digit_atlas_free(&atlas);
+    TEST_ASSERT_NULL(digit_atlas_glyph(&atlas, '0'));
+}
+
+// Per glyph: rasterizing through LVGL against copying the cell's rows
+void test_cell_cost() {
+    ColourPair p = {"yellow/black", lv_palette_main(LV_PALETTE_YELLOW), lv_color_black()};
+    DigitAtlas atlas;
+    TEST_ASSERT_TRUE(digit_atlas_build(&atlas, &lv_font_mono_32, p.fg, p.bg));
+    CellCanvas canvas;
+    canvas_open(&canvas, &atlas, p.fg);
+    lv_coord_t w = atlas.w, h = atlas.h;
+    lv_color_t* frame = (lv_color_t*)malloc((size_t)SCREEN_WIDTH * h * sizeof(lv_color_t));
+    TEST_ASSERT_NOT_NULL(frame);
+
+    int64_t t0 = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; ++r)
+        for (int i = 0; i < DIGIT_ATLAS_COUNT; ++i)
+            canvas_draw(&canvas, &atlas, DIGIT_ATLAS_CHARS[i], p.bg);
+    int64_t lvgl_ns = now_ns() - t0;
+
+    // row by row into a band the width of the screen, as LVGL blits a
+    // true-colour image
+    t0 = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; ++r)
+        for (int i = 0; i < DIGIT_ATLAS_COUNT; ++i) {
+            const lv_color_t* cell = (const lv_color_t*)atlas.glyph[i].data;
+            for (lv_coord_t y = 0; y < h; ++y)
+                memcpy(frame + y * SCREEN_WIDTH + i * w, cell + y * w, w * sizeof(lv_color_t));
+        }
+    int64_t atlas_ns = now_ns() - t0;
+    canvas_close(&canvas);
+    free(frame);
+    digit_atlas_free(&atlas);
+
+    char msg[96];
+    snprintf(msg, sizeof(msg), "%dx%d cell: %lld ns rendered, %lld ns copied", w, h,
+             (long long)(lvgl_ns / (BENCH_ROUNDS * DIGIT_ATLAS_COUNT)),
+             (long long)(atlas_ns / (BENCH_ROUNDS * DIGIT_ATLAS_COUNT)));
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_LESS_THAN(lvgl_ns, atlas_ns);
+}
+
+int main() {
+    lvgl_host_init();
+    UNITY_BEGIN();
+    RUN_TEST(test_cells_match_lvgl);
+    RUN_TEST(test_atlas_per_colour_pair);
+    RUN_TEST(test_glyph_lookup);
+    RUN_TEST(test_cell_cost);
+    return UNITY_END();
+}
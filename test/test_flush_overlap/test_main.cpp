@@ -0,0 +1,132 @@
+// test_flush_overlap - LVGL band flushes on a simulated QSPI bus: render/bus overlap
+//
+// Replays what src/main.cpp does with RENDER_LVGL_DIRECT: LVGL renders a band
+// into one of two DMA buffers, waits for the previous band's done callback,
+// then my_disp_flush() queues the address window and the pixels and returns.
+// The report shows how much of the bus time hides behind rendering; the
+// checks make sure queueing a band never blocks the renderer.
+#include <gfx_host.h>
+#include <unity.h>
+
+// as in src/main.cpp
+#define SCREEN_WIDTH 480
+#define SCREEN_HEIGHT 272
+#define SCR_BUF_LEN 68
+
+#define BAND_PX (SCREEN_WIDTH * SCR_BUF_LEN)
+#define BANDS (SCREEN_HEIGHT / SCR_BUF_LEN)
+#define FRAMES 4
+
+static Arduino_ESP32QSPI* bus;
+static Arduino_NV3041A* panel;
+static uint16_t* bands[2];
+static volatile bool flushing;
+
+static void flush_done(void*) {
+    flushing = false;
+}
+
+struct FlushReport {
+    int64_t frame_us;
+    int64_t render_us;
+    int64_t bus_us;
+    int64_t overlap_us;    // bus busy while the CPU rendered
+    int64_t lvgl_wait_us;  // LVGL waiting for the previous band
+    int64_t flush_wait_us; // my_disp_flush() blocked on the SPI queue
+};
+
+// FRAMES frames of full-width bands, each rendered for render_us
+static FlushReport run_frames(int64_t render_us) {
+    FlushReport r = {};
+    int64_t start = esp_timer_get_time();
+    int buf = 0;
+    for (int f = 0; f < FRAMES; ++f) {
+        for (int b = 0; b < BANDS; ++b, buf ^= 1) {
+            int64_t t = esp_timer_get_time();
+            fake_esp_advance(render_us);
+            r.render_us += render_us;
+            r.overlap_us += fake_spi_busy_us(t, esp_timer_get_time());
+
+            t = esp_timer_get_time();
+            while (flushing)
+                TEST_ASSERT_TRUE(fake_esp_step());
+            r.lvgl_wait_us += esp_timer_get_time() - t;
+
+            // my_disp_flush()
+            int64_t waited = fake_esp().wait_us;
+            flushing = true;
+            panel_command_t window[NV3041A_WINDOW_COMMANDS];
+            uint8_t n = panel->encodeAddrWindow(0, b * SCR_BUF_LEN, SCREEN_WIDTH, SCR_BUF_LEN, window);
+            panel->startWrite();
+            bus->writeCommandsAsync(window, n);
+            bus->writePixelsAsync(bands[buf], BAND_PX, true);
+            panel->endWrite();
+            r.flush_wait_us += fake_esp().wait_us - waited;
+        }
+    }
+    while (flushing)
+        TEST_ASSERT_TRUE(fake_esp_step());
+    r.frame_us = (esp_timer_get_time() - start) / FRAMES;
+    r.bus_us = fake_spi_busy_us(start, esp_timer_get_time());
+    return r;
+}
+
+static void print_report(const char* name, const FlushReport& r) {
+    printf("%-10s frame %6lld us  render %6lld  bus %6lld  overlap %6lld (%3lld%% of bus)  "
+           "lvgl wait %6lld  flush blocked %5lld\n",
+           name, (long long)r.frame_us, (long long)r.render_us / FRAMES, (long long)r.bus_us / FRAMES,
+           (long long)r.overlap_us / FRAMES, (long long)(r.bus_us ? r.overlap_us * 100 / r.bus_us : 0),
+           (long long)r.lvgl_wait_us / FRAMES, (long long)r.flush_wait_us / FRAMES);
+}
+
+void setUp() {
+    fake_esp_reset();
+    flushing = false;
+    bus = new Arduino_ESP32QSPI(45, 47, 21, 48, 40, 39);
+    panel = new Arduino_NV3041A(bus, GFX_NOT_DEFINED, 0, true);
+    TEST_ASSERT_TRUE(panel->begin());
+    bus->setTransDoneCallback(flush_done, NULL);
+    for (int i = 0; i < 2; ++i) {
+        bands[i] = (uint16_t*)heap_caps_aligned_alloc(16, BAND_PX * 2, MALLOC_CAP_DMA);
+        memset(bands[i], 0x5a, BAND_PX * 2);
+    }
+    bus->waitAsyncDone();
+    fake_esp_reset();
+}
+
+void tearDown() {
+    bus->waitAsyncDone();
+    heap_caps_free(bands[0]);
+    heap_caps_free(bands[1]);
+    delete panel;
+    delete bus;
+}
+
+// Rendering slower than the bus: every band's DMA hides behind the next render
+void test_render_bound() {
+    FlushReport r = run_frames(5000);
+    print_report("render>bus", r);
+    TEST_ASSERT_EQUAL(0, r.flush_wait_us);
+    TEST_ASSERT_EQUAL(0, fake_esp().overflows);
+    TEST_ASSERT_EQUAL(0, fake_esp().mixed);
+    // all but the last band of the run overlaps rendering
+    TEST_ASSERT_GREATER_OR_EQUAL(r.bus_us * (FRAMES * BANDS - 1) / (FRAMES * BANDS), r.overlap_us);
+}
+
+// Rendering faster than the bus: LVGL waits for the band, but queueing never does
+void test_bus_bound() {
+    FlushReport r = run_frames(2000);
+    print_report("bus>render", r);
+    TEST_ASSERT_EQUAL(0, r.flush_wait_us);
+    TEST_ASSERT_EQUAL(0, fake_esp().overflows);
+    TEST_ASSERT_GREATER_THAN(0, r.lvgl_wait_us);
+    // only the first band renders with nothing on the bus
+    TEST_ASSERT_EQUAL(r.render_us - 2000, r.overlap_us);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_render_bound);
+    RUN_TEST(test_bus_bound);
+    return UNITY_END();
+}
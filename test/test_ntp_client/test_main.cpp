@@ -0,0 +1,268 @@
+// test_ntp_client - the NTP client against stand-in servers on loopback UDP
+//
+// Each stand-in is a real UDP socket on 127.0.0.1 that the test answers by
+// hand, so the client goes through its own sockets and packet parsing. Time
+// is simulated: the client reads sim_us plus its own error, and each server
+// stamps its replies with sim_us plus its error after a chosen out and back
+// delay. The expected offset and delay follow from those numbers exactly.
+#include <arpa/inet.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <unity.h>
+
+#include "ntp_client.h"
+
+#define NTP_UNIX_EPOCH 2208988800ULL
+#define ROUND_GAP_US 16000000LL     // between polls, as at the shortest poll interval
+#define MAX_SERVERS NTP_MAX_PEERS
+
+struct StandIn {
+    int sock;
+    struct sockaddr_in addr;
+    int64_t out_us;                 // client to server
+    int64_t back_us;                // server to client
+    int64_t err_us;                 // server clock minus true time
+    bool silent;
+};
+
+static int64_t sim_us;              // true time
+static int64_t client_err_us;       // client clock minus true time
+static NtpClient client;
+static StandIn servers[MAX_SERVERS];
+static int server_count;
+
+static int64_t client_clock() {
+    return sim_us + client_err_us;
+}
+
+static uint64_t us_to_ntp(int64_t us) {
+    uint64_t sec = (uint64_t)(us / 1000000) + NTP_UNIX_EPOCH;
+    uint64_t frac = ((uint64_t)(us % 1000000) << 32) / 1000000;
+    return (sec << 32) | frac;
+}
+
+static void put64(uint8_t* p, uint64_t v) {
+    for (int i = 7; i >= 0; --i, v >>= 8)
+        p[i] = (uint8_t)v;
+}
+
+static StandIn* add_server(int64_t out_us, int64_t back_us, int64_t err_us) {
+    StandIn* s = &servers[server_count++];
+    memset(s, 0, sizeof(*s));
+    s->sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    TEST_ASSERT_TRUE(s->sock >= 0);
+    s->addr.sin_family = AF_INET;
+    s->addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST_ASSERT_EQUAL(0, bind(s->sock, (struct sockaddr*)&s->addr, sizeof(s->addr)));
+    socklen_t len = sizeof(s->addr);
+    getsockname(s->sock, (struct sockaddr*)&s->addr, &len);
+    struct timeval tv = {1, 0};
+    setsockopt(s->sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    s->out_us = out_us;
+    s->back_us = back_us;
+    s->err_us = err_us;
+    return s;
+}
+
+static int add_peer(const StandIn* s) {
+    return ntp_client_add_peer_addr(&client, &s->addr);
+}
+
+// Server i takes the request in at round start + out_us and answers at once
+static void answer(StandIn* s, int64_t t0) {
+    uint8_t req[64];
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    ssize_t n = recvfrom(s->sock, req, sizeof(req), 0, (struct sockaddr*)&from, &from_len);
+    TEST_ASSERT_EQUAL(48, n);
+    if (s->silent)
+        return;
+    uint8_t pkt[48];
+    memset(pkt, 0, sizeof(pkt));
+    pkt[0] = (4 << 3) | 4;          // LI 0, version 4, server
+    pkt[1] = 1;                     // stratum
+    uint64_t stamp = us_to_ntp(t0 + s->out_us + s->err_us);
+    memcpy(pkt + 24, req + 40, 8);  // origin = the client's transmit time
+    put64(pkt + 32, stamp);
+    put64(pkt + 40, stamp);
+    sendto(s->sock, pkt, sizeof(pkt), 0, (struct sockaddr*)&from, from_len);
+}
+
+// One poll of every server in the client; replies are serviced in the order
+// they would arrive, each at its own simulated time
+static void run_round() {
+    int64_t t0 = sim_us;
+    ntp_client_poll(&client);
+    int order[MAX_SERVERS];
+    for (int i = 0; i < server_count; ++i) {
+        int j = i;
+        for (; j > 0 && servers[order[j - 1]].out_us + servers[order[j - 1]].back_us >
+                            servers[i].out_us + servers[i].back_us; --j)
+            order[j] = order[j - 1];
+        order[j] = i;
+    }
+    for (int k = 0; k < server_count; ++k) {
+        StandIn* s = &servers[order[k]];
+        answer(s, t0);
+        if (s->silent)
+            continue;
+        sim_us = t0 + s->out_us + s->back_us;
+        struct pollfd pfd = {client.sock, POLLIN, 0};
+        TEST_ASSERT_EQUAL(1, poll(&pfd, 1, 1000));
+        TEST_ASSERT_EQUAL(1, ntp_client_service(&client));
+    }
+    // silent servers time out
+    sim_us = t0 + NTP_TIMEOUT_US + 1;
+    ntp_client_service(&client);
+    TEST_ASSERT_FALSE(ntp_client_busy(&client));
+    sim_us = t0 + ROUND_GAP_US;
+}
+
+void setUp() {
+    sim_us = 1700000000LL * 1000000;
+    client_err_us = 0;
+    server_count = 0;
+    TEST_ASSERT_TRUE(ntp_client_init(&client, client_clock));
+}
+
+void tearDown() {
+    ntp_client_close(&client);
+    for (int i = 0; i < server_count; ++i)
+        close(servers[i].sock);
+}
+
+void test_symmetric_paths_give_exact_offset() {
+    client_err_us = 250000; // client runs 250 ms ahead
+    for (int i = 0; i < 3; ++i)
+        add_peer(add_server(10000 + 5000 * i, 10000 + 5000 * i, 0));
+    run_round();
+    for (int i = 0; i < 3; ++i) {
+        TEST_ASSERT_TRUE(client.peers[i].valid);
+        TEST_ASSERT_EQUAL(1, client.peers[i].reach);
+        TEST_ASSERT_EQUAL(-250000, client.peers[i].offset_us);
+        TEST_ASSERT_EQUAL(20000 + 10000 * i, client.peers[i].delay_us);
+    }
+    NtpSolution s;
+    TEST_ASSERT_TRUE(ntp_client_select(&client, &s));
+    TEST_ASSERT_EQUAL(-250000, s.offset_us);
+    TEST_ASSERT_EQUAL(3, s.truechimers);
+    TEST_ASSERT_EQUAL(3, s.survivors);
+}
+
+// An asymmetric path shifts the offset by half the difference, never more
+// than half the round trip
+void test_asymmetry_bounded_by_half_delay() {
+    add_peer(add_server(30000, 10000, 0));
+    add_peer(add_server(10000, 30000, 0));
+    add_peer(add_server(2000, 2000, 0));
+    run_round();
+    TEST_ASSERT_EQUAL(10000, client.peers[0].offset_us);
+    TEST_ASSERT_EQUAL(-10000, client.peers[1].offset_us);
+    TEST_ASSERT_EQUAL(0, client.peers[2].offset_us);
+    for (int i = 0; i < 3; ++i)
+        TEST_ASSERT_LESS_OR_EQUAL(client.peers[i].delay_us / 2, llabs(client.peers[i].offset_us));
+    NtpSolution s;
+    TEST_ASSERT_TRUE(ntp_client_select(&client, &s));
+    TEST_ASSERT_LESS_OR_EQUAL(2000, llabs(s.offset_us));
+}
+
+// Queueing on the way out inflates delay and offset together; the clock
+// filter keeps the sample with the lowest delay even when it is not the newest
+void test_filter_picks_lowest_delay() {
+    StandIn* srv = add_server(5000, 5000, 0);
+    add_peer(srv);
+    for (int round = 0; round < NTP_FILTER_STAGES; ++round) {
+        srv->out_us = round == 2 ? 5000 : 5000 + 20000 + 7000 * round;
+        run_round();
+    }
+    TEST_ASSERT_EQUAL(NTP_FILTER_STAGES, client.peers[0].filter_count);
+    TEST_ASSERT_EQUAL(10000, client.peers[0].delay_us);
+    TEST_ASSERT_EQUAL(0, client.peers[0].offset_us);
+    TEST_ASSERT_GREATER_THAN(0, client.peers[0].jitter_us);
+}
+
+void test_falseticker_rejected() {
+    add_peer(add_server(10000, 10000, 0));
+    add_peer(add_server(12000, 12000, 200));
+    add_peer(add_server(8000, 8000, -200));
+    add_peer(add_server(10000, 10000, 5000000)); // 5 s off
+    for (int round = 0; round < 4; ++round)
+        run_round();
+    NtpSolution s;
+    TEST_ASSERT_TRUE(ntp_client_select(&client, &s));
+    TEST_ASSERT_EQUAL(3, s.truechimers);
+    TEST_ASSERT_LESS_OR_EQUAL(200, llabs(s.offset_us));
+}
+
+// A server that stops answering is unreachable after a full reach register,
+// not before; removing it leaves the other peers working
+void test_silent_server_unreachable() {
+    for (int i = 0; i < 4; ++i)
+        add_peer(add_server(10000, 10000, 0));
+    servers[1].silent = true;
+    for (int round = 0; round < NTP_REACH_POLLS - 1; ++round)
+        run_round();
+    TEST_ASSERT_FALSE(ntp_client_peer_unreachable(&client, 1));
+    run_round();
+    TEST_ASSERT_TRUE(ntp_client_peer_unreachable(&client, 1));
+    for (int i = 0; i < 4; ++i)
+        if (i != 1)
+            TEST_ASSERT_FALSE(ntp_client_peer_unreachable(&client, i));
+
+    ntp_client_remove_peer(&client, 1);
+    TEST_ASSERT_EQUAL(3, client.peer_count);
+    TEST_ASSERT_EQUAL(servers[2].addr.sin_port, client.peers[1].addr.sin_port);
+    TEST_ASSERT_EQUAL(servers[3].addr.sin_port, client.peers[2].addr.sin_port);
+    // the replacement starts with a fresh register
+    servers[1].silent = false;
+    TEST_ASSERT_EQUAL(3, add_peer(&servers[1]));
+    TEST_ASSERT_FALSE(ntp_client_peer_unreachable(&client, 3));
+    run_round();
+    NtpSolution s;
+    TEST_ASSERT_TRUE(ntp_client_select(&client, &s));
+    TEST_ASSERT_EQUAL(4, s.truechimers);
+}
+
+// Pool names can hand out the same server twice
+void test_duplicate_address_rejected() {
+    StandIn* a = add_server(10000, 10000, 0);
+    TEST_ASSERT_EQUAL(0, add_peer(a));
+    TEST_ASSERT_EQUAL(-1, add_peer(a));
+    TEST_ASSERT_EQUAL(1, add_peer(add_server(10000, 10000, 0)));
+    TEST_ASSERT_EQUAL(2, client.peer_count);
+}
+
+// After the clock is corrected the filtered samples follow it, so the next
+// solution is near zero instead of applying the correction twice
+void test_clock_adjusted_rebases_filter() {
+    client_err_us = -400000;
+    for (int i = 0; i < 3; ++i)
+        add_peer(add_server(10000, 10000, 0));
+    run_round();
+    NtpSolution s;
+    TEST_ASSERT_TRUE(ntp_client_select(&client, &s));
+    TEST_ASSERT_EQUAL(400000, s.offset_us);
+    client_err_us += s.offset_us;
+    ntp_client_clock_adjusted(&client, s.offset_us);
+    TEST_ASSERT_TRUE(ntp_client_select(&client, &s));
+    TEST_ASSERT_EQUAL(0, s.offset_us);
+    run_round();
+    TEST_ASSERT_TRUE(ntp_client_select(&client, &s));
+    TEST_ASSERT_EQUAL(0, s.offset_us);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_symmetric_paths_give_exact_offset);
+    RUN_TEST(test_asymmetry_bounded_by_half_delay);
+    RUN_TEST(test_filter_picks_lowest_delay);
+    RUN_TEST(test_falseticker_rejected);
+    RUN_TEST(test_silent_server_unreachable);
+    RUN_TEST(test_duplicate_address_rejected);
+    RUN_TEST(test_clock_adjusted_rebases_filter);
+    return UNITY_END();
+}
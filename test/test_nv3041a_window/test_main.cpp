@@ -0,0 +1,161 @@
+// test_nv3041a_window - bus transactions per address window on the NV3041A
+//
+// Each window costs CASET and RASET only when its column or row range
+// changed since the last one, plus RAMWR. Counted on the simulated QSPI bus
+// for both ways of sending it: encodeAddrWindow() queued ahead of the pixels
+// as my_disp_flush() does, and the polled writeAddrWindow().
+#include <gfx_host.h>
+#include <unity.h>
+
+#define SCREEN_WIDTH 480
+#define SCREEN_HEIGHT 272
+
+static Arduino_ESP32QSPI* bus;
+static Arduino_NV3041A* panel;
+
+struct Window {
+    int16_t x, y;
+    uint16_t w, h;
+};
+
+static void drain() {
+    while (fake_spi_outstanding())
+        TEST_ASSERT_TRUE(fake_esp_step());
+}
+
+// Log entries the window produced, checked against the encoded commands
+static int queue_window(const Window& win) {
+    panel_command_t cmds[NV3041A_WINDOW_COMMANDS];
+    int from = fake_esp().log_count;
+    uint8_t n = panel->encodeAddrWindow(win.x, win.y, win.w, win.h, cmds);
+    TEST_ASSERT_LESS_OR_EQUAL(NV3041A_WINDOW_COMMANDS, n);
+    panel->startWrite();
+    bus->writeCommandsAsync(cmds, n);
+    drain();
+    panel->endWrite();
+    int count = fake_esp().log_count - from;
+    TEST_ASSERT_EQUAL(n, count);
+    for (int i = 0; i < count; ++i) {
+        const FakeSpiRecord& r = fake_esp().log[from + i];
+        TEST_ASSERT_TRUE(r.queued);
+        TEST_ASSERT_EQUAL_HEX32((uint32_t)cmds[i].cmd << 8, r.addr);
+        TEST_ASSERT_EQUAL(cmds[i].len * 8, r.bits);
+        TEST_ASSERT_EQUAL_MEMORY(cmds[i].data, r.data, cmds[i].len);
+    }
+    TEST_ASSERT_EQUAL_HEX32(NV3041A_RAMWR << 8, fake_esp().log[from + count - 1].addr);
+    return count;
+}
+
+static int write_window(const Window& win) {
+    int from = fake_esp().log_count;
+    panel->startWrite();
+    panel->writeAddrWindow(win.x, win.y, win.w, win.h);
+    panel->endWrite();
+    drain();
+    for (int i = from; i < fake_esp().log_count; ++i)
+        TEST_ASSERT_FALSE(fake_esp().log[i].queued);
+    TEST_ASSERT_EQUAL_HEX32(NV3041A_RAMWR << 8, fake_esp().log[fake_esp().log_count - 1].addr);
+    return fake_esp().log_count - from;
+}
+
+// The range a CASET or RASET in the log sets, first and last inclusive
+static void assert_range(int log_index, uint8_t reg, uint16_t first, uint16_t last) {
+    const FakeSpiRecord& r = fake_esp().log[log_index];
+    TEST_ASSERT_EQUAL_HEX32((uint32_t)reg << 8, r.addr);
+    TEST_ASSERT_EQUAL(first, (r.data[0] << 8) | r.data[1]);
+    TEST_ASSERT_EQUAL(last, (r.data[2] << 8) | r.data[3]);
+}
+
+void setUp() {
+    fake_esp_reset();
+    bus = new Arduino_ESP32QSPI(45, 47, 21, 48, 40, 39);
+    panel = new Arduino_NV3041A(bus, GFX_NOT_DEFINED, 0, true);
+    TEST_ASSERT_TRUE(panel->begin());
+    // begin() clears the screen, leaving a window behind; start from none
+    panel->setRotation(0);
+    drain();
+}
+
+void tearDown() {
+    delete panel;
+    delete bus;
+}
+
+typedef int (*send_fn)(const Window&);
+
+// The band sequence of one LVGL frame, then the partial updates of a tick
+static void check_sequence(send_fn send) {
+    const Window full = {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT};
+    int base = fake_esp().log_count;
+    TEST_ASSERT_EQUAL(3, send(full));
+    assert_range(base, NV3041A_CASET, 0, SCREEN_WIDTH - 1);
+    assert_range(base + 1, NV3041A_RASET, 0, SCREEN_HEIGHT - 1);
+    // cached: the same window again is RAMWR alone
+    TEST_ASSERT_EQUAL(1, send(full));
+
+    // row only: full-width bands down the screen
+    for (int16_t y = 0; y < SCREEN_HEIGHT; y += 68) {
+        const Window band = {0, y, SCREEN_WIDTH, 68};
+        int at = fake_esp().log_count;
+        TEST_ASSERT_EQUAL(2, send(band));
+        assert_range(at, NV3041A_RASET, y, y + 67);
+    }
+    // a height change on the same row is a row change too
+    int at = fake_esp().log_count;
+    TEST_ASSERT_EQUAL(2, send({0, 204, SCREEN_WIDTH, 40}));
+    assert_range(at, NV3041A_RASET, 204, 243);
+
+    // column only: digit cells along one row
+    for (int16_t x = 100; x < 300; x += 25) {
+        at = fake_esp().log_count;
+        TEST_ASSERT_EQUAL(2, send({x, 204, 25, 40}));
+        assert_range(at, NV3041A_CASET, x, x + 24);
+    }
+    // a width change at the same x is a column change
+    at = fake_esp().log_count;
+    TEST_ASSERT_EQUAL(2, send({275, 204, 50, 40}));
+    assert_range(at, NV3041A_CASET, 275, 324);
+
+    // both
+    at = fake_esp().log_count;
+    TEST_ASSERT_EQUAL(3, send({10, 20, 30, 40}));
+    assert_range(at, NV3041A_CASET, 10, 39);
+    assert_range(at + 1, NV3041A_RASET, 20, 59);
+    TEST_ASSERT_EQUAL(1, send({10, 20, 30, 40}));
+}
+
+void test_queued_window_transactions() {
+    check_sequence(queue_window);
+}
+
+void test_polled_window_transactions() {
+    check_sequence(write_window);
+}
+
+// Both paths share the cache, so mixing them never skips a needed range
+void test_paths_share_cache() {
+    const Window a = {0, 0, SCREEN_WIDTH, 68};
+    TEST_ASSERT_EQUAL(3, queue_window(a));
+    TEST_ASSERT_EQUAL(1, write_window(a));
+    TEST_ASSERT_EQUAL(2, write_window({0, 68, SCREEN_WIDTH, 68}));
+    TEST_ASSERT_EQUAL(1, queue_window({0, 68, SCREEN_WIDTH, 68}));
+}
+
+// A rotation moves the panel's address space; the cache must not survive it
+void test_rotation_invalidates_cache() {
+    const Window a = {0, 0, SCREEN_WIDTH, 68};
+    TEST_ASSERT_EQUAL(3, queue_window(a));
+    panel->setRotation(2);
+    drain();
+    TEST_ASSERT_EQUAL(3, queue_window(a));
+    TEST_ASSERT_EQUAL(1, queue_window(a));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_queued_window_transactions);
+    RUN_TEST(test_polled_window_transactions);
+    RUN_TEST(test_paths_share_cache);
+    RUN_TEST(test_rotation_invalidates_cache);
+    return UNITY_END();
+}
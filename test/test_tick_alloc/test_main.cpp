@@ -0,0 +1,143 @@
+// test_tick_alloc - the per-second tick work never touches the heap
+//
+// Runs what prepare_tick() in src/main.cpp does for every second of a few
+// days around DST changes and midnights, and checks heap_monitor's counts.
+// The native env links with the same --wrap flags as the firmware, so any
+// malloc, calloc, realloc or free in the code under test is counted.
+#include <pthread.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include "clock_format.h"
+#include "heap_monitor.h"
+#include "zone_offset.h"
+
+// as in src/main.cpp
+static const char* const city_tz[] = {
+    "GMT0BST,M3.5.0/1,M10.5.0",
+    "EST5EDT,M3.2.0,M11.1.0",
+    "IST-5:30",
+    "MST7",
+    "PST8PDT,M3.2.0,M11.1.0",
+    "CST6CDT,M3.2.0,M11.1.0",
+};
+#define CITY_COUNT ((int)(sizeof(city_tz) / sizeof(city_tz[0])))
+#define TICK_HEAP_WARMUP 3
+
+static ZoneTable zones;
+static ZoneTime times[ZONE_TABLE_MAX];
+static ClockDigits clocks[ZONE_TABLE_MAX];
+static uint16_t changed[ZONE_TABLE_MAX];
+static char date[CLOCK_DATE_MAX];
+
+// Called through these, an unused malloc/free pair cannot be folded away
+// at -O1 and above even without -fno-builtin, so the counts below are exact
+static void* (*volatile heap_malloc)(size_t) = malloc;
+static void* (*volatile heap_calloc)(size_t, size_t) = calloc;
+static void* (*volatile heap_realloc)(void*, size_t) = realloc;
+static void (*volatile heap_free)(void*) = free;
+
+static void prepare_tick(int64_t second) {
+    zone_table_convert_all(&zones, second, times);
+    for (int i = 0; i < zones.count; ++i)
+        changed[i] = clock_digits_advance(&clocks[i], times[i].local);
+    if (changed[0] & CLOCK_CHANGED_DAY)
+        clock_format_date(times[0].local, date, sizeof(date));
+}
+
+// Ticks after the warm-up that made any heap call
+static int run_ticks(int64_t from, int64_t count, uint32_t* ops) {
+    int allocating = 0;
+    *ops = 0;
+    for (int64_t t = 0; t < count; ++t) {
+        HeapCounts before, after;
+        heap_monitor_read_watched(&before);
+        prepare_tick(from + t);
+        heap_monitor_read_watched(&after);
+        uint32_t n = heap_monitor_ops(&before, &after);
+        if (t >= TICK_HEAP_WARMUP && n) {
+            ++allocating;
+            *ops += n;
+        }
+    }
+    return allocating;
+}
+
+void setUp() {
+    heap_monitor_watch_current_task();
+    zone_table_init(&zones);
+    for (int i = 0; i < CITY_COUNT; ++i) {
+        TEST_ASSERT_EQUAL(i, zone_table_add(&zones, city_tz[i]));
+        clock_digits_init(&clocks[i]);
+    }
+}
+
+void tearDown() {}
+
+// The counters must see calls made here, or a zero below proves nothing
+void test_wraps_are_linked() {
+    HeapCounts before, after;
+    heap_monitor_read_watched(&before);
+    void* p = heap_malloc(32);
+    p = heap_realloc(p, 64);
+    void* q = heap_calloc(4, 8);
+    void* r = heap_realloc(nullptr, 16);
+    heap_free(p);
+    heap_free(q);
+    r = heap_realloc(r, 0);
+    heap_free(r);
+    heap_free(nullptr);
+    heap_monitor_read_watched(&after);
+    TEST_ASSERT_EQUAL(3, after.allocs - before.allocs);
+    TEST_ASSERT_EQUAL(3 + (r ? 1 : 0), after.frees - before.frees);
+    TEST_ASSERT_EQUAL(1, after.reallocs - before.reallocs);
+}
+
+static void* other_task(void*) {
+    heap_free(heap_malloc(100));
+    return nullptr;
+}
+
+// Another task allocating shows in the totals, not in the watched counts
+void test_other_tasks_not_watched() {
+    HeapCounts all_before, all_after, before, after;
+    heap_monitor_read(&all_before);
+    heap_monitor_read_watched(&before);
+    pthread_t th;
+    TEST_ASSERT_EQUAL(0, pthread_create(&th, nullptr, other_task, nullptr));
+    pthread_join(th, nullptr);
+    heap_monitor_read(&all_after);
+    heap_monitor_read_watched(&after);
+    TEST_ASSERT_EQUAL(0, heap_monitor_ops(&before, &after));
+    TEST_ASSERT_GREATER_OR_EQUAL(2, heap_monitor_ops(&all_before, &all_after));
+}
+
+// Three days across the US spring change, which also covers three midnights
+// per zone and London an hour later than New York
+void test_ticks_allocation_free_across_dst() {
+    uint32_t ops;
+    int64_t from = 1741392000; // 2025-03-08 00:00 UTC
+    TEST_ASSERT_EQUAL(0, run_ticks(from, 3 * 86400, &ops));
+    TEST_ASSERT_EQUAL(0, ops);
+}
+
+// A clock step re-derives every digit instead of rippling one
+void test_clock_steps_allocation_free() {
+    uint32_t ops;
+    int64_t t = 1761955200; // 2025-11-01, before the US fall change
+    TEST_ASSERT_EQUAL(0, run_ticks(t, 10, &ops));
+    for (int step = 0; step < 50; ++step) {
+        t += step & 1 ? -3600 * 7 - 13 : 86400 + 3601;
+        TEST_ASSERT_EQUAL(0, run_ticks(t, TICK_HEAP_WARMUP + 5, &ops));
+    }
+    TEST_ASSERT_EQUAL(0, ops);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_wraps_are_linked);
+    RUN_TEST(test_other_tasks_not_watched);
+    RUN_TEST(test_ticks_allocation_free_across_dst);
+    RUN_TEST(test_clock_steps_allocation_free);
+    return UNITY_END();
+}
@@ -0,0 +1,179 @@
+// test_tzdb - images from tools/mktzdb.py, mapped in place, against the TZif sources
+//
+// Builds the image from the host's zoneinfo with the script, mmaps it the way
+// the firmware maps the flash partition, and checks every zone in it against
+// glibc reading the same TZif file.
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <unity.h>
+
+#include "tzdb.h"
+#include "zone_offset.h"
+
+#define ZONEINFO "/usr/share/zoneinfo"
+#define SPAN_END 4133980800LL       // 2101-01-01, past the last explicit transition (Gaza, 2086)
+#define SAMPLE_STEP (7 * 86400 + 3607) // between transitions, drifting through the day
+
+struct Image {
+    char path[64];
+    void* base;
+    size_t size;
+    Tzdb db;
+};
+
+static Image image;
+
+// Runs the script from the source tree; __FILE__ is test/test_tzdb/test_main.cpp
+static bool build_image(const char* extra_args, Image* out) {
+    char root[512];
+    snprintf(root, sizeof(root), "%s", __FILE__);
+    char* tail = strstr(root, "test/test_tzdb/");
+    if (tail)
+        *tail = '\0';
+    snprintf(out->path, sizeof(out->path), "/tmp/tzdb_test_XXXXXX");
+    int fd = mkstemp(out->path);
+    if (fd < 0)
+        return false;
+    close(fd);
+    char cmd[1024];
+    snprintf(cmd, sizeof(cmd), "python3 %s%stools/mktzdb.py -z %s -o %s %s > /dev/null", root,
+             tail ? "" : "./", ZONEINFO, out->path, extra_args);
+    if (system(cmd) != 0)
+        return false;
+    fd = open(out->path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+        return false;
+    out->size = (size_t)st.st_size;
+    out->base = mmap(NULL, out->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    return out->base != MAP_FAILED && tzdb_open(&out->db, out->base, out->size);
+}
+
+static void free_image(Image* img) {
+    if (img->base && img->base != MAP_FAILED)
+        munmap(img->base, img->size);
+    img->base = NULL;
+    unlink(img->path);
+}
+
+static const TzdbZone* image_zone(const Image* img, int i) {
+    const TzdbHeader* h = (const TzdbHeader*)img->db.base;
+    return (const TzdbZone*)(img->db.base + h->zones_off) + i;
+}
+
+static int image_zone_count(const Image* img) {
+    return ((const TzdbHeader*)img->db.base)->zone_count;
+}
+
+static void compare_at(ZoneTable* t, const char* name, int64_t utc) {
+    int32_t offset = zone_table_offset(t, 0, utc);
+    time_t tt = (time_t)utc;
+    struct tm lt;
+    localtime_r(&tt, &lt);
+    if (offset != lt.tm_gmtoff || t->is_dst[0] != (lt.tm_isdst > 0)) {
+        char msg[160];
+        snprintf(msg, sizeof(msg), "%s at %lld: offset %d dst %d, TZif %ld %d", name, (long long)utc, (int)offset,
+                 t->is_dst[0], lt.tm_gmtoff, lt.tm_isdst);
+        TEST_FAIL_MESSAGE(msg);
+    }
+}
+
+// Both sides of every transition the lookup reports, plus samples in between
+// so a transition missing from the image shows up too
+static void check_zone(const Image* img, const char* name, int64_t from) {
+    char tz[160];
+    snprintf(tz, sizeof(tz), ":" ZONEINFO "/%s", name);
+    setenv("TZ", tz, 1);
+    tzset();
+    ZoneTable t;
+    zone_table_init(&t);
+    TEST_ASSERT_EQUAL_MESSAGE(0, zone_table_add_tzdb(&t, &img->db, name), name);
+    int64_t utc = from;
+    while (utc < SPAN_END) {
+        compare_at(&t, name, utc);
+        int64_t next = t.next_transition[0];
+        if (next <= utc + SAMPLE_STEP) {
+            compare_at(&t, name, next - 1);
+            utc = next;
+        } else {
+            utc += SAMPLE_STEP;
+        }
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_every_zone_matches_source() {
+    int n = image_zone_count(&image);
+    TEST_ASSERT_GREATER_THAN(300, n);
+    for (int i = 0; i < n; ++i) {
+        const char* name = tzdb_zone_name(&image.db, image_zone(&image, i));
+        char path[160];
+        snprintf(path, sizeof(path), ZONEINFO "/%s", name);
+        TEST_ASSERT_EQUAL_MESSAGE(0, access(path, R_OK), name);
+        check_zone(&image, name, image.db.time_base);
+    }
+}
+
+void test_find_zone() {
+    const char* names[] = {"Europe/London", "America/New_York", "Asia/Kolkata",
+                           "America/Phoenix", "America/Los_Angeles", "America/Chicago"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        const TzdbZone* z = tzdb_find_zone(&image.db, names[i]);
+        TEST_ASSERT_NOT_NULL_MESSAGE(z, names[i]);
+        TEST_ASSERT_EQUAL_STRING(names[i], tzdb_zone_name(&image.db, z));
+    }
+    TEST_ASSERT_NULL(tzdb_find_zone(&image.db, "Europe/Atlantis"));
+    TEST_ASSERT_NULL(tzdb_find_zone(&image.db, ""));
+    // the first and last names bound the binary search
+    int n = image_zone_count(&image);
+    const char* first = tzdb_zone_name(&image.db, image_zone(&image, 0));
+    const char* last = tzdb_zone_name(&image.db, image_zone(&image, n - 1));
+    TEST_ASSERT_EQUAL_PTR(image_zone(&image, 0), tzdb_find_zone(&image.db, first));
+    TEST_ASSERT_EQUAL_PTR(image_zone(&image, n - 1), tzdb_find_zone(&image.db, last));
+}
+
+// --since drops the early transitions to fit a smaller partition; lookups
+// after it must not change
+void test_since_clips_history() {
+    Image clipped = {};
+    TEST_ASSERT_TRUE(build_image("--since 946684800", &clipped)); // 2000
+    TEST_ASSERT_LESS_THAN(image.size, clipped.size);
+    TEST_ASSERT_EQUAL(image_zone_count(&image), image_zone_count(&clipped));
+    for (int i = 0; i < image_zone_count(&clipped); ++i)
+        check_zone(&clipped, tzdb_zone_name(&clipped.db, image_zone(&clipped, i)), clipped.db.time_base);
+    free_image(&clipped);
+}
+
+void test_rejects_bad_images() {
+    Tzdb db;
+    TEST_ASSERT_FALSE(tzdb_open(&db, image.base, sizeof(TzdbHeader) - 1));
+    TEST_ASSERT_FALSE(tzdb_open(&db, image.base, image.size - 1));
+    uint8_t* copy = (uint8_t*)malloc(image.size);
+    memcpy(copy, image.base, image.size);
+    copy[0] = 'X';
+    TEST_ASSERT_FALSE(tzdb_open(&db, copy, image.size));
+    free(copy);
+}
+
+int main() {
+    UNITY_BEGIN();
+    if (access(ZONEINFO, R_OK) != 0 || !build_image("", &image)) {
+        printf("no zoneinfo or python3 on this host, tzdb image tests skipped\n");
+        return UNITY_END();
+    }
+    RUN_TEST(test_every_zone_matches_source);
+    RUN_TEST(test_find_zone);
+    RUN_TEST(test_since_clips_history);
+    RUN_TEST(test_rejects_bad_images);
+    free_image(&image);
+    return UNITY_END();
+}
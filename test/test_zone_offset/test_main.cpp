@@ -0,0 +1,160 @@
+// test_zone_offset - POSIX TZ rules against glibc, 1970-2100, and a per-tick benchmark
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unity.h>
+
+#include "zone_offset.h"
+
+#define SPAN_START 0LL              // 1970-01-01
+#define SPAN_END 4133980800LL       // 2101-01-01
+#define STEP 1800                   // catches the half-hour zones and rules at :30
+
+// The clock's cities, plus the rule shapes zone_rule_parse() has branches for
+static const char* const glibc_zones[] = {
+    "GMT0BST,M3.5.0/1,M10.5.0",
+    "EST5EDT,M3.2.0,M11.1.0",
+    "IST-5:30",
+    "MST7",
+    "PST8PDT,M3.2.0,M11.1.0",
+    "CST6CDT,M3.2.0,M11.1.0",
+    "AEST-10AEDT,M10.1.0,M4.1.0/3",     // southern hemisphere, DST across new year
+    "NZST-12NZDT,M9.5.0,M4.1.0/3",
+    "<-03>3<-02>,M3.5.0/-2,M10.5.0/-1", // negative switch times
+    "IST-1GMT0,M10.5.0,M3.5.0/1",       // Ireland: winter is the "DST"
+    "<+1030>-10:30<+11>-11,M10.1.0,M4.1.0",
+    "CET-1CEST,J60/2,J300/3",           // Julian, February 29 not counted
+    "CET-1CEST,59/2,299/3",             // zero-based, February 29 counted
+    "<+0545>-5:45",
+};
+
+static void setenv_tz(const char* tz) {
+    setenv("TZ", tz, 1);
+    tzset();
+}
+
+// Every STEP seconds in the span, offset and DST flag must match localtime_r
+static void check_against_glibc(const char* tz) {
+    ZoneTable t;
+    zone_table_init(&t);
+    TEST_ASSERT_EQUAL_MESSAGE(0, zone_table_add(&t, tz), tz);
+    setenv_tz(tz);
+    for (int64_t utc = SPAN_START; utc < SPAN_END; utc += STEP) {
+        ZoneTime z;
+        zone_table_convert_all(&t, utc, &z);
+        time_t tt = (time_t)utc;
+        struct tm lt;
+        localtime_r(&tt, &lt);
+        if (z.offset != lt.tm_gmtoff || z.is_dst != (lt.tm_isdst > 0) || z.hour != lt.tm_hour
+            || z.min != lt.tm_min) {
+            char msg[128];
+            snprintf(msg, sizeof(msg), "%s at %lld: offset %d dst %d, glibc %ld %d", tz, (long long)utc,
+                     (int)z.offset, z.is_dst, lt.tm_gmtoff, lt.tm_isdst);
+            TEST_FAIL_MESSAGE(msg);
+        }
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_matches_glibc() {
+    for (size_t i = 0; i < sizeof(glibc_zones) / sizeof(glibc_zones[0]); ++i)
+        check_against_glibc(glibc_zones[i]);
+}
+
+// "DST all year", the idiom tzcode emits for zones on permanent daylight time:
+// DST starts January 1 at 00:00 and ends December 31 at 25:00, i.e. when the
+// next one starts. glibc evaluates the rule per UTC year and reports standard
+// time for the first hours of each UTC year, so this one is checked directly.
+void test_permanent_dst() {
+    const char* tz = "EST5EDT,0/0,J365/25";
+    ZoneTable t;
+    zone_table_init(&t);
+    TEST_ASSERT_EQUAL(0, zone_table_add(&t, tz));
+    int glibc_std = 0;
+    setenv_tz(tz);
+    for (int64_t utc = SPAN_START; utc < SPAN_END; utc += STEP) {
+        ZoneTime z;
+        zone_table_convert_all(&t, utc, &z);
+        TEST_ASSERT_EQUAL(-4 * 3600, z.offset);
+        TEST_ASSERT_EQUAL(1, z.is_dst);
+        time_t tt = (time_t)utc;
+        struct tm lt;
+        localtime_r(&tt, &lt);
+        glibc_std += lt.tm_isdst == 0;
+    }
+    // only glibc's per-year gap, 5 hours a year, differs
+    TEST_ASSERT_EQUAL(131 * 5 * 3600 / STEP, glibc_std);
+    // and the leap-year variant of the idiom
+    zone_table_init(&t);
+    TEST_ASSERT_EQUAL(0, zone_table_add(&t, "EST5EDT,0/0,365/25"));
+    for (int64_t utc = SPAN_START; utc < SPAN_END; utc += 86400 - STEP) {
+        ZoneTime z;
+        zone_table_convert_all(&t, utc, &z);
+        TEST_ASSERT_EQUAL(1, z.is_dst);
+    }
+}
+
+void test_rejects_bad_rules() {
+    ZoneRule r;
+    TEST_ASSERT_FALSE(zone_rule_parse("", &r));
+    TEST_ASSERT_FALSE(zone_rule_parse("EST", &r));
+    TEST_ASSERT_FALSE(zone_rule_parse("EST5EDT,M13.1.0,M11.1.0", &r));
+    TEST_ASSERT_FALSE(zone_rule_parse("EST5EDT,M3.6.0,M11.1.0", &r));
+    TEST_ASSERT_FALSE(zone_rule_parse("EST5EDT,J0,J365", &r));
+    TEST_ASSERT_FALSE(zone_rule_parse("<+0530-5:30", &r));
+}
+
+static double seconds_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// One clock tick converts every city. Before the zone table, each tick went
+// through libc per zone; the table only refreshes when a transition is crossed.
+void test_benchmark_tick() {
+    const int zones = 6;
+    const int ticks = 200000;
+    ZoneTable t;
+    zone_table_init(&t);
+    for (int i = 0; i < zones; ++i)
+        zone_table_add(&t, glibc_zones[i]);
+
+    ZoneTime out[ZONE_TABLE_MAX];
+    int64_t utc = 1700000000;
+    uint32_t sum = 0;
+    double start = seconds_now();
+    for (int n = 0; n < ticks; ++n) {
+        zone_table_convert_all(&t, utc + n, out);
+        sum += out[n % zones].sec;
+    }
+    double table_ns = (seconds_now() - start) * 1e9 / ticks;
+
+    const int libc_ticks = ticks / 100; // TZ switches make libc orders of magnitude slower
+    start = seconds_now();
+    for (int n = 0; n < libc_ticks; ++n) {
+        for (int i = 0; i < zones; ++i) {
+            setenv_tz(glibc_zones[i]);
+            time_t tt = (time_t)(utc + n);
+            struct tm lt;
+            localtime_r(&tt, &lt);
+            sum += lt.tm_sec;
+        }
+    }
+    double libc_ns = (seconds_now() - start) * 1e9 / libc_ticks;
+
+    printf("%d zones per tick: zone table %.0f ns, libc localtime_r %.0f ns (%.0fx) [%u]\n", zones, table_ns,
+           libc_ns, libc_ns / table_ns, (unsigned)sum);
+    TEST_ASSERT_TRUE(table_ns < libc_ns);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_matches_glibc);
+    RUN_TEST(test_permanent_dst);
+    RUN_TEST(test_rejects_bad_rules);
+    RUN_TEST(test_benchmark_tick);
+    return UNITY_END();
+}
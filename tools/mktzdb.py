@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+"""Build the compact timezone database read by src/tzdb.cpp.
+
+Reads TZif files (e.g. /usr/share/zoneinfo) and writes one little-endian
+image that is flashed to the "tzdb" data partition:
+
+    header   "TZDB", u16 version, u16 zone_count, u32 zones_off,
+             u32 strings_off, u32 strings_size, u32 total_size, i64 time_base
+    zones    zone_count x { u32 name_off, u32 posix_off, u32 trans_off,
+             u32 types_off, u16 trans_count, u8 type_count, u8 initial_type },
+             sorted by name for binary search
+    data     per zone: u32 times[trans_count] in seconds after time_base,
+             u8 type_idx[trans_count],
+             then 4-aligned { i32 utoff, u8 is_dst, u8 pad[3] } types;
+             identical blobs (links) are stored once
+    strings  NUL-terminated zone names and POSIX TZ footers
+
+Usage:
+    python tools/mktzdb.py -o tzdb.bin
+    esptool.py write_flash 0x3C0000 tzdb.bin
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+MAGIC = b"TZDB"
+VERSION = 2
+HEADER = struct.Struct("<4sHHIIIIq")
+ZONE = struct.Struct("<IIIIHBB")
+TYPE = struct.Struct("<iB3x")
+UINT32_MAX = 2 ** 32 - 1
+SKIP_DIRS = {"posix", "right"}
+SKIP_FILES = {"localtime", "posixrules", "Factory"}
+
+
+def parse_tzif(data):
+    """Returns (times, type_idx, types[(utoff, is_dst)], footer) from a TZif v2+ file."""
+    if data[:4] != b"TZif":
+        return None
+    version = data[4]
+
+    def counts(off):
+        return struct.unpack_from(">6l", data, off + 20)
+
+    isutcnt, isstdcnt, leapcnt, timecnt, typecnt, charcnt = counts(0)
+    if version < ord("2"):
+        raise ValueError("TZif v1 files are not supported")
+    # skip the 32-bit v1 block
+    off = 44 + timecnt * 5 + typecnt * 6 + charcnt + leapcnt * 8 + isstdcnt + isutcnt
+    isutcnt, isstdcnt, leapcnt, timecnt, typecnt, charcnt = counts(off)
+    off += 44
+    times = list(struct.unpack_from(">%dq" % timecnt, data, off))
+    off += timecnt * 8
+    idx = list(data[off:off + timecnt])
+    off += timecnt
+    types = []
+    for i in range(typecnt):
+        utoff, is_dst, _ = struct.unpack_from(">lBB", data, off + i * 6)
+        types.append((utoff, is_dst))
+    off += typecnt * 6 + charcnt + leapcnt * 12 + isstdcnt + isutcnt
+    footer = data[off:].split(b"\n")[1] if data[off:off + 1] == b"\n" else b""
+    return times, idx, types, footer.decode("ascii")
+
+
+def clip(times, idx, types, since):
+    """Drops transitions outside [since, since + UINT32_MAX] and the types they no longer use."""
+    lo, hi = since, since + UINT32_MAX
+    initial = 0  # RFC 8536: type 0 applies before the first transition
+    keep_t, keep_i = [], []
+    for t, i in zip(times, idx):
+        if t < lo:
+            initial = i
+        elif t <= hi:
+            keep_t.append(t)
+            keep_i.append(i)
+    used = sorted(set(keep_i) | {initial})
+    remap = {old: new for new, old in enumerate(used)}
+    return keep_t, [remap[i] for i in keep_i], [types[i] for i in used], remap[initial]
+
+
+def collect(root):
+    for dirpath, dirnames, filenames in os.walk(root):
+        dirnames[:] = sorted(d for d in dirnames if d not in SKIP_DIRS)
+        for name in sorted(filenames):
+            path = os.path.join(dirpath, name)
+            zone = os.path.relpath(path, root).replace(os.sep, "/")
+            if name in SKIP_FILES or "." in name:
+                continue
+            with open(path, "rb") as f:
+                data = f.read()
+            parsed = parse_tzif(data)
+            if parsed:
+                yield zone, parsed
+
+
+def build(zones, since):
+    strings = bytearray()
+    string_off = {}
+
+    def add_string(s):
+        if s not in string_off:
+            string_off[s] = len(strings)
+            strings.extend(s.encode("ascii") + b"\0")
+        return string_off[s]
+
+    zones = sorted(zones, key=lambda z: z[0].encode("ascii"))
+    if len(zones) > 0xFFFF:
+        raise ValueError("too many zones")
+    data_off = HEADER.size + ZONE.size * len(zones)
+    data = bytearray()
+    blob_off = {}
+    entries = []
+    for name, (times, idx, types, footer) in zones:
+        times, idx, types, initial = clip(times, idx, types, since)
+        if len(types) > 0xFF or len(times) > 0xFFFF:
+            raise ValueError("%s: too many transitions or types" % name)
+        trans = struct.pack("<%dI" % len(times), *(t - since for t in times)) + bytes(idx)
+        trans += b"\0" * (-len(trans) % 4)
+        tbl = b"".join(TYPE.pack(u, d) for u, d in types)
+        blob = trans + tbl
+        if blob not in blob_off:
+            blob_off[blob] = data_off + len(data)
+            data.extend(blob)
+        base = blob_off[blob]
+        entries.append((add_string(name), add_string(footer), base, base + len(trans),
+                        len(times), len(types), initial))
+
+    strings_off = data_off + len(data)
+    total = strings_off + len(strings)
+    out = bytearray(HEADER.pack(MAGIC, VERSION, len(zones), HEADER.size, strings_off, len(strings), total, since))
+    for name_off, posix_off, trans_off, types_off, tc, yc, initial in entries:
+        out += ZONE.pack(strings_off + name_off, strings_off + posix_off, trans_off, types_off, tc, yc, initial)
+    out += data + strings
+    return bytes(out)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("-z", "--zoneinfo", default="/usr/share/zoneinfo", help="TZif source directory")
+    ap.add_argument("-o", "--output", default="tzdb.bin")
+    ap.add_argument("--since", type=int, default=0,
+                    help="drop transitions before this UTC time; the image holds 136 years from it")
+    ap.add_argument("--max-size", type=lambda s: int(s, 0), default=0x40000, help="partition size")
+    args = ap.parse_args()
+
+    image = build(list(collect(args.zoneinfo)), args.since)
+    if len(image) > args.max_size:
+        sys.exit("image is %d bytes, partition holds %d; raise --since" % (len(image), args.max_size))
+    with open(args.output, "wb") as f:
+        f.write(image)
+    print("%s: %d zones, %d bytes" % (args.output, struct.unpack_from("<H", image, 6)[0], len(image)))
+
+
+if __name__ == "__main__":
+    main()